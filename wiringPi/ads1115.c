@@ -32,7 +32,6 @@
  *********************************************************************************
  */
 
-#include <byteswap.h>
 #include <stdio.h>
 #include <stdint.h>
 
@@ -128,6 +127,20 @@ static const uint16_t gains [6] =
 } ;
 
 
+/*
+ * writeReg16:
+ *	The registers are big endian, pointer and value go in one write
+ *********************************************************************************
+ */
+
+static int writeReg16 (int fd, int reg, uint16_t value)
+{
+  uint8_t data [3] = { reg, value >> 8, value & 0xFF } ;
+
+  return wiringPiI2CWriteRead (fd, data, 3, NULL, 0) ;
+}
+
+
 /*
  * analogRead:
  *	Pin is the channel to sample on the device.
@@ -141,6 +154,14 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
   int chan = pin - node->pinBase ;
   int16_t  result ;
   uint16_t config = CONFIG_DEFAULT ;
+  uint8_t  configReg = 1, conversionReg = 0, status [2], conversion [2] ;
+  struct wiringPiI2CMsg msgs [4] =
+  {
+    { -1, 0,            &configReg,     1 },
+    { -1, WPI_I2C_READ, status,         2 },
+    { -1, 0,            &conversionReg, 1 },
+    { -1, WPI_I2C_READ, conversion,     2 },
+  } ;
 
   chan &= 7 ;
 
@@ -176,22 +197,23 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 //	Start a single conversion
 
   config |= CONFIG_OS_SINGLE ;
-  config = __bswap_16 (config) ;
-  wiringPiI2CWriteReg16 (node->fd, 1, config) ;
+  if (writeReg16 (node->fd, 1, config) < 0)
+    return 0 ;
 
-// Wait for the conversion to complete
+// Wait for the conversion to complete: the config register and the
+//	conversion register are read together, the result comes with the
+//	poll that sees it done
 
   for (;;)
   {
-    result =  wiringPiI2CReadReg16 (node->fd, 1) ;
-    result = __bswap_16 (result) ;
-    if ((result & CONFIG_OS_MASK) != 0)
+    if (wiringPiI2CTransaction (node->fd, msgs, 4) < 0)
+      return 0 ;
+    if ((status [0] & (CONFIG_OS_MASK >> 8)) != 0)
       break ;
     delayMicroseconds (100) ;
   }
 
-  result =  wiringPiI2CReadReg16 (node->fd, 0) ;
-  result = __bswap_16 (result) ;
+  result = (int16_t)((conversion [0] << 8) | conversion [1]) ;
 
 // Sometimes with a 0v input on a single-ended channel the internal 0v reference
 //	can be higher than the input, so you get a negative result...
@@ -259,8 +281,7 @@ static void myAnalogWrite (struct wiringPiNodeStruct *node, int pin, int data)
   else
     ndata = (int16_t)data ;
 
-  ndata = __bswap_16 (ndata) ;
-  wiringPiI2CWriteReg16 (node->fd, reg, data) ;
+  writeReg16 (node->fd, reg, (uint16_t)ndata) ;
 }
 
 
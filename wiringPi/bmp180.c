@@ -63,15 +63,24 @@ uint32_t cPress, cTemp ;
 static int altitude ;
 
 /*
- * read16:
- *	Quick hack to read the 16-bit data with the correct endian
+ * startConversion: readResult:
+ *	Write the control register, read the result registers from 0xF6 on,
+ *	each one I2C transaction
  *********************************************************************************
  */
 
-uint16_t read16 (int fd, int reg)
+static int startConversion (int fd, int control)
 {
-  return (wiringPiI2CReadReg8 (fd, reg) <<  8) | wiringPiI2CReadReg8 (fd, reg + 1) ;
+  uint8_t cmd [2] = { 0xF4, control } ;
 
+  return wiringPiI2CWriteRead (fd, cmd, 2, NULL, 0) ;
+}
+
+static int readResult (int fd, uint8_t *data, int len)
+{
+  uint8_t ptr = 0xF6 ;
+
+  return wiringPiI2CWriteRead (fd, &ptr, 1, data, len) ;
 }
 
 
@@ -87,17 +96,16 @@ static void bmp180ReadTempPress (int fd)
   double tu, a ;
   double pu, s, x, y, z ;
 
-  uint8_t data [4] ;
+  uint8_t data [4] = { 0, 0, 0, 0 } ;
 
 // Start a temperature sensor reading
 
-  wiringPiI2CWriteReg8 (fd, 0xF4, 0x2E) ;
+  startConversion (fd, 0x2E) ;
   delay (5) ;
 
 // Read the raw data
 
-  data [0] = wiringPiI2CReadReg8 (fd, 0xF6) ;
-  data [1] = wiringPiI2CReadReg8 (fd, 0xF7) ;
+  readResult (fd, data, 2) ;
 
 // And calculate...
 
@@ -113,14 +121,12 @@ static void bmp180ReadTempPress (int fd)
 
 // Start a pressure snsor reading
 
-  wiringPiI2CWriteReg8 (fd, 0xF4, 0x34 | (BMP180_OSS << 6)) ;
+  startConversion (fd, 0x34 | (BMP180_OSS << 6)) ;
   delay (5) ;
 
 // Read the raw data
 
-  data [0] = wiringPiI2CReadReg8 (fd, 0xF6) ;
-  data [1] = wiringPiI2CReadReg8 (fd, 0xF7) ;
-  data [2] = wiringPiI2CReadReg8 (fd, 0xF8) ;
+  readResult (fd, data, 3) ;
 
 // And calculate...
 
@@ -189,6 +195,7 @@ int bmp180Setup (const int pinBase)
 {
   double c3, c4, b1 ;
   int fd ;
+  uint8_t ptr, cal [22] ;
   struct wiringPiNodeStruct *node ;
 
   if ((fd = wiringPiI2CSetup (I2C_ADDRESS)) < 0)
@@ -200,19 +207,23 @@ int bmp180Setup (const int pinBase)
   node->analogRead  = myAnalogRead ;
   node->analogWrite = myAnalogWrite ;
 
-// Read calibration data
-
-  AC1 = read16 (fd, 0xAA) ;
-  AC2 = read16 (fd, 0xAC) ;
-  AC3 = read16 (fd, 0xAE) ;
-  AC4 = read16 (fd, 0xB0) ;
-  AC5 = read16 (fd, 0xB2) ;
-  AC6 = read16 (fd, 0xB4) ;
-  VB1 = read16 (fd, 0xB6) ;
-  VB2 = read16 (fd, 0xB8) ;
-   MB = read16 (fd, 0xBA) ;
-   MC = read16 (fd, 0xBC) ;
-   MD = read16 (fd, 0xBE) ;
+// Read calibration data, 11 big endian words from 0xAA in one transaction
+
+  ptr = 0xAA ;
+  if (wiringPiI2CWriteRead (fd, &ptr, 1, cal, sizeof (cal)) < 0)
+    return FALSE ;
+
+  AC1 = (cal [ 0] << 8) | cal [ 1] ;
+  AC2 = (cal [ 2] << 8) | cal [ 3] ;
+  AC3 = (cal [ 4] << 8) | cal [ 5] ;
+  AC4 = (cal [ 6] << 8) | cal [ 7] ;
+  AC5 = (cal [ 8] << 8) | cal [ 9] ;
+  AC6 = (cal [10] << 8) | cal [11] ;
+  VB1 = (cal [12] << 8) | cal [13] ;
+  VB2 = (cal [14] << 8) | cal [15] ;
+   MB = (cal [16] << 8) | cal [17] ;
+   MC = (cal [18] << 8) | cal [19] ;
+   MD = (cal [20] << 8) | cal [21] ;
 
 // Calculate coefficients
 
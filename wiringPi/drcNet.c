@@ -254,21 +254,33 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
 
 /*
- * myDigitalWrite8:
+ * myDigitalWritePort:
+ *	8 pins per command, the mask in bits 8-15 of the data. All commands
+ *	go out before the replies are read, one round trip for the port.
  *********************************************************************************
+ */
 
-static void myDigitalWrite8 (struct wiringPiNodeStruct *node, int pin, int value)
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, int bits, unsigned int value, unsigned int mask)
 {
   struct drcNetComStruct cmd ;
+  int n, sent = 0 ;
 
-  cmd.pin  = pin - node->pinBase ;
-  cmd.cmd  = DRCN_DIGITAL_WRITE8 ;
-  cmd.data = value ;
+  for (n = 0 ; n < bits ; n += 8)
+  {
+    if (((mask >> n) & 0xFF) == 0)
+      continue ;
 
-  (void)send (node->fd, &cmd, sizeof (cmd), 0) ;
-  (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
+    cmd.pin  = pin - node->pinBase + n ;
+    cmd.cmd  = DRCN_DIGITAL_WRITE8 ;
+    cmd.data = ((value >> n) & 0xFF) | (((mask >> n) & 0xFF) << 8) ;
+
+    if (send (node->fd, &cmd, sizeof (cmd), 0) == sizeof (cmd))
+      ++sent ;
+  }
+
+  while (sent-- > 0)
+    (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
 }
- */
 
 
 /*
@@ -348,23 +360,37 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 
 
 /*
- * myDigitalRead8:
+ * myDigitalReadPort:
+ *	8 pins per command, the number of pins in the data (0 is 8). All
+ *	commands go out before the replies are read.
  *********************************************************************************
+ */
 
-static unsigned int myDigitalRead8 (struct wiringPiNodeStruct *node, int pin)
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node, int pin, int bits)
 {
   struct drcNetComStruct cmd ;
+  unsigned int value = 0 ;
+  int n ;
 
-  cmd.pin  = pin - node->pinBase ;
-  cmd.cmd  = DRCN_DIGITAL_READ8 ;
-  cmd.data = 0 ;
+  for (n = 0 ; n < bits ; n += 8)
+  {
+    cmd.pin  = pin - node->pinBase + n ;
+    cmd.cmd  = DRCN_DIGITAL_READ8 ;
+    cmd.data = (bits - n < 8) ? bits - n : 8 ;
 
-  (void)send (node->fd, &cmd, sizeof (cmd), 0) ;
-  (void)recv (node->fd, &cmd, sizeof (cmd), 0) ;
+    if (send (node->fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
+      bits = n ;
+  }
 
-  return cmd.data ;
+  for (n = 0 ; n < bits ; n += 8)
+  {
+    if (recv (node->fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
+      break ;
+    value |= (cmd.data & 0xFF) << n ;
+  }
+
+  return (bits < 32) ? value & ((1u << bits) - 1) : value ;
 }
- */
 
 
 /*
@@ -397,8 +423,8 @@ int drcSetupNet (const int pinBase, const int numPins, const char *ipAddress, co
   node->analogWrite      = myAnalogWrite ;
   node->digitalRead      = myDigitalRead ;
   node->digitalWrite     = myDigitalWrite ;
-//node->digitalRead8     = myDigitalRead8 ;
-//node->digitalWrite8    = myDigitalWrite8 ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
   node->pwmWrite         = myPwmWrite ;
 
   return TRUE ;
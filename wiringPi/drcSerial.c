@@ -23,6 +23,8 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
 #include <time.h>
 #include <string.h>
 #include <errno.h>
@@ -135,6 +137,55 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	The firmware has no port commands, but the per-pin commands for the
+ *	whole port go out with one write and the replies are read after.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node, int pin, int bits)
+{
+  uint8_t cmds [64] = { 0 } ;
+  unsigned int value = 0 ;
+  int n ;
+
+  for (n = 0 ; n < bits ; ++n)
+  {
+    cmds [n * 2]     = 'r' ;
+    cmds [n * 2 + 1] = pin - node->pinBase + n ;
+  }
+
+  if (write (node->fd, cmds, bits * 2) != bits * 2)
+    return 0 ;
+
+  for (n = 0 ; n < bits ; ++n)
+    if (serialGetchar (node->fd) != '0')	// as myDigitalRead
+      value |= 1u << n ;
+
+  return value ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, int bits, unsigned int value, unsigned int mask)
+{
+  uint8_t cmds [64] ;
+  int n, len = 0 ;
+
+  for (n = 0 ; n < bits ; ++n)
+    if (mask & (1u << n))
+    {
+      cmds [len++] = ((value >> n) & 1) ? '1' : '0' ;
+      cmds [len++] = pin - node->pinBase + n ;
+    }
+
+  if (len == 0)
+    return ;
+
+  if (write (node->fd, cmds, len) != len)
+    fprintf (stderr, "drcSerial: Unable to write the port: %s\n", strerror (errno)) ;
+}
+
+
 /*
  * drcSetup:
  *	Create a new instance of an DRC GPIO interface.
@@ -184,13 +235,15 @@ int drcSetupSerial (const int pinBase, const int numPins, const char *device, co
 
   node = wiringPiNewNode (pinBase, numPins) ;
 
-  node->fd              = fd ;
-  node->pinMode         = myPinMode ;
-  node->pullUpDnControl = myPullUpDnControl ;
-  node->analogRead      = myAnalogRead ;
-  node->digitalRead     = myDigitalRead ;
-  node->digitalWrite    = myDigitalWrite ;
-  node->pwmWrite        = myPwmWrite ;
+  node->fd               = fd ;
+  node->pinMode          = myPinMode ;
+  node->pullUpDnControl  = myPullUpDnControl ;
+  node->analogRead       = myAnalogRead ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
+  node->pwmWrite         = myPwmWrite ;
 
   return TRUE ;
 }
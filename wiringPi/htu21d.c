@@ -65,13 +65,13 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 // Send read temperature command:
 
     data [0] = 0xF3 ;
-    if (write (fd, data, 1) != 1)
+    if (wiringPiI2CWriteRead (fd, data, 1, NULL, 0) < 0)
       return -9999 ;
 
 // Wait then read the data
 
     delay (50) ;
-    if (read (fd, data, 3) != 3)
+    if (wiringPiI2CWriteRead (fd, NULL, 0, data, 3) != 3)
       return -9998 ;
 
     if (!checksum (data))
@@ -89,13 +89,13 @@ static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 // Send read humidity command:
 
     data [0] = 0xF5 ;
-    if (write (fd, data, 1) != 1)
+    if (wiringPiI2CWriteRead (fd, data, 1, NULL, 0) < 0)
       return -9999 ;
 
 // Wait then read the data
 
     delay (50) ;
-    if (read (fd, data, 3) != 3)
+    if (wiringPiI2CWriteRead (fd, NULL, 0, data, 3) != 3)
       return -9998 ;
 
     if (!checksum (data))
@@ -123,8 +123,7 @@ int htu21dSetup (const int pinBase)
 {
   int fd ;
   struct wiringPiNodeStruct *node ;
-  uint8_t data ;
-  int status ;
+  uint8_t data, status ;
 
   if ((fd = wiringPiI2CSetup (I2C_ADDRESS)) < 0)
     return FALSE ;
@@ -137,14 +136,16 @@ int htu21dSetup (const int pinBase)
 // Send a reset code to it:
 
   data = 0xFE ;
-  if (write (fd, &data, 1) != 1)
+  if (wiringPiI2CWriteRead (fd, &data, 1, NULL, 0) < 0)
     return FALSE ;
 
   delay (15) ;
 
 // Read the status register to check it's really there
 
-  status = wiringPiI2CReadReg8 (fd, 0xE7) ;
+  data = 0xE7 ;
+  if (wiringPiI2CWriteRead (fd, &data, 1, &status, 1) != 1)
+    return FALSE ;
 
   return (status == 0x02) ? TRUE : FALSE ;
 }
@@ -27,75 +27,71 @@
 
 #include "wiringPi.h"
 #include "wiringPiI2C.h"
+#include "wiringPiRegmap.h"
 #include "mcp23x0817.h"
 
 #include "mcp23008.h"
 
 
 /*
- * myPinMode:
+ * regRead: regWrite:
+ *	Bus functions of the register cache, one register per transaction
+ *	(IOCON.SEQOP)
  *********************************************************************************
  */
 
-static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
+static int regRead (void *ctx, int reg, uint8_t *values, int count)
 {
-  int mask, old, reg ;
+  struct wiringPiNodeStruct *node = ctx ;
+  uint8_t ptr = reg ;
 
-  reg  = MCP23x08_IODIR ;
-  mask = 1 << (pin - node->pinBase) ;
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
+  return wiringPiI2CWriteRead (node->fd, &ptr, 1, values, count) ;
+}
 
-  if (mode == OUTPUT)
-    old &= (~mask) ;
-  else
-    old |=   mask ;
+static int regWrite (void *ctx, int reg, const uint8_t *values, UNU int count)
+{
+  struct wiringPiNodeStruct *node = ctx ;
+  uint8_t data [2] = { reg, values [0] } ;
 
-  wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+  return wiringPiI2CWriteRead (node->fd, data, 2, NULL, 0) ;
 }
 
 
 /*
- * myPullUpDnControl:
+ * myPinMode:
  *********************************************************************************
  */
 
-static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
+static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int mask, old, reg ;
-
-  reg  = MCP23x08_GPPU ;
-  mask = 1 << (pin - node->pinBase) ;
+  wiringPiRegmapUpdate (node->regmap, MCP23x08_IODIR,
+    1 << ((pin - node->pinBase) & 7), (mode == OUTPUT) ? 0 : 0xFF) ;
+}
 
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
 
-  if (mode == PUD_UP)
-    old |=   mask ;
-  else
-    old &= (~mask) ;
+/*
+ * myPullUpDnControl:
+ *********************************************************************************
+ */
 
-  wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  wiringPiRegmapUpdate (node->regmap, MCP23x08_GPPU,
+    1 << ((pin - node->pinBase) & 7), (mode == PUD_UP) ? 0xFF : 0) ;
 }
 
 
 /*
  * myDigitalWrite:
+ *	The output latch is cached, writing the level a pin has already does
+ *	not go to the chip
  *********************************************************************************
  */
 
 static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  int bit, old ;
-
-  bit  = 1 << ((pin - node->pinBase) & 7) ;
-
-  old = node->data2 ;
-  if (value == LOW)
-    old &= (~bit) ;
-  else
-    old |=   bit ;
-
-  wiringPiI2CWriteReg8 (node->fd, MCP23x08_GPIO, old) ;
-  node->data2 = old ;
+  wiringPiRegmapUpdate (node->regmap, MCP23x08_OLAT,
+    1 << ((pin - node->pinBase) & 7), (value == LOW) ? 0 : 0xFF) ;
 }
 
 
@@ -109,15 +105,39 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
   int mask, value ;
 
   mask  = 1 << ((pin - node->pinBase) & 7) ;
-  value = wiringPiI2CReadReg8 (node->fd, MCP23x08_GPIO) ;
+  value = wiringPiRegmapRead (node->regmap, MCP23x08_GPIO) ;
 
-  if ((value & mask) == 0)
+  if (value < 0 || (value & mask) == 0)
     return LOW ;
   else 
     return HIGH ;
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	All 8 pins with one transfer
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node, int pin, int bits)
+{
+  int value ;
+
+  if ((value = wiringPiRegmapRead (node->regmap, MCP23x08_GPIO)) < 0)
+    return 0 ;
+
+  return ((unsigned int)value >> (pin - node->pinBase)) & ((1u << bits) - 1) ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, UNU int bits, unsigned int value, unsigned int mask)
+{
+  pin -= node->pinBase ;
+
+  wiringPiRegmapUpdate (node->regmap, MCP23x08_OLAT, (mask << pin) & 0xFF, (value << pin) & 0xFF) ;
+}
+
+
 /*
  * mcp23008Setup:
  *	Create a new instance of an MCP23008 I2C GPIO interface. We know it
@@ -130,6 +150,7 @@ int mcp23008Setup (const int pinBase, const int i2cAddress)
 {
   int fd ;
   struct wiringPiNodeStruct *node ;
+  struct wiringPiRegmap *map ;
 
   if ((fd = wiringPiI2CSetup (i2cAddress)) < 0)
     return FALSE ;
@@ -137,13 +158,22 @@ int mcp23008Setup (const int pinBase, const int i2cAddress)
   wiringPiI2CWriteReg8 (fd, MCP23x08_IOCON, IOCON_INIT) ;
 
   node = wiringPiNewNode (pinBase, 8) ;
+  node->fd = fd ;
 
-  node->fd              = fd ;
-  node->pinMode         = myPinMode ;
-  node->pullUpDnControl = myPullUpDnControl ;
-  node->digitalRead     = myDigitalRead ;
-  node->digitalWrite    = myDigitalWrite ;
-  node->data2           = wiringPiI2CReadReg8 (fd, MCP23x08_OLAT) ;
+// Interrupt flags, capture and the inputs change on their own
+
+  if ((map = wiringPiRegmapNew (MCP23x08_OLAT + 1, 1, regRead, regWrite, node)) == NULL)
+    return FALSE ;
+  wiringPiRegmapVolatile (map, MCP23x08_INTF, MCP23x08_GPIO - MCP23x08_INTF + 1) ;
+  wiringPiRegmapLoad     (map, MCP23x08_OLAT, 1) ;
+
+  node->regmap           = map ;
+  node->pinMode          = myPinMode ;
+  node->pullUpDnControl  = myPullUpDnControl ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
 
   return TRUE ;
 }
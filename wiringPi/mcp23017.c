@@ -23,114 +23,227 @@
  */
 
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
 #include "wiringPiI2C.h"
+#include "wiringPiRegmap.h"
 #include "mcp23x0817.h"
 
 #include "mcp23017.h"
 
 
 /*
- * myPinMode:
+ * regRead: regWrite:
+ *	Bus functions of the register cache. In byte mode (IOCON.SEQOP) the
+ *	address toggles between the A and B register of a pair, so a pair is
+ *	one transaction.
  *********************************************************************************
  */
 
-static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
+static int regRead (void *ctx, int reg, uint8_t *values, int count)
 {
-  int mask, old, reg ;
+  struct wiringPiNodeStruct *node = ctx ;
+  uint8_t ptr = reg ;
 
-  pin -= node->pinBase ;
+  return wiringPiI2CWriteRead (node->fd, &ptr, 1, values, count) ;
+}
 
-  if (pin < 8)		// Bank A
-    reg  = MCP23x17_IODIRA ;
-  else
-  {
-    reg  = MCP23x17_IODIRB ;
-    pin &= 0x07 ;
-  }
+static int regWrite (void *ctx, int reg, const uint8_t *values, int count)
+{
+  struct wiringPiNodeStruct *node = ctx ;
+  uint8_t data [3] ;
+
+  data [0] = reg ;
+  memcpy (&data [1], values, count) ;
+  return wiringPiI2CWriteRead (node->fd, data, count + 1, NULL, 0) ;
+}
+
+
+/*
+ * Interrupt driven inputs:
+ *	With the INTA output wired to a Pi GPIO (mcp23017SetupInterrupt) the
+ *	inputs are read when they change and digitalRead takes them from
+ *	memory. Pins A0-A7 are bits 0-7, B0-B7 bits 8-15.
+ *********************************************************************************
+ */
+
+#define	MAX_INT_NODES	8
+
+struct intState
+{
+  struct wiringPiNodeStruct *node ;
+  pthread_mutex_t lock ;
+  unsigned int    levels ;
+  void          (*function)(int pin, int value, void *userdata) ;
+  void           *userdata ;
+} ;
 
-  mask = 1 << pin ;
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
+static struct intState intStates [MAX_INT_NODES] ;
+static pthread_mutex_t intStatesLock = PTHREAD_MUTEX_INITIALIZER ;
+
+static struct intState *findIntState (struct wiringPiNodeStruct *node)
+{
+  int i ;
 
-  if (mode == OUTPUT)
-    old &= (~mask) ;
-  else
-    old |=   mask ;
+  for (i = 0 ; i < MAX_INT_NODES ; ++i)
+    if (intStates [i].node == node)
+      return &intStates [i] ;
 
-  wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+  return NULL ;
 }
 
 
 /*
- * myPullUpDnControl:
+ * readPair:
+ *	A and B register of a pair with one transaction, cached ones from
+ *	memory
  *********************************************************************************
  */
 
-static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
+static int readPair (struct wiringPiNodeStruct *node, int reg)
 {
-  int mask, old, reg ;
+  uint8_t pair [2] ;
+  int ret ;
 
-  pin -= node->pinBase ;
+  if ((ret = wiringPiRegmapReadBlock (node->regmap, reg, pair, 2)) < 0)
+    return ret ;
+
+  return pair [1] << 8 | pair [0] ;
+}
+
+
+/*
+ * refreshInputs:
+ *	Read the flags, the capture of a pending interrupt and the inputs,
+ *	which clears the interrupt, and call the function for every input
+ *	that changed
+ *********************************************************************************
+ */
 
-  if (pin < 8)		// Bank A
-    reg  = MCP23x17_GPPUA ;
-  else
+static void refreshInputs (struct intState *state)
+{
+  struct wiringPiNodeStruct *node = state->node ;
+  int flags, captured = 0, levels, inputs, pin, bit ;
+  unsigned int old, mid ;
+
+  if ((flags = readPair (node, MCP23x17_INTFA)) < 0)
+    return ;
+  if ((flags != 0) && ((captured = readPair (node, MCP23x17_INTCAPA)) < 0))
+    return ;
+  levels = readPair (node, MCP23x17_GPIOA) ;
+  inputs = readPair (node, MCP23x17_IODIRA) ;
+  if ((levels < 0) || (inputs < 0))
+    return ;
+
+  pthread_mutex_lock (&state->lock) ;
+    old           = state->levels ;
+    state->levels = levels ;
+  pthread_mutex_unlock (&state->lock) ;
+
+  if (state->function == NULL)
+    return ;
+
+// The edge that raised the interrupt, then a change after the capture
+
+  mid = (old & ~flags) | (captured & flags) ;
+  for (pin = 0 ; pin < 16 ; ++pin)
   {
-    reg  = MCP23x17_GPPUB ;
-    pin &= 0x07 ;
+    bit = 1 << pin ;
+    if ((inputs & bit) == 0)
+      continue ;
+    if ((mid ^ old) & bit)
+      state->function (node->pinBase + pin, (mid    & bit) ? HIGH : LOW, state->userdata) ;
+    if ((levels ^ mid) & bit)
+      state->function (node->pinBase + pin, (levels & bit) ? HIGH : LOW, state->userdata) ;
   }
+}
 
-  mask = 1 << pin ;
-  old  = wiringPiI2CReadReg8 (node->fd, reg) ;
+static void intHandler (UNU struct WPIWfiStatus wfiStatus, void *userdata)
+{
+  refreshInputs ((struct intState *)userdata) ;
+}
+
+
+/*
+ * cachedPort:
+ *	The inputs from the interrupt cache, the outputs from the latches
+ *********************************************************************************
+ */
+
+static int cachedPort (struct wiringPiNodeStruct *node, struct intState *state)
+{
+  int inputs, latches ;
+  unsigned int levels ;
+
+  inputs  = readPair (node, MCP23x17_IODIRA) ;
+  latches = readPair (node, MCP23x17_OLATA) ;
+  if ((inputs < 0) || (latches < 0))
+    return -1 ;
 
-  if (mode == PUD_UP)
-    old |=   mask ;
-  else
-    old &= (~mask) ;
+  pthread_mutex_lock (&state->lock) ;
+    levels = state->levels ;
+  pthread_mutex_unlock (&state->lock) ;
 
-  wiringPiI2CWriteReg8 (node->fd, reg, old) ;
+  return (levels & inputs) | (latches & ~inputs) ;
 }
 
 
 /*
- * myDigitalWrite:
+ * myPinMode:
+ *	With the interrupt running, inputs raise it when they change
  *********************************************************************************
  */
 
-static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int bit, old ;
+  struct intState *state ;
+  int bit ;
 
-  pin -= node->pinBase ;	// Pin now 0-15
+  pin -= node->pinBase ;
+  bit  = 1 << (pin & 7) ;
 
-  bit = 1 << (pin & 7) ;
+  wiringPiRegmapUpdate (node->regmap, (pin < 8) ? MCP23x17_IODIRA : MCP23x17_IODIRB,
+    bit, (mode == OUTPUT) ? 0 : 0xFF) ;
 
-  if (pin < 8)			// Bank A
+  if ((state = findIntState (node)) != NULL)
   {
-    old = node->data2 ;
+    wiringPiRegmapUpdate (node->regmap, (pin < 8) ? MCP23x17_GPINTENA : MCP23x17_GPINTENB,
+      bit, (mode == OUTPUT) ? 0 : 0xFF) ;
+    refreshInputs (state) ;
+  }
+}
 
-    if (value == LOW)
-      old &= (~bit) ;
-    else
-      old |=   bit ;
 
-    wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPIOA, old) ;
-    node->data2 = old ;
-  }
-  else				// Bank B
-  {
-    old = node->data3 ;
+/*
+ * myPullUpDnControl:
+ *********************************************************************************
+ */
 
-    if (value == LOW)
-      old &= (~bit) ;
-    else
-      old |=   bit ;
+static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mode)
+{
+  pin -= node->pinBase ;
 
-    wiringPiI2CWriteReg8 (node->fd, MCP23x17_GPIOB, old) ;
-    node->data3 = old ;
-  }
+  wiringPiRegmapUpdate (node->regmap, (pin < 8) ? MCP23x17_GPPUA : MCP23x17_GPPUB,
+    1 << (pin & 7), (mode == PUD_UP) ? 0xFF : 0) ;
+}
+
+
+/*
+ * myDigitalWrite:
+ *	The output latches are cached, writing the level a pin has already
+ *	does not go to the chip
+ *********************************************************************************
+ */
+
+static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  pin -= node->pinBase ;	// Pin now 0-15
+
+  wiringPiRegmapUpdate (node->regmap, (pin < 8) ? MCP23x17_OLATA : MCP23x17_OLATB,
+    1 << (pin & 7), (value == LOW) ? 0 : 0xFF) ;
 }
 
 
@@ -141,28 +254,160 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
 static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 {
-  int mask, value, gpio ;
+  struct intState *state ;
+  int mask, value ;
 
   pin -= node->pinBase ;
 
-  if (pin < 8)		// Bank A
-    gpio  = MCP23x17_GPIOA ;
-  else
+  if ((state = findIntState (node)) != NULL)
   {
-    gpio  = MCP23x17_GPIOB ;
-    pin  &= 0x07 ;
+    value = cachedPort (node, state) ;
+    return ((value < 0) || (value & (1 << pin)) == 0) ? LOW : HIGH ;
   }
 
-  mask  = 1 << pin ;
-  value = wiringPiI2CReadReg8 (node->fd, gpio) ;
+  mask  = 1 << (pin & 7) ;
+  value = wiringPiRegmapRead (node->regmap, (pin < 8) ? MCP23x17_GPIOA : MCP23x17_GPIOB) ;
 
-  if ((value & mask) == 0)
+  if (value < 0 || (value & mask) == 0)
     return LOW ;
   else 
     return HIGH ;
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	Both ports in one transfer, pins A0-A7 are bits 0-7, B0-B7 bits 8-15
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node, int pin, int bits)
+{
+  struct intState *state ;
+  uint8_t ports [2] ;
+  int first, last, cached ;
+  unsigned int value ;
+
+  pin  -= node->pinBase ;	// Pin now 0-15, bits at most 16
+
+  if ((state = findIntState (node)) != NULL)
+  {
+    if ((cached = cachedPort (node, state)) < 0)
+      return 0 ;
+    return ((unsigned int)cached >> pin) & ((1u << bits) - 1) ;
+  }
+
+  first = pin / 8 ;
+  last  = (pin + bits - 1) / 8 ;
+
+  if (wiringPiRegmapReadBlock (node->regmap, MCP23x17_GPIOA + first, &ports [first], last - first + 1) < 0)
+    return 0 ;
+
+  value = ports [first] ;
+  if (last != first)
+    value |= ports [last] << 8 ;
+
+  return (value >> (pin - first * 8)) & ((1u << bits) - 1) ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, UNU int bits, unsigned int value, unsigned int mask)
+{
+  uint8_t values [2], masks [2] ;
+
+  pin   -= node->pinBase ;
+  value  = (value & mask) << pin ;
+  mask <<= pin ;
+
+  values [0] = value & 0xFF ; values [1] = (value >> 8) & 0xFF ;
+  masks  [0] = mask  & 0xFF ; masks  [1] = (mask  >> 8) & 0xFF ;
+
+  wiringPiRegmapUpdateBlock (node->regmap, MCP23x17_OLATA, masks, values, 2) ;
+}
+
+
+/*
+ * mcp23017SetupInterrupt:
+ *	Read the inputs of the chip at pinBase on interrupt: INTA (both ports,
+ *	IOCON.MIRROR) is wired to intPin of the Pi. function, if not NULL, is
+ *	called in the interrupt thread for each input that changed.
+ *********************************************************************************
+ */
+
+int mcp23017SetupInterrupt (const int pinBase, const int intPin, void (*function)(int pin, int value, void *userdata), void *userdata)
+{
+  struct wiringPiNodeStruct *node ;
+  struct intState *state ;
+  uint8_t pair [2] = { 0, 0 } ;
+  uint8_t mask [2] = { 0xFF, 0xFF } ;
+  int inputs, levels, i ;
+
+  node = wiringPiFindNode (pinBase) ;
+  if ((node == NULL) || (node->pinBase != pinBase) || (node->digitalRead != myDigitalRead))
+  {
+    fprintf (stderr, "mcp23017SetupInterrupt: No MCP23017 at pin %d\n", pinBase) ;
+    return -EINVAL ;
+  }
+
+  pthread_mutex_lock (&intStatesLock) ;
+  if ((state = findIntState (node)) == NULL)
+    for (i = 0 ; (i < MAX_INT_NODES) && (state == NULL) ; ++i)
+      if (intStates [i].node == NULL)
+        state = &intStates [i] ;
+  if (state == NULL)
+  {
+    pthread_mutex_unlock (&intStatesLock) ;
+    fprintf (stderr, "mcp23017SetupInterrupt: More than %d chips\n", MAX_INT_NODES) ;
+    return -ENOMEM ;
+  }
+  state->function = function ;
+  state->userdata = userdata ;
+
+  if (state->node != NULL)		// Running, new function only
+  {
+    pthread_mutex_unlock (&intStatesLock) ;
+    return 0 ;
+  }
+
+// Change against the last value on the inputs, both ports on INTA. Reading
+//	the inputs clears a pending interrupt.
+
+  if ((inputs = readPair (node, MCP23x17_IODIRA)) < 0)
+  {
+    pthread_mutex_unlock (&intStatesLock) ;
+    return inputs ;
+  }
+  wiringPiRegmapUpdate      (node->regmap, MCP23x17_IOCON, IOCON_MIRROR, IOCON_MIRROR) ;
+  wiringPiRegmapUpdateBlock (node->regmap, MCP23x17_INTCONA, mask, pair, 2) ;
+  pair [0] = inputs & 0xFF ; pair [1] = inputs >> 8 ;
+  wiringPiRegmapUpdateBlock (node->regmap, MCP23x17_GPINTENA, mask, pair, 2) ;
+
+  (void)readPair (node, MCP23x17_INTCAPA) ;
+  if ((levels = readPair (node, MCP23x17_GPIOA)) < 0)
+  {
+    pthread_mutex_unlock (&intStatesLock) ;
+    return levels ;
+  }
+
+  pthread_mutex_init (&state->lock, NULL) ;
+  state->levels = levels ;
+  state->node   = node ;
+  if (wiringPiISR2 (intPin, INT_EDGE_FALLING, intHandler, 0, state) < 0)
+  {
+    state->node = NULL ;
+    pthread_mutex_unlock (&intStatesLock) ;
+    fprintf (stderr, "mcp23017SetupInterrupt: Unable to use pin %d for the interrupt\n", intPin) ;
+    return -EIO ;
+  }
+  pthread_mutex_unlock (&intStatesLock) ;
+
+// A change before the interrupt was running did not raise it
+
+  refreshInputs (state) ;
+
+  return 0 ;
+}
+
+
 /*
  * mcp23017Setup:
  *	Create a new instance of an MCP23017 I2C GPIO interface. We know it
@@ -175,6 +420,7 @@ int mcp23017Setup (const int pinBase, const int i2cAddress)
 {
   int fd ;
   struct wiringPiNodeStruct *node ;
+  struct wiringPiRegmap *map ;
 
   if ((fd = wiringPiI2CSetup (i2cAddress)) < 0)
     return FALSE ;
@@ -182,14 +428,22 @@ int mcp23017Setup (const int pinBase, const int i2cAddress)
   wiringPiI2CWriteReg8 (fd, MCP23x17_IOCON, IOCON_INIT) ;
 
   node = wiringPiNewNode (pinBase, 16) ;
+  node->fd = fd ;
+
+// Interrupt flags, captures and the inputs change on their own
 
-  node->fd              = fd ;
-  node->pinMode         = myPinMode ;
-  node->pullUpDnControl = myPullUpDnControl ;
-  node->digitalRead     = myDigitalRead ;
-  node->digitalWrite    = myDigitalWrite ;
-  node->data2           = wiringPiI2CReadReg8 (fd, MCP23x17_OLATA) ;
-  node->data3           = wiringPiI2CReadReg8 (fd, MCP23x17_OLATB) ;
+  if ((map = wiringPiRegmapNew (MCP23x17_OLATB + 1, 2, regRead, regWrite, node)) == NULL)
+    return FALSE ;
+  wiringPiRegmapVolatile (map, MCP23x17_INTFA, MCP23x17_GPIOB - MCP23x17_INTFA + 1) ;
+  wiringPiRegmapLoad     (map, MCP23x17_OLATA, 2) ;
+
+  node->regmap           = map ;
+  node->pinMode          = myPinMode ;
+  node->pullUpDnControl  = myPullUpDnControl ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
 
   return TRUE ;
 }
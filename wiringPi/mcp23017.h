@@ -27,6 +27,7 @@ extern "C" {
 #endif
 
 extern int mcp23017Setup (const int pinBase, const int i2cAddress) ;
+extern int mcp23017SetupInterrupt (const int pinBase, const int intPin, void (*function)(int pin, int value, void *userdata), void *userdata) ; // Interface V3.15
 
 #ifdef __cplusplus
 }
@@ -116,6 +116,30 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 }
 
 
+/*
+ * writeLatch: myFlush:
+ *	Write the output shadow, in a batch (wiringPiNodeBegin) only at the
+ *	commit
+ *********************************************************************************
+ */
+
+static void writeLatch (struct wiringPiNodeStruct *node)
+{
+  if (node->batch)
+    node->dirty = 1 ;
+  else
+    writeByte (node->data0, node->data1, MCP23x08_GPIO, node->data2) ;
+}
+
+static int myFlush (struct wiringPiNodeStruct *node)
+{
+  node->dirty = 0 ;
+  writeLatch (node) ;
+
+  return 0 ;
+}
+
+
 /*
  * myDigitalWrite:
  *********************************************************************************
@@ -123,18 +147,16 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 
 static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  int bit, old ;
+  int bit ;
 
   bit  = 1 << ((pin - node->pinBase) & 7) ;
 
-  old = node->data2 ;
   if (value == LOW)
-    old &= (~bit) ;
+    node->data2 &= (~bit) ;
   else
-    old |=   bit ;
+    node->data2 |=   bit ;
 
-  writeByte (node->data0, node->data1, MCP23x08_GPIO, old) ;
-  node->data2 = old ;
+  writeLatch (node) ;
 }
 
 
@@ -157,6 +179,30 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	All 8 pins with one SPI transfer
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node, int pin, int bits)
+{
+  unsigned int value = readByte (node->data0, node->data1, MCP23x08_GPIO) ;
+
+  return (value >> (pin - node->pinBase)) & ((1u << bits) - 1) ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, UNU int bits, unsigned int value, unsigned int mask)
+{
+  pin   -= node->pinBase ;
+  value  = (value & mask) << pin ;
+  mask <<= pin ;
+
+  node->data2 = (node->data2 & ~mask) | (value & 0xFF) ;
+  writeLatch (node) ;
+}
+
+
 /*
  * mcp23s08Setup:
  *	Create a new instance of an MCP23s08 SPI GPIO interface. We know it
@@ -176,13 +222,16 @@ int mcp23s08Setup (const int pinBase, const int spiPort, const int devId)
 
   node = wiringPiNewNode (pinBase, 8) ;
 
-  node->data0           = spiPort ;
-  node->data1           = devId ;
-  node->pinMode         = myPinMode ;
-  node->pullUpDnControl = myPullUpDnControl ;
-  node->digitalRead     = myDigitalRead ;
-  node->digitalWrite    = myDigitalWrite ;
-  node->data2           = readByte (spiPort, devId, MCP23x08_OLAT) ;
+  node->data0            = spiPort ;
+  node->data1            = devId ;
+  node->pinMode          = myPinMode ;
+  node->pullUpDnControl  = myPullUpDnControl ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
+  node->flush            = myFlush ;
+  node->data2            = readByte (spiPort, devId, MCP23x08_OLAT) ;
 
   return TRUE ;
 }
@@ -24,6 +24,9 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "wiringPi.h"
 #include "wiringPiSPI.h"
@@ -32,9 +35,64 @@
 #include "mcp23s17.h"
 
 #define	MCP_SPEED	4000000
+#define	MAX_REGS	6
 
 
 
+/*
+ * writeBytes:
+ * readBytes:
+ *	Write/read a number of registers on the MCP23s17 with one SPI
+ *	transaction, one chip select per register.
+ *********************************************************************************
+ */
+
+static void writeBytes (uint8_t spiPort, uint8_t devId, const uint8_t *regs, const uint8_t *data, int count)
+{
+  struct wiringPiSPISegment segs [MAX_REGS] ;
+  uint8_t spiData [MAX_REGS][3] ;
+  int i ;
+
+  memset (segs, 0, sizeof (segs)) ;
+  for (i = 0 ; i < count ; ++i)
+  {
+    spiData [i][0] = CMD_WRITE | ((devId & 7) << 1) ;
+    spiData [i][1] = regs [i] ;
+    spiData [i][2] = data [i] ;
+    segs [i].tx       = spiData [i] ;
+    segs [i].len      = 3 ;
+    segs [i].csChange = 1 ;
+  }
+
+  wiringPiSPITransaction (spiPort, segs, count) ;
+}
+
+static void readBytes (uint8_t spiPort, uint8_t devId, const uint8_t *regs, uint8_t *data, int count)
+{
+  struct wiringPiSPISegment segs [MAX_REGS] ;
+  uint8_t txData [MAX_REGS][3], rxData [MAX_REGS][3] ;
+  int i ;
+
+  memset (segs, 0, sizeof (segs)) ;
+  memset (rxData, 0, sizeof (rxData)) ;
+  for (i = 0 ; i < count ; ++i)
+  {
+    txData [i][0] = CMD_READ | ((devId & 7) << 1) ;
+    txData [i][1] = regs [i] ;
+    txData [i][2] = 0 ;
+    segs [i].tx       = txData [i] ;
+    segs [i].rx       = rxData [i] ;
+    segs [i].len      = 3 ;
+    segs [i].csChange = 1 ;
+  }
+
+  wiringPiSPITransaction (spiPort, segs, count) ;
+
+  for (i = 0 ; i < count ; ++i)
+    data [i] = rxData [i][2] ;
+}
+
+
 /*
  * writeByte:
  *	Write a byte to a register on the MCP23s17 on the SPI bus.
@@ -43,13 +101,7 @@
 
 static void writeByte (uint8_t spiPort, uint8_t devId, uint8_t reg, uint8_t data)
 {
-  uint8_t spiData [4] ;
-
-  spiData [0] = CMD_WRITE | ((devId & 7) << 1) ;
-  spiData [1] = reg ;
-  spiData [2] = data ;
-
-  wiringPiSPIDataRW (spiPort, spiData, 3) ;
+  writeBytes (spiPort, devId, &reg, &data, 1) ;
 }
 
 /*
@@ -60,14 +112,131 @@ static void writeByte (uint8_t spiPort, uint8_t devId, uint8_t reg, uint8_t data
 
 static uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg)
 {
-  uint8_t spiData [4] ;
+  uint8_t data ;
+
+  readBytes (spiPort, devId, &reg, &data, 1) ;
+  return data ;
+}
+
+
+/*
+ * Interrupt driven inputs:
+ *	With the INTA output wired to a Pi GPIO (mcp23s17SetupInterrupt) the
+ *	inputs are read when they change and digitalRead takes them from
+ *	memory. Pins A0-A7 are bits 0-7, B0-B7 bits 8-15.
+ *********************************************************************************
+ */
+
+#define	MAX_INT_NODES	16
+
+struct intState
+{
+  struct wiringPiNodeStruct *node ;
+  pthread_mutex_t lock ;
+  unsigned int    inputs ;		// IODIR
+  unsigned int    levels ;
+  void          (*function)(int pin, int value, void *userdata) ;
+  void           *userdata ;
+} ;
 
-  spiData [0] = CMD_READ | ((devId & 7) << 1) ;
-  spiData [1] = reg ;
+static struct intState intStates [MAX_INT_NODES] ;
+static pthread_mutex_t intStatesLock = PTHREAD_MUTEX_INITIALIZER ;
 
-  wiringPiSPIDataRW (spiPort, spiData, 3) ;
+static struct intState *findIntState (struct wiringPiNodeStruct *node)
+{
+  int i ;
+
+  for (i = 0 ; i < MAX_INT_NODES ; ++i)
+    if (intStates [i].node == node)
+      return &intStates [i] ;
 
-  return spiData [2] ;
+  return NULL ;
+}
+
+
+/*
+ * refreshInputs:
+ *	Read the flags, the capture and the inputs with one transaction,
+ *	which clears the interrupt, and call the function for every input
+ *	that changed
+ *********************************************************************************
+ */
+
+static void refreshInputs (struct intState *state)
+{
+  const uint8_t regs [6] = { MCP23x17_INTFA, MCP23x17_INTFB, MCP23x17_INTCAPA, MCP23x17_INTCAPB, MCP23x17_GPIOA, MCP23x17_GPIOB } ;
+  struct wiringPiNodeStruct *node = state->node ;
+  uint8_t data [6] ;
+  unsigned int flags, captured, levels, inputs, old, mid ;
+  int pin, bit ;
+
+  readBytes (node->data0, node->data1, regs, data, 6) ;
+  flags    = data [1] << 8 | data [0] ;
+  captured = data [3] << 8 | data [2] ;
+  levels   = data [5] << 8 | data [4] ;
+
+  pthread_mutex_lock (&state->lock) ;
+    old           = state->levels ;
+    inputs        = state->inputs ;
+    state->levels = levels ;
+  pthread_mutex_unlock (&state->lock) ;
+
+  if (state->function == NULL)
+    return ;
+
+// The edge that raised the interrupt, then a change after the capture
+
+  mid = (old & ~flags) | (captured & flags) ;
+  for (pin = 0 ; pin < 16 ; ++pin)
+  {
+    bit = 1 << pin ;
+    if ((inputs & bit) == 0)
+      continue ;
+    if ((mid ^ old) & bit)
+      state->function (node->pinBase + pin, (mid    & bit) ? HIGH : LOW, state->userdata) ;
+    if ((levels ^ mid) & bit)
+      state->function (node->pinBase + pin, (levels & bit) ? HIGH : LOW, state->userdata) ;
+  }
+}
+
+static void intHandler (UNU struct WPIWfiStatus wfiStatus, void *userdata)
+{
+  refreshInputs ((struct intState *)userdata) ;
+}
+
+
+/*
+ * cachedPort:
+ *	The inputs from the interrupt cache, the outputs from the latches
+ *********************************************************************************
+ */
+
+static unsigned int cachedPort (struct wiringPiNodeStruct *node, struct intState *state)
+{
+  unsigned int value ;
+
+  pthread_mutex_lock (&state->lock) ;
+    value = (state->levels & state->inputs) | ((node->data3 << 8 | node->data2) & ~state->inputs) ;
+  pthread_mutex_unlock (&state->lock) ;
+
+  return value ;
+}
+
+
+/*
+ * setInterrupts:
+ *	Inputs raise the interrupt when they change
+ *********************************************************************************
+ */
+
+static void setInterrupts (struct wiringPiNodeStruct *node, unsigned int inputs)
+{
+  const uint8_t regs [2] = { MCP23x17_GPINTENA, MCP23x17_GPINTENB } ;
+  uint8_t       data [2] ;
+
+  data [0] = inputs & 0xFF ;
+  data [1] = inputs >> 8 ;
+  writeBytes (node->data0, node->data1, regs, data, 2) ;
 }
 
 
@@ -78,8 +247,19 @@ static uint8_t readByte (uint8_t spiPort, uint8_t devId, uint8_t reg)
 
 static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
+  struct intState *state ;
   int mask, old, reg ;
 
+  if ((state = findIntState (node)) != NULL)
+  {
+    pthread_mutex_lock (&state->lock) ;
+      if (mode == OUTPUT)
+        state->inputs &= ~(1u << (pin - node->pinBase)) ;
+      else
+        state->inputs |=  (1u << (pin - node->pinBase)) ;
+    pthread_mutex_unlock (&state->lock) ;
+  }
+
   pin -= node->pinBase ;
 
   if (pin < 8)		// Bank A
@@ -99,6 +279,12 @@ static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
     old |=   mask ;
 
   writeByte (node->data0, node->data1, reg, old) ;
+
+  if (state != NULL)
+  {
+    setInterrupts (node, state->inputs) ;
+    refreshInputs (state) ;
+  }
 }
 
 
@@ -133,6 +319,51 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 }
 
 
+/*
+ * writeLatches:
+ *	Write the shadow of port A (bit 0) and/or B (bit 1) with one SPI
+ *	transaction. In a batch (wiringPiNodeBegin) they are only marked, the
+ *	flush at the commit writes them.
+ *********************************************************************************
+ */
+
+static void writeLatches (struct wiringPiNodeStruct *node, unsigned int ports)
+{
+  uint8_t regs [2], data [2] ;
+  int count = 0 ;
+
+  if (node->batch)
+  {
+    node->dirty |= ports ;
+    return ;
+  }
+
+  if (ports & 1)
+  {
+    regs [count]   = MCP23x17_GPIOA ;
+    data [count++] = node->data2 ;
+  }
+  if (ports & 2)
+  {
+    regs [count]   = MCP23x17_GPIOB ;
+    data [count++] = node->data3 ;
+  }
+
+  if (count > 0)
+    writeBytes (node->data0, node->data1, regs, data, count) ;
+}
+
+static int myFlush (struct wiringPiNodeStruct *node)
+{
+  unsigned int ports = node->dirty ;
+
+  node->dirty = 0 ;
+  writeLatches (node, ports) ;
+
+  return 0 ;
+}
+
+
 /*
  * myDigitalWrite:
  *********************************************************************************
@@ -140,7 +371,7 @@ static void myPullUpDnControl (struct wiringPiNodeStruct *node, int pin, int mod
 
 static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  int bit, old ;
+  int bit ;
 
   pin -= node->pinBase ;	// Pin now 0-15
 
@@ -148,27 +379,21 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
   if (pin < 8)			// Bank A
   {
-    old = node->data2 ;
-
     if (value == LOW)
-      old &= (~bit) ;
+      node->data2 &= (~bit) ;
     else
-      old |=   bit ;
+      node->data2 |=   bit ;
 
-    writeByte (node->data0, node->data1, MCP23x17_GPIOA, old) ;
-    node->data2 = old ;
+    writeLatches (node, 1) ;
   }
   else				// Bank B
   {
-    old = node->data3 ;
-
     if (value == LOW)
-      old &= (~bit) ;
+      node->data3 &= (~bit) ;
     else
-      old |=   bit ;
+      node->data3 |=   bit ;
 
-    writeByte (node->data0, node->data1, MCP23x17_GPIOB, old) ;
-    node->data3 = old ;
+    writeLatches (node, 2) ;
   }
 }
 
@@ -180,10 +405,14 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 
 static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 {
+  struct intState *state ;
   int mask, value, gpio ;
 
   pin -= node->pinBase ;
 
+  if ((state = findIntState (node)) != NULL)
+    return (cachedPort (node, state) & (1 << pin)) ? HIGH : LOW ;
+
   if (pin < 8)		// Bank A
     gpio  = MCP23x17_GPIOA ;
   else
@@ -202,6 +431,127 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	Both ports with one SPI transaction, pins A0-A7 are bits 0-7, B0-B7
+ *	bits 8-15. Only the ports with pins to change are written.
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node, int pin, int bits)
+{
+  const uint8_t gpioRegs [2] = { MCP23x17_GPIOA, MCP23x17_GPIOB } ;
+  uint8_t       gpio     [2] ;
+  struct intState *state ;
+
+  pin -= node->pinBase ;	// Pin now 0-15, bits at most 16
+
+  if ((state = findIntState (node)) != NULL)
+    return (cachedPort (node, state) >> pin) & ((1u << bits) - 1) ;
+
+  readBytes (node->data0, node->data1, gpioRegs, gpio, 2) ;
+
+  return ((unsigned int)(gpio [1] << 8 | gpio [0]) >> pin) & ((1u << bits) - 1) ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, UNU int bits, unsigned int value, unsigned int mask)
+{
+  unsigned int ports = 0 ;
+
+  pin   -= node->pinBase ;
+  value  = (value & mask) << pin ;
+  mask <<= pin ;
+
+  if (mask & 0x00FF)
+  {
+    node->data2 = (node->data2 & ~mask) | (value & 0xFF) ;
+    ports |= 1 ;
+  }
+  if (mask & 0xFF00)
+  {
+    node->data3 = (node->data3 & ~(mask >> 8)) | ((value >> 8) & 0xFF) ;
+    ports |= 2 ;
+  }
+
+  writeLatches (node, ports) ;
+}
+
+
+/*
+ * mcp23s17SetupInterrupt:
+ *	Read the inputs of the chip at pinBase on interrupt: INTA (both ports,
+ *	IOCON.MIRROR) is wired to intPin of the Pi. function, if not NULL, is
+ *	called in the interrupt thread for each input that changed.
+ *********************************************************************************
+ */
+
+int mcp23s17SetupInterrupt (const int pinBase, const int intPin, void (*function)(int pin, int value, void *userdata), void *userdata)
+{
+  const uint8_t ioconRegs [2] = { MCP23x17_IOCON, MCP23x17_IOCONB } ;
+  const uint8_t ioconData [2] = { IOCON_INIT | IOCON_HAEN | IOCON_MIRROR, IOCON_INIT | IOCON_HAEN | IOCON_MIRROR } ;
+  const uint8_t setupRegs [6] = { MCP23x17_INTCONA, MCP23x17_INTCONB, MCP23x17_IODIRA, MCP23x17_IODIRB, MCP23x17_GPIOA, MCP23x17_GPIOB } ;
+  const uint8_t intconData [2] = { 0, 0 } ;
+  struct wiringPiNodeStruct *node ;
+  struct intState *state ;
+  uint8_t data [6] ;
+  int i ;
+
+  node = wiringPiFindNode (pinBase) ;
+  if ((node == NULL) || (node->pinBase != pinBase) || (node->digitalRead != myDigitalRead))
+  {
+    fprintf (stderr, "mcp23s17SetupInterrupt: No MCP23S17 at pin %d\n", pinBase) ;
+    return -EINVAL ;
+  }
+
+  pthread_mutex_lock (&intStatesLock) ;
+  if ((state = findIntState (node)) == NULL)
+    for (i = 0 ; (i < MAX_INT_NODES) && (state == NULL) ; ++i)
+      if (intStates [i].node == NULL)
+        state = &intStates [i] ;
+  if (state == NULL)
+  {
+    pthread_mutex_unlock (&intStatesLock) ;
+    fprintf (stderr, "mcp23s17SetupInterrupt: More than %d chips\n", MAX_INT_NODES) ;
+    return -ENOMEM ;
+  }
+  state->function = function ;
+  state->userdata = userdata ;
+
+  if (state->node != NULL)		// Running, new function only
+  {
+    pthread_mutex_unlock (&intStatesLock) ;
+    return 0 ;
+  }
+
+// Change against the last value on the inputs, both ports on INTA. Reading
+//	the inputs clears a pending interrupt.
+
+  writeBytes (node->data0, node->data1, ioconRegs, ioconData, 2) ;
+  writeBytes (node->data0, node->data1, setupRegs, intconData, 2) ;
+  readBytes  (node->data0, node->data1, &setupRegs [2], &data [2], 4) ;
+  setInterrupts (node, data [3] << 8 | data [2]) ;
+
+  pthread_mutex_init (&state->lock, NULL) ;
+  state->inputs = data [3] << 8 | data [2] ;
+  state->levels = data [5] << 8 | data [4] ;
+  state->node   = node ;
+  if (wiringPiISR2 (intPin, INT_EDGE_FALLING, intHandler, 0, state) < 0)
+  {
+    state->node = NULL ;
+    pthread_mutex_unlock (&intStatesLock) ;
+    fprintf (stderr, "mcp23s17SetupInterrupt: Unable to use pin %d for the interrupt\n", intPin) ;
+    return -EIO ;
+  }
+  pthread_mutex_unlock (&intStatesLock) ;
+
+// A change before the interrupt was running did not raise it
+
+  refreshInputs (state) ;
+
+  return 0 ;
+}
+
+
 /*
  * mcp23s17Setup:
  *	Create a new instance of an MCP23s17 SPI GPIO interface. We know it
@@ -213,23 +563,31 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
 int mcp23s17Setup (const int pinBase, const int spiPort, const int devId)
 {
   struct wiringPiNodeStruct *node ;
+  const uint8_t ioconRegs [2] = { MCP23x17_IOCON, MCP23x17_IOCONB } ;
+  const uint8_t ioconData [2] = { IOCON_INIT | IOCON_HAEN, IOCON_INIT | IOCON_HAEN } ;
+  const uint8_t olatRegs  [2] = { MCP23x17_OLATA, MCP23x17_OLATB } ;
+  uint8_t       olat      [2] ;
 
   if (wiringPiSPISetup (spiPort, MCP_SPEED) < 0)
     return FALSE ;
 
-  writeByte (spiPort, devId, MCP23x17_IOCON,  IOCON_INIT | IOCON_HAEN) ;
-  writeByte (spiPort, devId, MCP23x17_IOCONB, IOCON_INIT | IOCON_HAEN) ;
+  writeBytes (spiPort, devId, ioconRegs, ioconData, 2) ;
 
   node = wiringPiNewNode (pinBase, 16) ;
 
-  node->data0           = spiPort ;
-  node->data1           = devId ;
-  node->pinMode         = myPinMode ;
-  node->pullUpDnControl = myPullUpDnControl ;
-  node->digitalRead     = myDigitalRead ;
-  node->digitalWrite    = myDigitalWrite ;
-  node->data2           = readByte (spiPort, devId, MCP23x17_OLATA) ;
-  node->data3           = readByte (spiPort, devId, MCP23x17_OLATB) ;
+  node->data0            = spiPort ;
+  node->data1            = devId ;
+  node->pinMode          = myPinMode ;
+  node->pullUpDnControl  = myPullUpDnControl ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
+  node->flush            = myFlush ;
+
+  readBytes (spiPort, devId, olatRegs, olat, 2) ;
+  node->data2            = olat [0] ;
+  node->data3            = olat [1] ;
 
   return TRUE ;
 }
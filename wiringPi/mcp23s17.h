@@ -27,6 +27,7 @@ extern "C" {
 #endif
 
 extern int mcp23s17Setup (int pinBase, int spiPort, int devId) ;
+extern int mcp23s17SetupInterrupt (const int pinBase, const int intPin, void (*function)(int pin, int value, void *userdata), void *userdata) ; // Interface V3.15
 
 #ifdef __cplusplus
 }
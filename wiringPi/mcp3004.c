@@ -24,6 +24,8 @@
  ***********************************************************************
  */
 
+#include <string.h>
+
 #include <wiringPi.h>
 #include <wiringPiSPI.h>
 
@@ -37,19 +39,63 @@
 
 static int myAnalogRead (struct wiringPiNodeStruct *node, int pin)
 {
-  unsigned char spiData [3] ;
-  unsigned char chanBits ;
+  struct wiringPiSPISegment seg ;
+  unsigned char tx [3], rx [3] ;
   int chan = pin - node->pinBase ;
 
-  chanBits = 0b10000000 | (chan << 4) ;
+  tx [0] = 1 ;				// Start bit
+  tx [1] = 0b10000000 | (chan << 4) ;	// Single ended, channel
+  tx [2] = 0 ;
+
+  memset (&seg, 0, sizeof (seg)) ;
+  memset (rx, 0, sizeof (rx)) ;
+  seg.tx  = tx ;
+  seg.rx  = rx ;
+  seg.len = 3 ;
+  wiringPiSPITransaction (node->fd, &seg, 1) ;
+
+  return ((rx [1] << 8) | rx [2]) & 0x3FF ;
+}
+
+
+/*
+ * mcp3004AnalogReadAll:
+ *	Convert count channels from the first one, each with its own chip
+ *	select, in one SPI transaction.
+ *	Returns count, or -1 if pinBase is no mcp3004.
+ *********************************************************************************
+ */
+
+int mcp3004AnalogReadAll (int pinBase, int *values, int count)
+{
+  struct wiringPiNodeStruct *node = wiringPiFindNode (pinBase) ;
+  struct wiringPiSPISegment segs [8] ;
+  unsigned char tx [8][3], rx [8][3] ;
+  int chan ;
+
+  if ((node == NULL) || (node->analogRead != myAnalogRead) || (count < 1) || (count > 8))
+    return -1 ;
+
+  memset (segs, 0, sizeof (segs)) ;
+  memset (rx, 0, sizeof (rx)) ;
+  for (chan = 0 ; chan < count ; ++chan)
+  {
+    tx [chan][0] = 1 ;
+    tx [chan][1] = 0b10000000 | (chan << 4) ;
+    tx [chan][2] = 0 ;
+    segs [chan].tx       = tx [chan] ;
+    segs [chan].rx       = rx [chan] ;
+    segs [chan].len      = 3 ;
+    segs [chan].csChange = 1 ;
+  }
 
-  spiData [0] = 1 ;		// Start bit
-  spiData [1] = chanBits ;
-  spiData [2] = 0 ;
+  if (wiringPiSPITransaction (node->fd, segs, count) < 0)
+    return -1 ;
 
-  wiringPiSPIDataRW (node->fd, spiData, 3) ;
+  for (chan = 0 ; chan < count ; ++chan)
+    values [chan] = ((rx [chan][1] << 8) | rx [chan][2]) & 0x3FF ;
 
-  return ((spiData [1] << 8) | spiData [2]) & 0x3FF ;
+  return count ;
 }
 
 
@@ -26,7 +26,8 @@
 extern "C" {
 #endif
 
-extern int mcp3004Setup (int pinBase, int spiChannel) ;
+extern int mcp3004Setup         (int pinBase, int spiChannel) ;
+extern int mcp3004AnalogReadAll (int pinBase, int *values, int count) ;	// Interface V3.15
 
 #ifdef __cplusplus
 }
@@ -23,14 +23,46 @@
  */
 
 #include <stdio.h>
+#include <errno.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
 #include "wiringPiI2C.h"
+#include "wiringPiRegmap.h"
 
 #include "pcf8574.h"
 
 
+// Register cache: the chip has no registers, the output latch (written,
+//	read back as the port at setup) and the port (read) are modelled as two
+
+#define	PCF8574_LATCH	0
+#define	PCF8574_PORT	1
+
+
+/*
+ * regRead: regWrite:
+ *	Bus functions of the register cache
+ *********************************************************************************
+ */
+
+static int regRead (void *ctx, UNU int reg, uint8_t *values, UNU int count)
+{
+  struct wiringPiNodeStruct *node = ctx ;
+
+  return wiringPiI2CWriteRead (node->fd, NULL, 0, values, 1) ;
+}
+
+static int regWrite (void *ctx, int reg, const uint8_t *values, UNU int count)
+{
+  struct wiringPiNodeStruct *node = ctx ;
+
+  if (reg != PCF8574_LATCH)
+    return -EINVAL ;
+  return wiringPiI2CWriteRead (node->fd, values, 1, NULL, 0) ;
+}
+
+
 /*
  * myPinMode:
  *	The PCF8574 is a 8-Bit I/O Expander with Open-drain output.
@@ -42,41 +74,22 @@
 
 static void myPinMode (struct wiringPiNodeStruct *node, int pin, int mode)
 {
-  int bit, old ;
-
-  bit  = 1 << ((pin - node->pinBase) & 7) ;
-
-  old = node->data2 ;
-  if (mode == OUTPUT)
-    old &= (~bit) ;	// Write bit to 0
-  else
-    old |=   bit ;	// Write bit to 1
-
-  wiringPiI2CWrite (node->fd, old) ;
-  node->data2 = old ;
+  wiringPiRegmapUpdate (node->regmap, PCF8574_LATCH,
+    1 << ((pin - node->pinBase) & 7), (mode == OUTPUT) ? 0 : 0xFF) ;
 }
 
 
 
 /*
  * myDigitalWrite:
+ *	Writing the level a pin has already does not go to the chip
  *********************************************************************************
  */
 
 static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 {
-  int bit, old ;
-
-  bit  = 1 << ((pin - node->pinBase) & 7) ;
-
-  old = node->data2 ;
-  if (value == LOW)
-    old &= (~bit) ;
-  else
-    old |=   bit ;
-
-  wiringPiI2CWrite (node->fd, old) ;
-  node->data2 = old ;
+  wiringPiRegmapUpdate (node->regmap, PCF8574_LATCH,
+    1 << ((pin - node->pinBase) & 7), (value == LOW) ? 0 : 0xFF) ;
 }
 
 
@@ -90,15 +103,39 @@ static int myDigitalRead (struct wiringPiNodeStruct *node, int pin)
   int mask, value ;
 
   mask  = 1 << ((pin - node->pinBase) & 7) ;
-  value = wiringPiI2CRead (node->fd) ;
+  value = wiringPiRegmapRead (node->regmap, PCF8574_PORT) ;
 
-  if ((value & mask) == 0)
+  if (value < 0 || (value & mask) == 0)
     return LOW ;
   else 
     return HIGH ;
 }
 
 
+/*
+ * myDigitalReadPort: myDigitalWritePort:
+ *	All 8 pins with one transfer
+ *********************************************************************************
+ */
+
+static unsigned int myDigitalReadPort (struct wiringPiNodeStruct *node, int pin, int bits)
+{
+  int value ;
+
+  if ((value = wiringPiRegmapRead (node->regmap, PCF8574_PORT)) < 0)
+    return 0 ;
+
+  return ((unsigned int)value >> (pin - node->pinBase)) & ((1u << bits) - 1) ;
+}
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, UNU int bits, unsigned int value, unsigned int mask)
+{
+  pin -= node->pinBase ;
+
+  wiringPiRegmapUpdate (node->regmap, PCF8574_LATCH, (mask << pin) & 0xFF, (value << pin) & 0xFF) ;
+}
+
+
 /*
  * pcf8574Setup:
  *	Create a new instance of a PCF8574 I2C GPIO interface. We know it
@@ -111,17 +148,25 @@ int pcf8574Setup (const int pinBase, const int i2cAddress)
 {
   int fd ;
   struct wiringPiNodeStruct *node ;
+  struct wiringPiRegmap *map ;
 
   if ((fd = wiringPiI2CSetup (i2cAddress)) < 0)
     return FALSE ;
 
   node = wiringPiNewNode (pinBase, 8) ;
+  node->fd = fd ;
 
-  node->fd           = fd ;
-  node->pinMode      = myPinMode ;
-  node->digitalRead  = myDigitalRead ;
-  node->digitalWrite = myDigitalWrite ;
-  node->data2        = wiringPiI2CRead (fd) ;
+  if ((map = wiringPiRegmapNew (2, 1, regRead, regWrite, node)) == NULL)
+    return FALSE ;
+  wiringPiRegmapVolatile (map, PCF8574_PORT, 1) ;
+  wiringPiRegmapLoad     (map, PCF8574_LATCH, 1) ;
+
+  node->regmap           = map ;
+  node->pinMode          = myPinMode ;
+  node->digitalRead      = myDigitalRead ;
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalReadPort  = myDigitalReadPort ;
+  node->digitalWritePort = myDigitalWritePort ;
 
   return TRUE ;
 }
@@ -23,7 +23,9 @@
  */
 
 #include <stdio.h>
-#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
@@ -42,57 +44,173 @@
 //	of 100 and a range of 100 gives a period of 100 * 100 = 10,000 µS
 //	which is a frequency of 100Hz.
 //
-//	It's possible to get a higher frequency by lowering the pulse time,
-//	however CPU uage will skyrocket as wiringPi uses a hard-loop to time
-//	periods under 100µS - this is because the Linux timer calls are just
-//	not accurate at all, and have an overhead.
-//
-//	Another way to increase the frequency is to reduce the range - however
-//	that reduces the overall output accuracy...
+//	softPwmCreateFreq sets the period of a pin directly, each pin has its
+//	own range and frequency.
 
 #define	PULSE_TIME	100
 
+// One thread serves all pins. It sleeps until the next edge of any pin
+//	(absolute deadline, no drift from the time spent writing) and then
+//	applies all edges due within SOFT_PWM_MERGE_NS with one masked write
+//	per bank, so the CPU load follows the number of edges, not the number
+//	of threads, and pins with the same period switch together.
+
+#define	SOFT_PWM_MERGE_NS	2000
+
+struct softPwmPin
+{
+  uint64_t period ;		// ns
+  uint64_t periodStart ;	// ns, CLOCK_MONOTONIC
+  uint64_t nextEdge ;
+  int      atStart ;		// next edge starts a new period
+  int      level ;
+  int      bank ;		// -1: not on a bank, single digitalWrite
+  unsigned int mask ;
+} ;
+
 static volatile int marks         [MAX_PINS] ;
 static volatile int range         [MAX_PINS] ;
-static volatile pthread_t threads [MAX_PINS] ;
-static volatile int newPin = -1 ;
+static struct softPwmPin pwmPins  [MAX_PINS] ;
+
+static pthread_mutex_t pwmMutex = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t  pwmCond ;
+static pthread_t       pwmThread ;
+static int             pwmCondInit      = FALSE ;
+static int             pwmThreadRunning = FALSE ;
+static int             pwmExit          = FALSE ;	// stopping, the thread is being joined
+static pthread_cond_t  pwmStopped = PTHREAD_COND_INITIALIZER ;
+static int             pwmActive        = 0 ;
+
+static struct softPwmStats pwmStats ;
+static long long int       pwmLatencySum ;
+
+
+static uint64_t softPwmNow (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
 
 
 /*
- * softPwmThread:
- *	Thread to do the actual PWM output
+ * softPwmEdge:
+ *	Advance one pin to its next edge and collect the level change
+ *	in the bank masks.
  *********************************************************************************
  */
 
-static void *softPwmThread (void *arg)
+static void softPwmEdge (int pin, uint64_t now, unsigned int *setMask, unsigned int *clrMask)
 {
-  int pin, mark, space ;
-  struct sched_param param ;
+  struct softPwmPin *p = &pwmPins [pin] ;
+  int mark, level ;
 
-  param.sched_priority = sched_get_priority_max (SCHED_RR) ;
-  pthread_setschedparam (pthread_self (), SCHED_RR, &param) ;
+  if (p->atStart)
+  {
+    if (now >= p->periodStart + p->period)	// late by a whole period, start again from now
+    {
+      p->periodStart = now ;
+      ++pwmStats.overruns ;
+    }
+    mark  = marks [pin] ;
+    level = (mark > 0) ;
+    if ((mark > 0) && (mark < range [pin]))
+    {
+      p->nextEdge = p->periodStart + p->period * mark / range [pin] ;
+      p->atStart  = FALSE ;
+    }
+    else
+    {
+      p->periodStart += p->period ;
+      p->nextEdge     = p->periodStart ;
+    }
+  }
+  else
+  {
+    level           = LOW ;
+    p->periodStart += p->period ;
+    p->nextEdge     = p->periodStart ;
+    p->atStart      = TRUE ;
+  }
 
-  pin = *((int *)arg) ;
-  free (arg) ;
+  if (level == p->level)
+    return ;
 
-  pin    = newPin ;
-  newPin = -1 ;
+  p->level = level ;
+  ++pwmStats.edges ;
+  if (p->bank < 0)
+  {
+    digitalWrite (pin, level) ;
+    ++pwmStats.writes ;
+  }
+  else if (level)
+    setMask [p->bank] |= p->mask ;
+  else
+    clrMask [p->bank] |= p->mask ;
+}
+
+
+/*
+ * softPwmThread:
+ *	Thread to do the actual PWM output for all pins
+ *********************************************************************************
+ */
+
+static void *softPwmThread (UNU void *arg)
+{
+  unsigned int setMask [2], clrMask [2] ;
+  struct timespec ts ;
+  uint64_t deadline, now ;
+  int pin, bank ;
 
   piHiPri (90) ;
 
-  for (;;)
+  pthread_mutex_lock (&pwmMutex) ;
+  while (!pwmExit)
   {
-    mark  = marks [pin] ;
-    space = range [pin] - mark ;
+    deadline = UINT64_MAX ;
+    for (pin = 0 ; pin < MAX_PINS ; ++pin)
+      if ((range [pin] != 0) && (pwmPins [pin].nextEdge < deadline))
+        deadline = pwmPins [pin].nextEdge ;
 
-    if (mark != 0)
-      digitalWrite (pin, HIGH) ;
-    delayMicroseconds (mark * 100) ;
+    if (deadline == UINT64_MAX)
+    {
+      pthread_cond_wait (&pwmCond, &pwmMutex) ;
+      continue ;
+    }
 
-    if (space != 0)
-      digitalWrite (pin, LOW) ;
-    delayMicroseconds (space * 100) ;
+    now = softPwmNow () ;
+    if (now < deadline)
+    {
+      ts.tv_sec  = deadline / 1000000000ULL ;
+      ts.tv_nsec = deadline % 1000000000ULL ;
+      pthread_cond_timedwait (&pwmCond, &pwmMutex, &ts) ;
+      now = softPwmNow () ;
+      if (now < deadline)		// woken up by softPwmCreate/softPwmStop
+        continue ;
+    }
+
+    ++pwmStats.wakeups ;
+    pwmLatencySum += now - deadline ;
+    if ((long long int)(now - deadline) > pwmStats.latencyMax_ns)
+      pwmStats.latencyMax_ns = now - deadline ;
+
+    setMask [0] = setMask [1] = clrMask [0] = clrMask [1] = 0 ;
+    for (pin = 0 ; pin < MAX_PINS ; ++pin)
+      if ((range [pin] != 0) && (pwmPins [pin].nextEdge <= now + SOFT_PWM_MERGE_NS))
+        softPwmEdge (pin, now, setMask, clrMask) ;
+
+    for (bank = 0 ; bank < 2 ; ++bank)
+    {
+      if ((setMask [bank] | clrMask [bank]) != 0)
+      {
+        digitalWriteMask (bank, setMask [bank], clrMask [bank]) ;
+        ++pwmStats.writes ;
+      }
+    }
   }
+  pthread_mutex_unlock (&pwmMutex) ;
 
   return NULL ;
 }
@@ -100,13 +218,13 @@ static void *softPwmThread (void *arg)
 
 /*
  * softPwmWrite:
- *	Write a PWM value to the given pin
+ *	Write a PWM value to the given pin, used from the start of the next period
  *********************************************************************************
  */
 
 void softPwmWrite (int pin, int value)
 {
-  if (pin < MAX_PINS)
+  if ((pin >= 0) && (pin < MAX_PINS))
   {
     /**/ if (value < 0)
       value = 0 ;
@@ -119,68 +237,166 @@ void softPwmWrite (int pin, int value)
 
 
 /*
+ * softPwmCreateFreq:
  * softPwmCreate:
- *	Create a new softPWM thread.
+ *	Start softPWM on a pin, with a period of frequency Hz or of
+ *	range * PULSE_TIME µS. The first pin starts the thread.
  *********************************************************************************
  */
 
-int softPwmCreate (int pin, int initialValue, int pwmRange)
+static int softPwmStart (int pin, int initialValue, int pwmRange, uint64_t period)
 {
-  int res ;
-  pthread_t myThread ;
-  int *passPin ;
-
-  if (pin >= MAX_PINS)
-    return -1 ;
+  pthread_condattr_t attr ;
+  struct softPwmPin *p ;
+  int other, res = 0 ;
 
-  if (range [pin] != 0)	// Already running on this pin
+  if ((pin < 0) || (pin >= MAX_PINS))
     return -1 ;
 
-  if (pwmRange <= 0)
+  if ((pwmRange <= 0) || (period == 0))
     return -1 ;
 
-  passPin = malloc (sizeof (*passPin)) ;
-  if (passPin == NULL)
+  if (range [pin] != 0)	// Already running on this pin
     return -1 ;
 
+  // pinMode stops softPWM on the pin, so not under the lock
   digitalWrite (pin, LOW) ;
   pinMode      (pin, OUTPUT) ;
 
-  marks [pin] = initialValue ;
-  range [pin] = pwmRange ;
+  pthread_mutex_lock (&pwmMutex) ;
+
+  while (pwmExit)		// the last softPwmStop is joining the old thread
+    pthread_cond_wait (&pwmStopped, &pwmMutex) ;
+
+  if (range [pin] != 0)	// Already running on this pin
+  {
+    pthread_mutex_unlock (&pwmMutex) ;
+    return -1 ;
+  }
+
+  if (!pwmCondInit)
+  {
+    pthread_condattr_init     (&attr) ;
+    pthread_condattr_setclock (&attr, CLOCK_MONOTONIC) ;
+    pthread_cond_init         (&pwmCond, &attr) ;
+    pthread_condattr_destroy  (&attr) ;
+    pwmCondInit = TRUE ;
+  }
+
+  if (!pwmThreadRunning)
+  {
+    res = pthread_create (&pwmThread, NULL, softPwmThread, NULL) ;
+    if (res != 0)
+    {
+      pthread_mutex_unlock (&pwmMutex) ;
+      return res ;
+    }
+    pwmThreadRunning = TRUE ;
+  }
 
-  *passPin = pin ;
-  newPin   = pin ;
-  res      = pthread_create (&myThread, NULL, softPwmThread, (void *)passPin) ;
+  p = &pwmPins [pin] ;
+  p->period      = period ;
+  p->periodStart = softPwmNow () ;
+  for (other = 0 ; other < MAX_PINS ; ++other)	// same period: in phase, one write for both
+  {
+    if ((range [other] != 0) && (pwmPins [other].period == period))
+    {
+      p->periodStart = pwmPins [other].periodStart ;
+      if (!pwmPins [other].atStart)
+        p->periodStart += period ;
+      break ;
+    }
+  }
+  p->nextEdge    = p->periodStart ;
+  p->atStart     = TRUE ;
+  p->level       = LOW ;
+  p->bank        = digitalPinToBank (pin) ;
+  p->mask        = digitalPinToBitMask (pin) ;
+  if (p->bank > 1)
+    p->bank = -1 ;
 
-  if (res != 0)
-    return res ;
-  
-  while (newPin != -1)
-    delay (1) ;
+  range [pin] = pwmRange ;
+  softPwmWrite (pin, initialValue) ;
+  ++pwmActive ;
 
-  threads [pin] = myThread ;
+  pthread_cond_signal   (&pwmCond) ;
+  pthread_mutex_unlock (&pwmMutex) ;
 
   return res ;
 }
 
+int softPwmCreateFreq (int pin, int initialValue, int pwmRange, unsigned int frequency)
+{
+  if (frequency == 0)
+    return -1 ;
+
+  return softPwmStart (pin, initialValue, pwmRange, 1000000000ULL / frequency) ;
+}
+
+int softPwmCreate (int pin, int initialValue, int pwmRange)
+{
+  if (pwmRange <= 0)
+    return -1 ;
+
+  return softPwmStart (pin, initialValue, pwmRange, (uint64_t)pwmRange * PULSE_TIME * 1000) ;
+}
+
 
 /*
  * softPwmStop:
- *	Stop an existing softPWM thread
+ *	Stop softPWM on a pin, the thread ends with the last pin
  *********************************************************************************
  */
 
 void softPwmStop (int pin)
 {
-  if (pin < MAX_PINS)
+  if ((pin < 0) || (pin >= MAX_PINS) || (range [pin] == 0))	// pinMode calls this for every pin
+    return ;
+
+  pthread_mutex_lock (&pwmMutex) ;
+  if (range [pin] == 0)
   {
-    if (range [pin] != 0)
-    {
-      pthread_cancel (threads [pin]) ;
-      pthread_join   (threads [pin], NULL) ;
-      range [pin] = 0 ;
-      digitalWrite (pin, LOW) ;
-    }
+    pthread_mutex_unlock (&pwmMutex) ;
+    return ;
+  }
+  range [pin] = 0 ;
+  digitalWrite (pin, LOW) ;
+
+  if (--pwmActive > 0)
+  {
+    pthread_mutex_unlock (&pwmMutex) ;
+    return ;
+  }
+
+  pwmExit = TRUE ;
+  pthread_cond_signal   (&pwmCond) ;
+  pthread_mutex_unlock (&pwmMutex) ;
+  pthread_join (pwmThread, NULL) ;
+
+  pthread_mutex_lock (&pwmMutex) ;
+  pwmThreadRunning = FALSE ;
+  pwmExit          = FALSE ;
+  pthread_cond_broadcast (&pwmStopped) ;
+  pthread_mutex_unlock   (&pwmMutex) ;
+}
+
+
+/*
+ * softPwmGetStats:
+ *	Scheduler counters and the wake up latency (time after the edge
+ *	deadline) as a measure of the output jitter.
+ *********************************************************************************
+ */
+
+void softPwmGetStats (struct softPwmStats *stats, int reset)
+{
+  pthread_mutex_lock (&pwmMutex) ;
+  *stats = pwmStats ;
+  stats->latencyAvg_ns = pwmStats.wakeups ? pwmLatencySum / (long long int)pwmStats.wakeups : 0 ;
+  if (reset)
+  {
+    memset (&pwmStats, 0, sizeof (pwmStats)) ;
+    pwmLatencySum = 0 ;
   }
+  pthread_mutex_unlock (&pwmMutex) ;
 }
@@ -26,9 +26,21 @@
 extern "C" {
 #endif
 
-extern int  softPwmCreate (int pin, int value, int range) ;
-extern void softPwmWrite  (int pin, int value) ;
-extern void softPwmStop   (int pin) ;
+struct softPwmStats
+{
+  unsigned long long int wakeups ;	// scheduler wake ups
+  unsigned long long int writes ;	// bank writes
+  unsigned long long int edges ;	// pin level changes
+  long long int latencyMax_ns ;		// worst wake up after an edge deadline
+  long long int latencyAvg_ns ;
+  unsigned int  overruns ;		// periods restarted, thread late by a whole period
+} ;
+
+extern int  softPwmCreate     (int pin, int value, int range) ;
+extern int  softPwmCreateFreq (int pin, int value, int range, unsigned int frequency) ; // Interface V3.15
+extern void softPwmWrite      (int pin, int value) ;
+extern void softPwmStop       (int pin) ;
+extern void softPwmGetStats   (struct softPwmStats *stats, int reset) ;              // Interface V3.15
 
 #ifdef __cplusplus
 }
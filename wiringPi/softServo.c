@@ -24,9 +24,10 @@
  */
 
 //#include <stdio.h>
+#include <errno.h>
+#include <stdint.h>
 #include <string.h>
 #include <time.h>
-#include <sys/time.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
@@ -64,10 +65,80 @@
 //	If you want servo control for the Pi, then use the servoblaster kernel
 //	module.
 
-#define	MAX_SERVOS	8
+//	The frame is timed with absolute CLOCK_MONOTONIC deadlines now: all
+//	pulses start together with one bank write, each one ends at its own
+//	deadline (frame start + width), sorted by width, pulses of the same
+//	width end with one write. The thread sleeps to shortly before each
+//	deadline and spins the last microseconds (the wake up latency measured
+//	at setup, delayMicrosecondsSpin). A late wake up delays only the pulse
+//	it belongs to, not the ones after it.
 
-static int pinMap     [MAX_SERVOS] ;	// Keep track of our pins
+#define	MAX_SERVOS	64
+#define	SERVO_FRAME_NS	8000000		// 8mS time-slot
+
+static int servoPins  [MAX_SERVOS] ;	// Keep track of our pins
 static int pulseWidth [MAX_SERVOS] ;	// microseconds
+static int servoBank  [MAX_SERVOS] ;	// -1: not on a bank, single digitalWrite
+static unsigned int servoMask [MAX_SERVOS] ;
+static int servoCount = 0 ;
+static int servoThreadRunning = FALSE ;
+
+static pthread_mutex_t servoMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+static struct softServoStats servoStats ;
+static long long int servoPulseLateSum ;
+
+
+static int64_t servoNow (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec ;
+}
+
+static void servoSleepUntil (int64_t deadline, int64_t spin)
+{
+  struct timespec ts ;
+
+  if (deadline - spin > servoNow ())
+  {
+    deadline  -= spin ;
+    ts.tv_sec  = (time_t)(deadline / 1000000000LL) ;
+    ts.tv_nsec = (long)(deadline % 1000000000LL) ;
+    while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+      ;
+    ++servoStats.wakeups ;
+    deadline += spin ;
+  }
+  while (servoNow () < deadline)
+    ;
+}
+
+
+/*
+ * softServoWriteLevel:
+ *	Write the servos in order [first, last) to one level, bank masks first
+ *********************************************************************************
+ */
+
+static void softServoWriteLevel (const int *order, int first, int last, int level)
+{
+  unsigned int mask [2] = { 0, 0 } ;
+  int i, servo, bank ;
+
+  for (i = first ; i < last ; ++i)
+  {
+    servo = order [i] ;
+    if (servoBank [servo] < 0)
+      digitalWrite (servoPins [servo], level) ;
+    else
+      mask [servoBank [servo]] |= servoMask [servo] ;
+  }
+  for (bank = 0 ; bank < 2 ; ++bank)
+    if (mask [bank] != 0)
+      digitalWriteMask (bank, level ? mask [bank] : 0, level ? 0 : mask [bank]) ;
+}
 
 
 /*
@@ -78,75 +149,75 @@ static int pulseWidth [MAX_SERVOS] ;	// microseconds
 
 static PI_THREAD (softServoThread)
 {
-  register int i, j, k, m, tmp ;
-  int lastDelay, pin, servo ;
-
-  int myDelays [MAX_SERVOS] ;
-  int myPins   [MAX_SERVOS] ;
+  int order  [MAX_SERVOS] ;
+  int widths [MAX_SERVOS] ;
+  int64_t frame, start, deadline, late, spin ;
+  int count, i, j, tmp ;
 
-  struct timeval  tNow, tStart, tPeriod, tGap, tTotal ;
-  struct timespec tNs ;
-
-  tTotal.tv_sec  =    0 ;
-  tTotal.tv_usec = 8000 ;
+  spin = delayMicrosecondsSpin () ;
 
   piHiPri (50) ;
 
+  frame = servoNow () ;
   for (;;)
   {
-    gettimeofday (&tStart, NULL) ;
-
-    memcpy (myDelays, pulseWidth, sizeof (myDelays)) ;
-    memcpy (myPins,   pinMap,     sizeof (myPins)) ;
-
-// Sort the delays (& pins), shortest first
-
-    for (m = MAX_SERVOS / 2 ; m > 0 ; m /= 2 )
-      for (j = m ; j < MAX_SERVOS ; ++j)
-	for (i = j - m ; i >= 0 ; i -= m)
-	{
-	  k = i + m ;
-	  if (myDelays [k] >= myDelays [i])
-	    break ;
-	  else // Swap
-	  {
-	    tmp = myDelays [i] ; myDelays [i] = myDelays [k] ; myDelays [k] = tmp ;
-	    tmp = myPins   [i] ; myPins   [i] = myPins   [k] ; myPins   [k] = tmp ;
-	  }
-	}
-
-// All on
-
-    lastDelay = 0 ;
-    for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
+    servoSleepUntil (frame, spin) ;
+    late = servoNow () - frame ;
+    if (late > SERVO_FRAME_NS)		// lost a whole frame, start again from now
     {
-      if ((pin = myPins [servo]) == -1)
-	continue ;
+      frame = servoNow () ;
+      late  = 0 ;
+    }
 
-      digitalWrite (pin, HIGH) ;
-      myDelays [servo] = myDelays [servo] - lastDelay ;
-      lastDelay += myDelays [servo] ;
+    pthread_mutex_lock (&servoMutex) ;
+    count = servoCount ;
+    for (i = 0 ; i < count ; ++i)
+    {
+      order  [i] = i ;
+      widths [i] = pulseWidth [i] ;
     }
 
-// Now loop, turning them all off as required
+// Sort by width, shortest first (insertion sort, mostly sorted from the last frame)
 
-    for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
+    for (i = 1 ; i < count ; ++i)
     {
-      if ((pin = myPins [servo]) == -1)
-	continue ;
+      tmp = order [i] ;
+      for (j = i ; (j > 0) && (widths [order [j - 1]] > widths [tmp]) ; --j)
+        order [j] = order [j - 1] ;
+      order [j] = tmp ;
+    }
+
+// All on, together
 
-      delayMicroseconds (myDelays [servo]) ;
-      digitalWrite (pin, LOW) ;
+    softServoWriteLevel (order, 0, count, HIGH) ;
+    start = servoNow () ;
+
+// Off at the own deadline, same widths together
+
+    for (i = 0 ; i < count ; i = j)
+    {
+      for (j = i + 1 ; (j < count) && (widths [order [j]] == widths [order [i]]) ; ++j)
+        ;
+      deadline = start + (int64_t)widths [order [i]] * 1000 ;
+      servoSleepUntil (deadline, spin) ;
+      late = servoNow () - deadline ;
+      softServoWriteLevel (order, i, j, LOW) ;
+
+      servoPulseLateSum += late ;
+      ++servoStats.pulses ;
+      if (late > servoStats.pulseLateMax_ns)
+        servoStats.pulseLateMax_ns = late ;
     }
+    pthread_mutex_unlock (&servoMutex) ;
+
+    late = start - frame ;
+    if (late > servoStats.frameLateMax_ns)
+      servoStats.frameLateMax_ns = late ;
+    ++servoStats.frames ;
 
-// Wait until the end of an 8mS time-slot
+// Wait until the end of the time-slot
 
-    gettimeofday (&tNow, NULL) ;
-    timersub (&tNow, &tStart, &tPeriod) ;
-    timersub (&tTotal, &tPeriod, &tGap) ;
-    tNs.tv_sec  = tGap.tv_sec ;
-    tNs.tv_nsec = tGap.tv_usec * 1000 ;
-    nanosleep (&tNs, NULL) ;
+    frame += SERVO_FRAME_NS ;
   }
 
   return NULL ;
@@ -163,49 +234,88 @@ void softServoWrite (int servoPin, int value)
 {
   int servo ;
 
-  servoPin &= 63 ;
-
   /**/ if (value < -250)
     value = -250 ;
   else if (value > 1250)
     value = 1250 ;
 
-  for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
-    if (pinMap [servo] == servoPin)
+  for (servo = 0 ; servo < servoCount ; ++servo)
+    if (servoPins [servo] == servoPin)
       pulseWidth [servo] = value + 1000 ; // uS
 }
 
 
 /*
+ * softServoGetStats:
+ *	Frame and pulse timing, late is the time after the planned edge.
+ *********************************************************************************
+ */
+
+void softServoGetStats (struct softServoStats *stats, int reset)
+{
+  pthread_mutex_lock (&servoMutex) ;
+  *stats = servoStats ;
+  stats->pulseLateAvg_ns = servoStats.pulses ? servoPulseLateSum / (long long int)servoStats.pulses : 0 ;
+  if (reset)
+  {
+    memset (&servoStats, 0, sizeof (servoStats)) ;
+    servoPulseLateSum = 0 ;
+  }
+  pthread_mutex_unlock (&servoMutex) ;
+}
+
+
+/*
+ * softServoSetupPins:
  * softServoSetup:
- *	Setup the software servo system
+ *	Setup the software servo system, pins may be added with later calls.
+ *	-1 pins are ignored.
  *********************************************************************************
  */
 
-int softServoSetup (int p0, int p1, int p2, int p3, int p4, int p5, int p6, int p7)
+int softServoSetupPins (const int *pins, int count)
 {
-  int servo ;
+  int i, servo, pin ;
+
+  pthread_mutex_lock (&servoMutex) ;
+  for (i = 0 ; i < count ; ++i)
+  {
+    if ((pin = pins [i]) == -1)
+      continue ;
+
+    for (servo = 0 ; servo < servoCount ; ++servo)
+      if (servoPins [servo] == pin)
+        break ;
+    if (servo < servoCount)		// Already a servo
+      continue ;
+    if (servoCount >= MAX_SERVOS)
+    {
+      pthread_mutex_unlock (&servoMutex) ;
+      return -1 ;
+    }
 
-  if (p0 != -1) { pinMode (p0, OUTPUT) ; digitalWrite (p0, LOW) ; }
-  if (p1 != -1) { pinMode (p1, OUTPUT) ; digitalWrite (p1, LOW) ; }
-  if (p2 != -1) { pinMode (p2, OUTPUT) ; digitalWrite (p2, LOW) ; }
-  if (p3 != -1) { pinMode (p3, OUTPUT) ; digitalWrite (p3, LOW) ; }
-  if (p4 != -1) { pinMode (p4, OUTPUT) ; digitalWrite (p4, LOW) ; }
-  if (p5 != -1) { pinMode (p5, OUTPUT) ; digitalWrite (p5, LOW) ; }
-  if (p6 != -1) { pinMode (p6, OUTPUT) ; digitalWrite (p6, LOW) ; }
-  if (p7 != -1) { pinMode (p7, OUTPUT) ; digitalWrite (p7, LOW) ; }
-
-  pinMap [0] = p0 ;
-  pinMap [1] = p1 ;
-  pinMap [2] = p2 ;
-  pinMap [3] = p3 ;
-  pinMap [4] = p4 ;
-  pinMap [5] = p5 ;
-  pinMap [6] = p6 ;
-  pinMap [7] = p7 ;
-
-  for (servo = 0 ; servo < MAX_SERVOS ; ++servo)
-    pulseWidth [servo] = 1500 ;		// Mid point
-  
+    pinMode (pin, OUTPUT) ; digitalWrite (pin, LOW) ;
+
+    servoPins  [servoCount] = pin ;
+    pulseWidth [servoCount] = 1500 ;	// Mid point
+    servoBank  [servoCount] = digitalPinToBank (pin) ;
+    servoMask  [servoCount] = digitalPinToBitMask (pin) ;
+    if (servoBank [servoCount] > 1)
+      servoBank [servoCount] = -1 ;
+    ++servoCount ;
+  }
+  pthread_mutex_unlock (&servoMutex) ;
+
+  if (servoThreadRunning)
+    return 0 ;
+
+  servoThreadRunning = TRUE ;
   return piThreadCreate (softServoThread) ;
 }
+
+int softServoSetup (int p0, int p1, int p2, int p3, int p4, int p5, int p6, int p7)
+{
+  int pins [8] = { p0, p1, p2, p3, p4, p5, p6, p7 } ;
+
+  return softServoSetupPins (pins, 8) ;
+}
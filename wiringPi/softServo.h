@@ -27,8 +27,20 @@
 extern "C" {
 #endif
 
-extern void softServoWrite  (int pin, int value) ;
-extern int softServoSetup   (int p0, int p1, int p2, int p3, int p4, int p5, int p6, int p7) ;
+struct softServoStats
+{
+  unsigned long long int frames ;
+  unsigned long long int pulses ;	// pulse ends, same widths count once
+  unsigned long long int wakeups ;	// sleeps, the rest is spun
+  long long int frameLateMax_ns ;	// frame start after its deadline
+  long long int pulseLateMax_ns ;	// pulse end after its deadline
+  long long int pulseLateAvg_ns ;
+} ;
+
+extern void softServoWrite     (int pin, int value) ;
+extern int  softServoSetup     (int p0, int p1, int p2, int p3, int p4, int p5, int p6, int p7) ;
+extern int  softServoSetupPins (const int *pins, int count) ;                 // Interface V3.15
+extern void softServoGetStats  (struct softServoStats *stats, int reset) ;    // Interface V3.15
 
 #ifdef __cplusplus
 }
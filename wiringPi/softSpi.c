@@ -0,0 +1,433 @@
+/*
+ * softSpi.c:
+ *	SPI master on any GPIO pins, as extra wiringPiSPI bus numbers.
+ *	All four modes, 8, 16 and 32 bit words, up to 16 chip selects.
+ *	Copyright (c) 2012-2024 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "wiringPi.h"
+#include "wiringPiSPI.h"
+#include "softSpi.h"
+
+// A bus: all pins are in one GPIO bank, resolved to masks at setup,
+//	so an edge is one digitalWriteMask and a sample one digitalReadBank.
+
+struct softSpiBus
+{
+  int                used ;
+  int                bank ;
+  unsigned int       sclk, mosi, miso ;
+  unsigned int       cs        [SOFT_SPI_CHANNELS] ;
+  int                mode      [SOFT_SPI_CHANNELS] ;
+  unsigned int       speed     [SOFT_SPI_CHANNELS] ;	// clock rate in Hz, 0 = as fast as possible
+  int                channels ;
+  pthread_mutex_t    lock ;
+} ;
+
+static struct softSpiBus buses [SOFT_SPI_LAST - SOFT_SPI_FIRST + 1] ;
+static pthread_mutex_t   setupMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+
+/*
+ * softSpiIsBus:
+ *	Is the bus number one of the software buses
+ *********************************************************************************
+ */
+
+int softSpiIsBus (int number)
+{
+  return (number >= SOFT_SPI_FIRST) && (number <= SOFT_SPI_LAST) ;
+}
+
+
+/*
+ * getBus:
+ *	Return the set up bus for number and channel, NULL with a message if not
+ *********************************************************************************
+ */
+
+static struct softSpiBus *getBus (int number, int channel)
+{
+  struct softSpiBus *bus ;
+
+  if (!softSpiIsBus (number) || !buses [number - SOFT_SPI_FIRST].used)
+  {
+    fprintf (stderr, "softSpi: SPI bus %d is not set up (softSpiSetup)\n", number) ;
+    return NULL ;
+  }
+  bus = &buses [number - SOFT_SPI_FIRST] ;
+  if (channel < 0 || channel >= bus->channels)
+  {
+    fprintf (stderr, "softSpi: Invalid SPI channel (%d, valid range 0-%d)\n", channel, bus->channels - 1) ;
+    return NULL ;
+  }
+  return bus ;
+}
+
+
+/*
+ * softSpiSetup:
+ *	Create software SPI bus number (SOFT_SPI_FIRST..SOFT_SPI_LAST) on the
+ *	given pins, in the numbering scheme in use. mosi, miso and chip select
+ *	pins may be -1 if not connected. All pins must be on-board pins in the
+ *	same GPIO bank. Calling it again for a bus replaces the pins.
+ *	The channels start in mode 0 at the maximum rate.
+ *********************************************************************************
+ */
+
+int softSpiSetup (int number, int sclk, int mosi, int miso, const int *csPins, int channels)
+{
+  struct softSpiBus *bus ;
+  unsigned int csAll = 0 ;
+  int bank, ch ;
+
+  if (!softSpiIsBus (number))
+  {
+    fprintf (stderr, "softSpi: Invalid SPI number (%d, valid range %d-%d)\n", number, SOFT_SPI_FIRST, SOFT_SPI_LAST) ;
+    return -EINVAL ;
+  }
+  if (channels < 1 || channels > SOFT_SPI_CHANNELS)
+  {
+    fprintf (stderr, "softSpi: Invalid number of channels (%d, valid range 1-%d)\n", channels, SOFT_SPI_CHANNELS) ;
+    return -EINVAL ;
+  }
+
+  bank = digitalPinToBank (sclk) ;
+  if ((bank < 0) ||
+      ((mosi >= 0) && (digitalPinToBank (mosi) != bank)) ||
+      ((miso >= 0) && (digitalPinToBank (miso) != bank)))
+  {
+    fprintf (stderr, "softSpi: SPI bus %d pins must be on-board pins in one GPIO bank\n", number) ;
+    return -EINVAL ;
+  }
+  for (ch = 0 ; ch < channels ; ++ch)
+    if ((csPins != NULL) && (csPins [ch] >= 0) && (digitalPinToBank (csPins [ch]) != bank))
+    {
+      fprintf (stderr, "softSpi: SPI bus %d pins must be on-board pins in one GPIO bank\n", number) ;
+      return -EINVAL ;
+    }
+
+  pthread_mutex_lock (&setupMutex) ;
+  bus = &buses [number - SOFT_SPI_FIRST] ;
+  if (!bus->used)
+    pthread_mutex_init (&bus->lock, NULL) ;
+  pthread_mutex_lock (&bus->lock) ;
+
+  bus->bank = bank ;
+  bus->sclk = digitalPinToBitMask (sclk) ;
+  bus->mosi = (mosi >= 0) ? digitalPinToBitMask (mosi) : 0 ;
+  bus->miso = (miso >= 0) ? digitalPinToBitMask (miso) : 0 ;
+  for (ch = 0 ; ch < SOFT_SPI_CHANNELS ; ++ch)
+  {
+    bus->cs        [ch] = ((ch < channels) && (csPins != NULL) && (csPins [ch] >= 0)) ? digitalPinToBitMask (csPins [ch]) : 0 ;
+    bus->mode      [ch] = 0 ;
+    bus->speed     [ch] = 0 ;
+    csAll |= bus->cs [ch] ;
+  }
+  bus->channels = channels ;
+  bus->used     = TRUE ;
+
+// Chip selects high, clock and data low before they become outputs
+
+  if (miso >= 0)
+    pinMode (miso, INPUT) ;
+  digitalWriteMask (bank, csAll, bus->sclk | bus->mosi) ;
+  for (ch = 0 ; ch < channels ; ++ch)
+    if ((csPins != NULL) && (csPins [ch] >= 0))
+      pinMode (csPins [ch], OUTPUT) ;
+  pinMode (sclk, OUTPUT) ;
+  if (mosi >= 0)
+    pinMode (mosi, OUTPUT) ;
+  digitalWriteMask (bank, csAll, bus->sclk | bus->mosi) ;
+
+  pthread_mutex_unlock (&bus->lock) ;
+  pthread_mutex_unlock (&setupMutex) ;
+
+  return 0 ;
+}
+
+
+/*
+ * halfPeriod:
+ *	Half clock period in ticks of the time source, 0 = as fast as possible.
+ *	Converted for every transfer, the tick rate changes with the setup.
+ *********************************************************************************
+ */
+
+static unsigned long long halfPeriod (unsigned int speed)
+{
+  unsigned long long freq = piTicksFrequency () ;
+
+  return (speed > 0) ? (freq + 2ULL*speed - 1) / (2ULL*speed) : 0 ;
+}
+
+
+/*
+ * softSpiSetupMode:
+ *	Set the clock rate in Hz (0 = as fast as the GPIO block allows) and the
+ *	SPI mode 0..3 of a channel.
+ *********************************************************************************
+ */
+
+int softSpiSetupMode (int number, int channel, int speed, int mode)
+{
+  struct softSpiBus *bus ;
+
+  if ((bus = getBus (number, channel)) == NULL)
+    return -EBADF ;
+  if (mode < 0 || mode > 3)
+  {
+    fprintf (stderr, "softSpi: Invalid mode (%d, valid range 0-3)\n", mode) ;
+    return -EINVAL ;
+  }
+
+  pthread_mutex_lock (&bus->lock) ;
+  bus->mode      [channel] = mode ;
+  bus->speed     [channel] = (speed > 0) ? speed : 0 ;
+  pthread_mutex_unlock (&bus->lock) ;
+
+  return 0 ;
+}
+
+
+/*
+ * softSpiClose:
+ *	Put a channel back to mode 0 at the maximum rate, the pins stay.
+ *********************************************************************************
+ */
+
+int softSpiClose (int number, int channel)
+{
+  return softSpiSetupMode (number, channel, 0, 0) ;
+}
+
+
+/*
+ * spiWait:
+ *	Make sure half a clock period has gone since the last edge, and
+ *	remember when the next one is made.
+ *********************************************************************************
+ */
+
+static inline void spiWait (unsigned long long halfTicks, unsigned long long *edge)
+{
+  unsigned long long now ;
+
+  if (halfTicks == 0)
+    return ;
+
+  while (((now = piTicks ()) - *edge) < halfTicks)
+    ;
+  *edge = now ;
+}
+
+
+/*
+ * shiftWords:
+ *	Full duplex transfer of len bytes, MSB first, in words of bitsPerWord
+ *	(native byte order like spidev), the chip select is up to the caller.
+ *	A bit is one write setting the data and the first clock edge (with
+ *	CPHA 1) or idle clock (CPHA 0), one write for the other clock edge and
+ *	one read of the bank sampling MISO. Ends with the clock idle.
+ *********************************************************************************
+ */
+
+static void shiftWords (struct softSpiBus *bus, int mode, unsigned long long halfTicks, unsigned long long *edge,
+  const void *tx, void *rx, int len, int bitsPerWord)
+{
+  unsigned int idle, active, set, first, second ;
+  uint32_t out, in ;
+  int bytes, word, bit, cpha, bank ;
+
+  bank   = bus->bank ;
+  bytes  = bitsPerWord / 8 ;
+  cpha   = mode & 1 ;
+  idle   = (mode & 2) ? bus->sclk : 0 ;
+  active = bus->sclk ^ idle ;
+  first  = cpha ? active : idle ;	// clock with the data
+  second = cpha ? idle : active ;	// sampling edge
+
+  for (word = 0 ; word < len / bytes ; ++word)
+  {
+    out = 0 ;
+    in  = 0 ;
+    if (tx != NULL)
+    {
+      if (bytes == 1)
+        out = ((const uint8_t *)tx) [word] ;
+      else if (bytes == 2)
+      {
+        uint16_t w ;
+        memcpy (&w, (const uint8_t *)tx + word*2, 2) ;
+        out = w ;
+      }
+      else
+        memcpy (&out, (const uint8_t *)tx + word*4, 4) ;
+    }
+
+    for (bit = bitsPerWord - 1 ; bit >= 0 ; --bit)
+    {
+      set = ((out >> bit) & 1) ? bus->mosi : 0 ;
+      spiWait (halfTicks, edge) ;
+      digitalWriteMask (bank, set | first, (bus->mosi & ~set) | (bus->sclk & ~first)) ;
+      spiWait (halfTicks, edge) ;
+      digitalWriteMask (bank, second, bus->sclk & ~second) ;
+      if (bus->miso)
+        in = (in << 1) | ((digitalReadBank (bank) & bus->miso) ? 1 : 0) ;
+    }
+
+    if (rx != NULL)
+    {
+      if (bytes == 1)
+        ((uint8_t *)rx) [word] = (uint8_t)in ;
+      else if (bytes == 2)
+      {
+        uint16_t w = (uint16_t)in ;
+        memcpy ((uint8_t *)rx + word*2, &w, 2) ;
+      }
+      else
+        memcpy ((uint8_t *)rx + word*4, &in, 4) ;
+    }
+  }
+
+  if (!cpha && len > 0)
+  {
+    spiWait (halfTicks, edge) ;
+    digitalWriteMask (bank, idle, active) ;
+  }
+}
+
+
+/*
+ * softSpiTransaction:
+ * softSpiTransactionMode:
+ *	Run the segments with the chip select held, like SPI_IOC_MESSAGE(n).
+ *	csChange releases the chip select between a segment and the next one,
+ *	it is always released at the end. The mode version clocks in the given
+ *	mode instead of the one of the channel (-1), the channel keeps its own.
+ *	Returns the number of bytes transferred.
+ *********************************************************************************
+ */
+
+int softSpiTransaction (int number, int channel, const struct wiringPiSPISegment *segs, int count)
+{
+  return softSpiTransactionMode (number, channel, -1, segs, count) ;
+}
+
+int softSpiTransactionMode (int number, int channel, int spiMode, const struct wiringPiSPISegment *segs, int count)
+{
+  struct softSpiBus *bus ;
+  unsigned long long halfTicks, busTicks, edge = 0 ;
+  unsigned int idle, cs ;
+  int i, bits, mode, total = 0 ;
+
+  if ((bus = getBus (number, channel)) == NULL)
+    return -EBADF ;
+  if (count < 0 || (count > 0 && segs == NULL) || spiMode < -1 || spiMode > 3)
+    return -EINVAL ;
+  for (i = 0 ; i < count ; ++i)
+  {
+    bits = segs [i].bitsPerWord ? segs [i].bitsPerWord : 8 ;
+    if (bits != 8 && bits != 16 && bits != 32)
+    {
+      fprintf (stderr, "softSpi: Invalid bits per word (%d, valid 8, 16, 32)\n", bits) ;
+      return -EINVAL ;
+    }
+    if ((segs [i].len % (bits / 8)) != 0)
+      return -EINVAL ;
+  }
+
+  pthread_mutex_lock (&bus->lock) ;
+
+  busTicks = halfPeriod (bus->speed [channel]) ;
+  cs   = bus->cs   [channel] ;
+  mode = (spiMode < 0) ? bus->mode [channel] : spiMode ;
+  idle = (mode & 2) ? bus->sclk : 0 ;
+
+  digitalWriteMask (bus->bank, idle, bus->sclk ^ idle) ;
+  if (cs)
+  {
+    digitalWriteMask (bus->bank, 0, cs) ;
+    edge = piTicks () ;
+  }
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    halfTicks = segs [i].speed ? halfPeriod (segs [i].speed) : busTicks ;
+    shiftWords (bus, mode, halfTicks, &edge, segs [i].tx, segs [i].rx, segs [i].len,
+      segs [i].bitsPerWord ? segs [i].bitsPerWord : 8) ;
+    total += segs [i].len ;
+
+    if (segs [i].delay_us)
+      delayMicroseconds (segs [i].delay_us) ;
+    if (segs [i].csChange && cs && (i < count - 1))
+    {
+      spiWait (halfTicks, &edge) ;
+      digitalWriteMask (bus->bank, cs, 0) ;
+      spiWait (halfTicks, &edge) ;
+      digitalWriteMask (bus->bank, 0, cs) ;
+    }
+  }
+
+  if (cs)
+  {
+    spiWait (busTicks, &edge) ;
+    digitalWriteMask (bus->bank, cs, 0) ;
+  }
+
+  pthread_mutex_unlock (&bus->lock) ;
+  return total ;
+}
+
+
+/*
+ * softSpiTransfer:
+ *	One segment of len bytes in words of bitsPerWord (8, 16 or 32 bit).
+ *	tx NULL sends zeros, rx NULL drops the data read, tx and rx may be
+ *	the same buffer.
+ *********************************************************************************
+ */
+
+int softSpiTransfer (int number, int channel, const void *tx, void *rx, int len, int bitsPerWord)
+{
+  struct wiringPiSPISegment seg ;
+
+  if (bitsPerWord != 8 && bitsPerWord != 16 && bitsPerWord != 32)
+  {
+    fprintf (stderr, "softSpi: Invalid bits per word (%d, valid 8, 16, 32)\n", bitsPerWord) ;
+    return -EINVAL ;
+  }
+  if (len < 0)
+    return -EINVAL ;
+
+  memset (&seg, 0, sizeof (seg)) ;
+  seg.tx          = tx ;
+  seg.rx          = rx ;
+  seg.len         = len ;
+  seg.bitsPerWord = bitsPerWord ;
+  return softSpiTransaction (number, channel, &seg, 1) ;
+}
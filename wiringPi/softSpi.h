@@ -0,0 +1,47 @@
+/*
+ * softSpi.h:
+ *	SPI master on any GPIO pins, as extra wiringPiSPI bus numbers
+ *	Copyright (c) 2012-2024 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bus numbers after the spidev ones (0..6) and chip selects per bus
+
+#define	SOFT_SPI_FIRST		7
+#define	SOFT_SPI_LAST		15
+#define	SOFT_SPI_CHANNELS	16
+
+struct wiringPiSPISegment ;	// wiringPiSPI.h
+
+extern int softSpiSetup     (int number, int sclk, int mosi, int miso, const int *csPins, int channels) ; // Interface V3.15
+extern int softSpiIsBus     (int number) ;                                                               // Interface V3.15
+extern int softSpiSetupMode (int number, int channel, int speed, int mode) ;                             // Interface V3.15
+extern int softSpiTransfer  (int number, int channel, const void *tx, void *rx, int len, int bitsPerWord) ; // Interface V3.15
+extern int softSpiTransaction (int number, int channel, const struct wiringPiSPISegment *segs, int count) ; // Interface V3.15
+extern int softSpiTransactionMode (int number, int channel, int spiMode, const struct wiringPiSPISegment *segs, int count) ; // Interface V3.15
+extern int softSpiClose     (int number, int channel) ;                                                  // Interface V3.15
+
+#ifdef __cplusplus
+}
+#endif
@@ -27,6 +27,8 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "wiringPi.h"
@@ -34,49 +36,267 @@
 
 #define	MAX_PINS	64
 
-#define	PULSE_TIME	100
+// One thread drives all tone pins on a common tick. Every pin has a 32 bit
+//	phase accumulator advanced by a fixed point increment per tick, an
+//	overflow toggles the output (so the increment is 2 * freq / tick rate).
+//	The thread sleeps (absolute deadline) to the next tick on which any pin
+//	toggles or a note ends, all toggles of that tick go out in one bank write.
 
-static int freqs         [MAX_PINS] ;
-static pthread_t threads [MAX_PINS] ;
+#define	TONE_TICK_NS	10000		// 100 kHz
+#define	TONE_TICK_RATE	(1000000000 / TONE_TICK_NS)
+#define	TONE_MAX_FREQ	5000
+#define	TONE_QUEUE	64
 
-static int newPin = -1 ;
+struct softToneNote
+{
+  int      freq ;
+  uint64_t ticks ;
+} ;
+
+struct softTonePin
+{
+  int      running ;
+  int      freq ;			// playing now
+  uint32_t phase ;
+  uint32_t inc ;
+  int      level ;
+  int      bank ;			// -1: not on a bank, single digitalWrite
+  unsigned int mask ;
+  uint64_t noteEnd ;			// tick, 0: no note playing
+  struct softToneNote queue [TONE_QUEUE] ;
+  unsigned int head, count ;
+} ;
+
+static int freqs [MAX_PINS] ;		// requested with softToneWrite
+static struct softTonePin tonePins [MAX_PINS] ;
+
+static pthread_mutex_t toneMutex = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t  toneCond ;
+static pthread_t       toneThread ;
+static int             toneCondInit      = FALSE ;
+static int             toneThreadRunning = FALSE ;
+static int             toneExit          = FALSE ;	// stopping, the thread is being joined
+static pthread_cond_t  toneStopped = PTHREAD_COND_INITIALIZER ;
+static int             toneActive        = 0 ;
+
+static uint64_t toneTickBase ;		// ns, CLOCK_MONOTONIC of tick 0
+static uint64_t toneTickNow ;		// all accumulators are at this tick
+
+
+static uint64_t softToneNow (void)
+{
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
 
 
 /*
- * softToneThread:
- *	Thread to do the actual PWM output
+ * softToneLevel:
+ * softToneSetFreq:
+ *	Collect a level change in the bank masks, change the frequency of a
+ *	pin keeping the phase. A tone starting from silence goes HIGH at once.
  *********************************************************************************
  */
 
-static PI_THREAD (softToneThread)
+static void softToneLevel (int pin, int level, unsigned int *setMask, unsigned int *clrMask)
+{
+  struct softTonePin *p = &tonePins [pin] ;
+
+  if (level == p->level)
+    return ;
+
+  p->level = level ;
+  if (p->bank < 0)
+    digitalWrite (pin, level) ;
+  else if (level)
+  {
+    setMask [p->bank] |=  p->mask ;
+    clrMask [p->bank] &= ~p->mask ;
+  }
+  else
+  {
+    clrMask [p->bank] |=  p->mask ;
+    setMask [p->bank] &= ~p->mask ;
+  }
+}
+
+static void softToneSetFreq (int pin, int freq, unsigned int *setMask, unsigned int *clrMask)
+{
+  struct softTonePin *p = &tonePins [pin] ;
+
+  if (freq == p->freq)
+    return ;
+
+  if (freq == 0)
+  {
+    p->inc = 0 ;
+    softToneLevel (pin, LOW, setMask, clrMask) ;
+  }
+  else
+  {
+    p->inc = (uint32_t)(((uint64_t)freq * 2 << 32) / TONE_TICK_RATE) ;
+    if (p->freq == 0)
+    {
+      p->phase = 0 ;
+      softToneLevel (pin, HIGH, setMask, clrMask) ;
+    }
+  }
+  p->freq = freq ;
+}
+
+
+/*
+ * softToneNextNote:
+ *	Start the next queued note at the current tick, silence at the end
+ *********************************************************************************
+ */
+
+static void softToneNextNote (int pin, unsigned int *setMask, unsigned int *clrMask)
+{
+  struct softTonePin *p = &tonePins [pin] ;
+  struct softToneNote *note ;
+
+  if (p->count == 0)
+  {
+    p->noteEnd  = 0 ;
+    freqs [pin] = 0 ;
+    softToneSetFreq (pin, 0, setMask, clrMask) ;
+    return ;
+  }
+
+  note       = &p->queue [p->head] ;
+  p->head    = (p->head + 1) % TONE_QUEUE ;
+  p->count  -= 1 ;
+  p->noteEnd = (p->noteEnd != 0 ? p->noteEnd : toneTickNow) + note->ticks ;	// back to back, even if woken late
+  freqs [pin] = note->freq ;
+  softToneSetFreq (pin, note->freq, setMask, clrMask) ;
+}
+
+
+/*
+ * softToneAdvance:
+ *	Move all accumulators to tick, toggling the pins that overflow on it.
+ *	No pin overflows between toneTickNow and tick, unless the thread woke
+ *	up late: then the pin toggles once and its phase restarts, so the
+ *	next half period is a full one and no toggles are lost in pairs.
+ *********************************************************************************
+ */
+
+static void softToneAdvance (uint64_t tick, unsigned int *setMask, unsigned int *clrMask)
 {
-  int pin, freq, halfPeriod ;
-  struct sched_param param ;
+  struct softTonePin *p ;
+  uint64_t delta = tick - toneTickNow ;
+  uint64_t phase ;
+  int pin ;
+
+  if (delta == 0)
+    return ;
+
+  for (pin = 0 ; pin < MAX_PINS ; ++pin)
+  {
+    p = &tonePins [pin] ;
+    if (!p->running || (p->inc == 0))
+      continue ;
+    phase    = (uint64_t)p->phase + delta * p->inc ;
+    p->phase = (uint32_t)phase ;
+    if ((phase >> 32) == 0)
+      continue ;
+    if ((phase >> 32) > 1)		// woken late, toggles were due before tick
+      p->phase = 0 ;
+    softToneLevel (pin, !p->level, setMask, clrMask) ;
+  }
+  toneTickNow = tick ;
+}
 
-  param.sched_priority = sched_get_priority_max (SCHED_RR) ;
-  pthread_setschedparam (pthread_self (), SCHED_RR, &param) ;
 
-  pin    = newPin ;
-  newPin = -1 ;
+/*
+ * softToneThread:
+ *	Thread to do the actual tone output for all pins
+ *********************************************************************************
+ */
+
+static PI_THREAD (softToneThread)
+{
+  unsigned int setMask [2], clrMask [2] ;
+  struct softTonePin *p ;
+  struct timespec ts ;
+  uint64_t next, wrap, deadline, now ;
+  int pin, bank, idle = TRUE ;
 
   piHiPri (50) ;
 
-  for (;;)
+  pthread_mutex_lock (&toneMutex) ;
+  while (!toneExit)
   {
-    freq = freqs [pin] ;
-    if (freq == 0)
-      delay (1) ;
-    else
+    setMask [0] = setMask [1] = clrMask [0] = clrMask [1] = 0 ;
+
+    now = softToneNow () ;
+    if (idle)			// restart the tick grid
     {
-      halfPeriod = 500000 / freq ;
+      toneTickBase = now ;
+      toneTickNow  = 0 ;
+    }
+    else if (now > toneTickBase + toneTickNow * TONE_TICK_NS)
+      softToneAdvance ((now - toneTickBase) / TONE_TICK_NS, setMask, clrMask) ;
+
+    // apply softToneWrite, queued notes that are due
+    for (pin = 0 ; pin < MAX_PINS ; ++pin)
+    {
+      p = &tonePins [pin] ;
+      if (!p->running)
+        continue ;
+      if ((p->noteEnd != 0) && (p->noteEnd <= toneTickNow))
+        softToneNextNote (pin, setMask, clrMask) ;
+      else if ((p->noteEnd == 0) && (p->count > 0))
+        softToneNextNote (pin, setMask, clrMask) ;
+      else if (p->noteEnd == 0)
+        softToneSetFreq (pin, freqs [pin], setMask, clrMask) ;
+    }
+
+    for (bank = 0 ; bank < 2 ; ++bank)
+      if ((setMask [bank] | clrMask [bank]) != 0)
+        digitalWriteMask (bank, setMask [bank], clrMask [bank]) ;
 
-      digitalWrite (pin, HIGH) ;
-      delayMicroseconds (halfPeriod) ;
+    // next tick with a toggle or a note end
+    next = UINT64_MAX ;
+    for (pin = 0 ; pin < MAX_PINS ; ++pin)
+    {
+      p = &tonePins [pin] ;
+      if (!p->running)
+        continue ;
+      if (p->inc != 0)
+      {
+        wrap = ((1ULL << 32) - p->phase + p->inc - 1) / p->inc ;
+        if (toneTickNow + wrap < next)
+          next = toneTickNow + wrap ;
+      }
+      if ((p->noteEnd != 0) && (p->noteEnd < next))
+        next = p->noteEnd ;
+    }
 
-      digitalWrite (pin, LOW) ;
-      delayMicroseconds (halfPeriod) ;
+    if (next == UINT64_MAX)
+    {
+      idle = TRUE ;
+      pthread_cond_wait (&toneCond, &toneMutex) ;
+      continue ;
     }
+    idle = FALSE ;
+
+    deadline   = toneTickBase + next * TONE_TICK_NS ;
+    ts.tv_sec  = deadline / 1000000000ULL ;
+    ts.tv_nsec = deadline % 1000000000ULL ;
+    if (pthread_cond_timedwait (&toneCond, &toneMutex, &ts) == 0)
+      continue ;		// softToneWrite/Queue/Stop, catch up to now on the next round
+
+    setMask [0] = setMask [1] = clrMask [0] = clrMask [1] = 0 ;
+    softToneAdvance (next, setMask, clrMask) ;
+    for (bank = 0 ; bank < 2 ; ++bank)
+      if ((setMask [bank] | clrMask [bank]) != 0)
+        digitalWriteMask (bank, setMask [bank], clrMask [bank]) ;
   }
+  pthread_mutex_unlock (&toneMutex) ;
 
   return NULL ;
 }
@@ -84,7 +304,7 @@ static PI_THREAD (softToneThread)
 
 /*
  * softToneWrite:
- *	Write a frequency value to the given pin
+ *	Write a frequency value to the given pin, drops queued notes
  *********************************************************************************
  */
 
@@ -94,39 +314,147 @@ void softToneWrite (int pin, int freq)
 
   /**/ if (freq < 0)
     freq = 0 ;
-  else if (freq > 5000)	// Max 5KHz
-    freq = 5000 ;
+  else if (freq > TONE_MAX_FREQ)	// Max 5KHz
+    freq = TONE_MAX_FREQ ;
 
+  pthread_mutex_lock (&toneMutex) ;
+  tonePins [pin].count   = 0 ;
+  tonePins [pin].noteEnd = 0 ;
   freqs [pin] = freq ;
+  if (toneCondInit)
+    pthread_cond_signal (&toneCond) ;
+  pthread_mutex_unlock (&toneMutex) ;
+}
+
+
+/*
+ * softToneQueue:
+ * softToneQueued:
+ *	Queue a note (freq 0: rest) to play after the notes before it, the
+ *	pin is silent when the queue runs empty. Returns -1 if the pin is not
+ *	running or the queue is full. softToneQueued returns the number of
+ *	notes not yet finished.
+ *********************************************************************************
+ */
+
+int softToneQueue (int pin, int freq, unsigned int duration_ms)
+{
+  struct softTonePin *p ;
+  struct softToneNote *note ;
+
+  if ((pin < 0) || (pin >= MAX_PINS))
+    return -1 ;
+
+  /**/ if (freq < 0)
+    freq = 0 ;
+  else if (freq > TONE_MAX_FREQ)
+    freq = TONE_MAX_FREQ ;
+
+  pthread_mutex_lock (&toneMutex) ;
+  p = &tonePins [pin] ;
+  if (!p->running || (p->count >= TONE_QUEUE))
+  {
+    pthread_mutex_unlock (&toneMutex) ;
+    return -1 ;
+  }
+  note        = &p->queue [(p->head + p->count) % TONE_QUEUE] ;
+  note->freq  = freq ;
+  note->ticks = (uint64_t)duration_ms * (1000000 / TONE_TICK_NS) ;
+  if (note->ticks == 0)
+    note->ticks = 1 ;
+  p->count += 1 ;
+  pthread_cond_signal  (&toneCond) ;
+  pthread_mutex_unlock (&toneMutex) ;
+
+  return 0 ;
+}
+
+int softToneQueued (int pin)
+{
+  int queued ;
+
+  if ((pin < 0) || (pin >= MAX_PINS))
+    return 0 ;
+
+  pthread_mutex_lock (&toneMutex) ;
+  queued = tonePins [pin].count + (tonePins [pin].noteEnd != 0 ? 1 : 0) ;
+  pthread_mutex_unlock (&toneMutex) ;
+
+  return queued ;
 }
 
 
 /*
  * softToneCreate:
- *	Create a new tone thread.
+ *	Start tone output on a pin, the first pin starts the thread.
  *********************************************************************************
  */
 
 int softToneCreate (int pin)
 {
-  int res ;
-  pthread_t myThread ;
+  pthread_condattr_t attr ;
+  struct softTonePin *p ;
+  int res = 0 ;
+
+  if ((pin < 0) || (pin >= MAX_PINS))
+    return -1 ;
 
+  if (tonePins [pin].running)
+    return -1 ;
+
+  // pinMode stops the tone on the pin, so not under the lock
   pinMode      (pin, OUTPUT) ;
   digitalWrite (pin, LOW) ;
 
-  if (threads [pin] != 0)
+  pthread_mutex_lock (&toneMutex) ;
+
+  while (toneExit)		// the last softToneStop is joining the old thread
+    pthread_cond_wait (&toneStopped, &toneMutex) ;
+
+  if (tonePins [pin].running)
+  {
+    pthread_mutex_unlock (&toneMutex) ;
     return -1 ;
+  }
 
-  freqs [pin] = 0 ;
+  if (!toneCondInit)
+  {
+    pthread_condattr_init     (&attr) ;
+    pthread_condattr_setclock (&attr, CLOCK_MONOTONIC) ;
+    pthread_cond_init         (&toneCond, &attr) ;
+    pthread_condattr_destroy  (&attr) ;
+    toneCondInit = TRUE ;
+  }
 
-  newPin = pin ;
-  res    = pthread_create (&myThread, NULL, softToneThread, NULL) ;
+  if (!toneThreadRunning)
+  {
+    res = pthread_create (&toneThread, NULL, softToneThread, NULL) ;
+    if (res != 0)
+    {
+      pthread_mutex_unlock (&toneMutex) ;
+      return res ;
+    }
+    toneThreadRunning = TRUE ;
+  }
 
-  while (newPin != -1)
-    delay (1) ;
+  p = &tonePins [pin] ;
+  p->freq    = 0 ;
+  p->inc     = 0 ;
+  p->phase   = 0 ;
+  p->level   = LOW ;
+  p->noteEnd = 0 ;
+  p->head    = 0 ;
+  p->count   = 0 ;
+  p->bank    = digitalPinToBank (pin) ;
+  p->mask    = digitalPinToBitMask (pin) ;
+  if (p->bank > 1)
+    p->bank = -1 ;
+  p->running  = TRUE ;
+  freqs [pin] = 0 ;
+  ++toneActive ;
 
-  threads [pin] = myThread ;
+  pthread_cond_signal  (&toneCond) ;
+  pthread_mutex_unlock (&toneMutex) ;
 
   return res ;
 }
@@ -134,17 +462,39 @@ int softToneCreate (int pin)
 
 /*
  * softToneStop:
- *	Stop an existing softTone thread
+ *	Stop tone output on a pin, the thread ends with the last pin
  *********************************************************************************
  */
 
 void softToneStop (int pin)
 {
-  if (threads [pin] != 0)
+  if ((pin < 0) || (pin >= MAX_PINS) || !tonePins [pin].running)	// pinMode calls this for every pin
+    return ;
+
+  pthread_mutex_lock (&toneMutex) ;
+  if (!tonePins [pin].running)
   {
-    pthread_cancel (threads [pin]) ;
-    pthread_join   (threads [pin], NULL) ;
-    threads [pin] = 0 ;
-    digitalWrite (pin, LOW) ;
+    pthread_mutex_unlock (&toneMutex) ;
+    return ;
   }
+  tonePins [pin].running = FALSE ;
+  digitalWrite (pin, LOW) ;
+
+  if (--toneActive > 0)
+  {
+    pthread_cond_signal  (&toneCond) ;
+    pthread_mutex_unlock (&toneMutex) ;
+    return ;
+  }
+
+  toneExit = TRUE ;
+  pthread_cond_signal  (&toneCond) ;
+  pthread_mutex_unlock (&toneMutex) ;
+  pthread_join (toneThread, NULL) ;
+
+  pthread_mutex_lock (&toneMutex) ;
+  toneThreadRunning = FALSE ;
+  toneExit          = FALSE ;
+  pthread_cond_broadcast (&toneStopped) ;
+  pthread_mutex_unlock   (&toneMutex) ;
 }
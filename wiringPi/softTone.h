@@ -33,6 +33,8 @@ extern "C" {
 extern int  softToneCreate (int pin) ;
 extern void softToneStop   (int pin) ;
 extern void softToneWrite  (int pin, int freq) ;
+extern int  softToneQueue  (int pin, int freq, unsigned int duration_ms) ; // Interface V3.15
+extern int  softToneQueued (int pin) ;                                     // Interface V3.15
 
 #ifdef __cplusplus
 }
@@ -36,32 +36,22 @@
 
 
 /*
- * myDigitalWrite:
+ * shiftOutput:
+ *	Clock the output register out to the chips
  *********************************************************************************
  */
 
-static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+static void shiftOutput (struct wiringPiNodeStruct *node)
 {
-  unsigned int mask ;
   int  dataPin, clockPin, latchPin ;
   int  bit, bits, output ;
 
-  pin     -= node->pinBase ;				// Normalise pin number
   bits     = node->pinMax - node->pinBase + 1 ;		// ie. number of clock pulses
   dataPin  = node->data0 ;
   clockPin = node->data1 ;
   latchPin = node->data2 ;
   output   = node->data3 ;
 
-  mask = 1 << pin ;
-
-  if (value == LOW)
-    output &= (~mask) ;
-  else
-    output |=   mask ;
-
-  node->data3 = output ;
-
 // A low -> high latch transition copies the latch to the output pins
 
   digitalWrite (latchPin, LOW) ; delayMicroseconds (1) ;
@@ -76,6 +66,66 @@ static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
 }
 
 
+/*
+ * myDigitalWrite:
+ *********************************************************************************
+ */
+
+static void myDigitalWrite (struct wiringPiNodeStruct *node, int pin, int value)
+{
+  unsigned int mask ;
+
+  pin -= node->pinBase ;				// Normalise pin number
+  mask = 1 << pin ;
+
+  if (value == LOW)
+    node->data3 &= (~mask) ;
+  else
+    node->data3 |=   mask ;
+
+  if (node->batch)
+    node->dirty = 1 ;
+  else
+    shiftOutput (node) ;
+}
+
+
+/*
+ * myDigitalWritePort:
+ *	Change any number of outputs with one pass through the chain
+ *********************************************************************************
+ */
+
+static void myDigitalWritePort (struct wiringPiNodeStruct *node, int pin, UNU int bits, unsigned int value, unsigned int mask)
+{
+  pin   -= node->pinBase ;
+  value  = (value & mask) << pin ;
+  mask <<= pin ;
+
+  node->data3 = (node->data3 & ~mask) | value ;
+
+  if (node->batch)
+    node->dirty = 1 ;
+  else
+    shiftOutput (node) ;
+}
+
+
+/*
+ * myFlush:
+ *	The writes of a batch (wiringPiNodeBegin) with one pass
+ *********************************************************************************
+ */
+
+static int myFlush (struct wiringPiNodeStruct *node)
+{
+  node->dirty = 0 ;
+  shiftOutput (node) ;
+
+  return 0 ;
+}
+
+
 /*
  * sr595Setup:
  *	Create a new instance of a 74x595 shift register GPIO expander.
@@ -89,11 +139,13 @@ int sr595Setup (const int pinBase, const int numPins,
 
   node = wiringPiNewNode (pinBase, numPins) ;
 
-  node->data0           = dataPin ;
-  node->data1           = clockPin ;
-  node->data2           = latchPin ;
-  node->data3           = 0 ;		// Output register
-  node->digitalWrite    = myDigitalWrite ;
+  node->data0            = dataPin ;
+  node->data1            = clockPin ;
+  node->data2            = latchPin ;
+  node->data3            = 0 ;		// Output register
+  node->digitalWrite     = myDigitalWrite ;
+  node->digitalWritePort = myDigitalWritePort ;
+  node->flush            = myFlush ;
 
 // Initialise the underlying hardware
 
@@ -0,0 +1,117 @@
+// WiringPi test program: simulation backend, runs without Raspberry Pi hardware
+// Compile: gcc -Wall wiringpi_test10_sim.c -o wiringpi_test10_sim -lwiringPi
+
+#include "wpi_test.h"
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+
+const int GPIO = 17;
+const int GPIOIN = 4;
+
+
+void TestModel(const char* name, unsigned int revision) {
+	struct WPISimWrite log[32];
+	int count;
+
+	printf("\n%s (revision %06X):\n", name, revision);
+	CheckSame("Simulation setup", wiringPiSimSetup(revision, NULL, 32), 0);
+	CheckSame("Simulation active", wiringPiSimActive(), 1);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+	CheckSame("RP1 model", piRP1Model(), (revision & 0xFF0) == 0x170 ? 1 : 0);
+
+	// output, level follows the latch
+	pinMode(GPIO, OUTPUT);
+	digitalWrite(GPIO, HIGH);
+	CheckSame("digitalWrite HIGH", digitalRead(GPIO), HIGH);
+	CheckSame("digitalReadBank HIGH", (digitalReadBank(0) >> GPIO) & 1, 1);
+	digitalWrite(GPIO, LOW);
+	CheckSame("digitalWrite LOW", digitalRead(GPIO), LOW);
+
+	// input, level driven from outside
+	pinMode(GPIOIN, INPUT);
+	wiringPiSimInput(GPIOIN, HIGH);
+	CheckSame("Input HIGH", digitalRead(GPIOIN), HIGH);
+	wiringPiSimInput(GPIOIN, LOW);
+	CheckSame("Input LOW", digitalRead(GPIOIN), LOW);
+	wiringPiSimInput(GPIO, HIGH);
+	CheckSame("Input on output ignored", digitalRead(GPIO), LOW);
+	wiringPiSimInput(GPIO, LOW);
+
+	// bank write, set wins over clear
+	pinMode(22, OUTPUT);
+	pinMode(27, OUTPUT);
+	digitalWriteMask(0, (1<<GPIO) | (1<<22), 1<<22 | 1<<27);
+	CheckSame("digitalWriteMask GPIO17", digitalRead(GPIO), HIGH);
+	CheckSame("digitalWriteMask GPIO22", digitalRead(22), HIGH);
+	CheckSame("digitalWriteMask GPIO27", digitalRead(27), LOW);
+	digitalWriteMask(0, 0, (1<<GPIO) | (1<<22));
+
+	// back to input, latch kept but not driven
+	digitalWrite(GPIO, HIGH);
+	pinMode(GPIO, INPUT);
+	CheckSame("Output latch not driven", digitalRead(GPIO), LOW);
+	pinMode(GPIO, OUTPUT);
+	CheckSame("Output latch driven again", digitalRead(GPIO), HIGH);
+	digitalWrite(GPIO, LOW);
+
+	// write log
+	count = wiringPiSimLog(log, 32);
+	CheckSame("Write log entries", count, 6);
+	if (count == 6) {
+		CheckSame("Log 0 changed", log[0].changed, 1<<GPIO);
+		CheckSame("Log 0 level", log[0].level, 1<<GPIO);
+		CheckSame("Log 2 changed", log[2].changed, (1<<GPIO) | (1<<22));
+		CheckSame("Log 3 level", log[3].level, 0);
+		int ordered = 1;
+		for (int i=1; i<count; i++) {
+			if (log[i].timeStamp_ns < log[i-1].timeStamp_ns) {
+				ordered = 0;
+			}
+		}
+		CheckSame("Log timestamps ascending", ordered, 1);
+	}
+	CheckSame("Write log empty", wiringPiSimLog(log, 32), 0);
+
+	if (!piRP1Model()) {
+		pinMode(18, PWM_OUTPUT);
+		pwmWrite(18, 512);
+		CheckSame("PWM0 data register", _wiringPiPwm[5], 512);
+	}
+}
+
+
+void RunModel(const char* name, unsigned int revision) {
+	int status = EXIT_FAILURE;
+
+	// wiringPi can only be set up once per process
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid<0) {
+		globalError = 1;
+		return;
+	} else if (pid==0) {
+		TestModel(name, revision);
+		fflush(stdout);
+		exit(globalError ? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status)!=EXIT_SUCCESS) {
+		globalError = 1;
+	}
+}
+
+
+int main (void) {
+	int major, minor;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi simulation test program (WiringPi %d.%d)\n", major, minor);
+
+	RunModel("Pi 3B", 0xA02082);
+	RunModel("Pi 4B", 0xC03111);
+	RunModel("Pi 5",  0xD04170);
+
+	return UnitTestState();
+}
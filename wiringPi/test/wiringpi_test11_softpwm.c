@@ -0,0 +1,113 @@
+// WiringPi test program: soft PWM scheduler, runs on the simulated registers
+// Compile: gcc -Wall wiringpi_test11_softpwm.c -o wiringpi_test11_softpwm -lwiringPi
+
+#include "wpi_test.h"
+#include <softPwm.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_DEPTH 8192
+
+const int GPIO1 = 17;
+const int GPIO2 = 22;
+const int GPIO3 = 27;
+const int GPIO4 = 23;
+
+struct WPISimWrite simLog[LOG_DEPTH];
+
+
+// Share of time high between the first and the last log entry, in percent
+double DutyCycle(int count, int gpio) {
+	long long high = 0, start = -1, total;
+	int level = 0;
+
+	for (int i = 0; i < count; i++) {
+		int newLevel = (simLog[i].level >> gpio) & 1;
+		if (!(simLog[i].changed & (1u << gpio))) {
+			continue;
+		}
+		if (start < 0) {
+			start = simLog[i].timeStamp_ns;  // first edge
+		} else if (level && !newLevel) {
+			high += simLog[i].timeStamp_ns - start;
+		}
+		if (newLevel) {
+			start = simLog[i].timeStamp_ns;
+		}
+		level = newLevel;
+	}
+	total = simLog[count-1].timeStamp_ns - simLog[0].timeStamp_ns;
+	return total > 0 ? high*100.0/total : 0.0;
+}
+
+
+int main (void) {
+	struct softPwmStats stats;
+	int major, minor;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi soft PWM test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+
+	CheckSame("softPwmCreateFreq GPIO1", softPwmCreateFreq(GPIO1, 25, 100, 500), 0);
+	CheckSame("softPwmCreateFreq GPIO2", softPwmCreateFreq(GPIO2, 25, 100, 500), 0);
+	CheckSame("softPwmCreateFreq GPIO3", softPwmCreateFreq(GPIO3, 50, 100, 500), 0);
+	CheckSame("softPwmCreate GPIO4",     softPwmCreate(GPIO4, 3, 10), 0);
+	CheckSame("softPwmCreate twice", softPwmCreate(GPIO4, 3, 10), -1);
+	CheckSame("softPwmCreateFreq 0 Hz", softPwmCreateFreq(24, 3, 10, 0), -1);
+	softPwmGetStats(&stats, 1);
+
+	wiringPiSimLog(simLog, LOG_DEPTH);  // drop the setup writes
+	delay(200);
+	softPwmGetStats(&stats, 0);
+	int count = wiringPiSimLog(simLog, LOG_DEPTH);
+
+	printf("\n%llu wake ups, %llu edges in %llu writes, latency avg %lld us max %lld us, %u overruns\n",
+	  stats.wakeups, stats.edges, stats.writes, stats.latencyAvg_ns/1000, stats.latencyMax_ns/1000, stats.overruns);
+	CheckNotSame("Write log entries", count, 0);
+	CheckSame("Less writes than edges", stats.writes < stats.edges, 1);
+
+	if (count > 1) {
+		int together = 0, rising = 0;
+		for (int i = 0; i < count; i++) {
+			if ((simLog[i].changed & simLog[i].level & (1u << GPIO1))) {
+				rising++;
+				if (simLog[i].changed & simLog[i].level & (1u << GPIO2)) {
+					together++;
+				}
+			}
+		}
+		printf("%d rising edges on GPIO %d, %d in the same write as GPIO %d\n", rising, GPIO1, together, GPIO2);
+		CheckNotSame("Rising edges", rising, 0);
+		CheckSame("Same period, one bank write", together == rising, 1);
+
+		CheckSameFloat("Duty cycle GPIO1 %", DutyCycle(count, GPIO1), 25.0, 10.0);
+		CheckSameFloat("Duty cycle GPIO3 %", DutyCycle(count, GPIO3), 50.0, 10.0);
+		CheckSameFloat("Duty cycle GPIO4 %", DutyCycle(count, GPIO4), 30.0, 10.0);
+	}
+
+	softPwmWrite(GPIO3, 100);
+	delay(20);
+	CheckSame("100% stays HIGH", digitalRead(GPIO3), HIGH);
+	softPwmWrite(GPIO3, 0);
+	delay(20);
+	CheckSame("0% stays LOW", digitalRead(GPIO3), LOW);
+
+	softPwmStop(GPIO1);
+	softPwmStop(GPIO2);
+	softPwmStop(GPIO3);
+	softPwmStop(GPIO4);
+	CheckSame("Stopped LOW", digitalReadBank(0) & ((1<<GPIO1) | (1<<GPIO2) | (1<<GPIO3) | (1<<GPIO4)), 0);
+
+	// restart after the thread has ended
+	softPwmGetStats(&stats, 1);
+	CheckSame("softPwmCreate again", softPwmCreate(GPIO1, 5, 10), 0);
+	delay(20);
+	softPwmGetStats(&stats, 0);
+	CheckNotSame("Running again", (int)stats.wakeups, 0);
+	softPwmStop(GPIO1);
+
+	return UnitTestState();
+}
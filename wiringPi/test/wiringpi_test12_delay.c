@@ -0,0 +1,88 @@
+// WiringPi test program: delayMicroseconds accuracy report (requested vs. actual)
+// Compile: gcc -Wall wiringpi_test12_delay.c -o wiringpi_test12_delay -lwiringPi
+
+#include "wpi_test.h"
+#include <string.h>
+#include <time.h>
+
+#define LOOPS 200
+
+const unsigned int requested[] = { 1, 5, 10, 20, 50, 100, 200, 500, 1000, 5000 };
+// upper bound of the histogram bins, error in us
+const long long bins[] = { 1, 2, 5, 10, 20, 50, 100 };
+#define BINS (sizeof(bins)/sizeof(bins[0]))
+
+
+long long NowNs(clockid_t clock) {
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+
+int CompareLL(const void* a, const void* b) {
+	long long la = *(const long long*)a, lb = *(const long long*)b;
+	return (la > lb) - (la < lb);
+}
+
+
+int main (void) {
+	long long error[LOOPS];
+	int major, minor, early = 0;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi delayMicroseconds accuracy (WiringPi %d.%d)\n", major, minor);
+	unsigned int spin = delayMicrosecondsCalibrate();
+	printf("Calibrated wake up latency (spin tail): %.1f us\n\n", spin/1000.0);
+
+	printf("request  median     p99     max    CPU  | error histogram [us]:");
+	for (unsigned int b = 0; b < BINS; b++) {
+		printf(" <%-4lld", bins[b]);
+	}
+	printf(" >=%lld\n", bins[BINS-1]);
+
+	for (unsigned int r = 0; r < sizeof(requested)/sizeof(requested[0]); r++) {
+		int loops = requested[r] >= 1000 ? LOOPS/4 : LOOPS;
+		int hist[BINS+1];
+		long long cpu = NowNs(CLOCK_PROCESS_CPUTIME_ID);
+		long long wall = NowNs(CLOCK_MONOTONIC);
+
+		memset(hist, 0, sizeof(hist));
+		for (int i = 0; i < loops; i++) {
+			long long t1 = NowNs(CLOCK_MONOTONIC);
+			delayMicroseconds(requested[r]);
+			long long t2 = NowNs(CLOCK_MONOTONIC);
+			error[i] = (t2 - t1) - requested[r]*1000LL;
+			if (error[i] < 0) {
+				early++;
+			}
+			unsigned int b = 0;
+			while (b < BINS && error[i] >= bins[b]*1000) {
+				b++;
+			}
+			hist[b]++;
+		}
+		cpu  = NowNs(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+		wall = NowNs(CLOCK_MONOTONIC) - wall;
+		qsort(error, loops, sizeof(error[0]), CompareLL);
+
+		printf("%5u us %6.1f  %6.1f  %6.1f   %3d%%  |                      ", requested[r],
+		  error[loops/2]/1000.0, error[(loops*99)/100]/1000.0, error[loops-1]/1000.0, (int)(cpu*100/wall));
+		for (unsigned int b = 0; b <= BINS; b++) {
+			printf(" %-5d", hist[b]);
+		}
+		printf("\n");
+	}
+	printf("\n");
+
+	CheckSame("No delay ends early", early, 0);
+
+	// long delays sleep, the calibrated tail is spun
+	long long cpu = NowNs(CLOCK_PROCESS_CPUTIME_ID);
+	delayMicroseconds(100000);
+	cpu = NowNs(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+	CheckSame("100 ms delay does not spin", cpu < 50000000LL, 1);
+
+	return UnitTestState();
+}
@@ -0,0 +1,98 @@
+// WiringPi test program: fast time source, drift against CLOCK_MONOTONIC_RAW and cost per read
+// Compile: gcc -Wall wiringpi_test13_time.c -o wiringpi_test13_time -lwiringPi
+
+#include "wpi_test.h"
+#include <string.h>
+#include <time.h>
+
+#define READS 1000000
+
+
+long long RawNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+
+double ReadCost(const char* name, int op) {
+	volatile unsigned long long sink = 0;
+	long long t1 = RawNs();
+
+	for (int i = 0; i < READS; i++) {
+		switch(op) {
+			case 0: sink += micros(); break;
+			case 1: sink += millis(); break;
+			case 2: sink += piMicros64(); break;
+			case 3: sink += piTicks(); break;
+			case 4: sink += RawNs(); break;
+		}
+	}
+	double ns = (double)(RawNs() - t1) / READS;
+	printf("  %-28s %6.1f ns\n", name, ns);
+	return ns;
+}
+
+
+int main (void) {
+	int major, minor;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi time source test program (WiringPi %d.%d)\n", major, minor);
+
+	// the time source does not depend on the hardware, run on simulated registers
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, 0), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+
+	unsigned long long freq = piTicksFrequency();
+	if (freq != 1000000000ULL) {
+		printf("Fast time source: counter %.3f MHz\n", freq/1000000.0);
+	} else {
+		printf("Kernel time source (CLOCK_MONOTONIC_RAW)\n");
+	}
+
+	printf("\nCost per read:\n");
+	ReadCost("micros", 0);
+	ReadCost("millis", 1);
+	double fast = ReadCost("piMicros64", 2);
+	ReadCost("piTicks", 3);
+	double kernel = ReadCost("clock_gettime RAW", 4);
+	printf("  piMicros64 / clock_gettime    %6.2f\n\n", fast/kernel);
+
+	// consistent with each other
+	unsigned long long us64 = piMicros64();
+	unsigned int us = micros();
+	CheckSame("micros matches piMicros64", (us - (unsigned int)us64) < 100, 1);
+	CheckSame("millis matches piMicros64", (millis() - (unsigned int)(us64/1000)) < 2, 1);
+
+	// never backwards
+	int backwards = 0;
+	unsigned long long last = piMicros64();
+	for (int i = 0; i < READS; i++) {
+		unsigned long long now = piMicros64();
+		if (now < last) {
+			backwards++;
+		}
+		last = now;
+	}
+	CheckSame("piMicros64 monotonic", backwards, 0);
+
+	// drift against the kernel clock
+	long long raw1 = RawNs();
+	unsigned long long ticks1 = piTicks();
+	unsigned long long us1 = piMicros64();
+	delay(2000);
+	long long raw2 = RawNs();
+	unsigned long long ticks2 = piTicks();
+	unsigned long long us2 = piMicros64();
+
+	double rawNs = (double)(raw2 - raw1);
+	double ppmTicks  = (piTicksToNs(ticks2 - ticks1) - rawNs) * 1e6 / rawNs;
+	double ppmMicros = ((us2 - us1)*1000.0 - rawNs) * 1e6 / rawNs;
+	printf("Drift over %.3f s: piTicks %+.2f ppm, piMicros64 %+.2f ppm\n", rawNs/1e9, ppmTicks, ppmMicros);
+	CheckSameFloat("piTicksToNs drift ppm", ppmTicks, 0.0, 50.0);
+	CheckSameFloat("piMicros64 drift ppm", ppmMicros, 0.0, 50.0);
+
+	return UnitTestState();
+}
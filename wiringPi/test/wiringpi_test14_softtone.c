@@ -0,0 +1,152 @@
+// WiringPi test program: soft tone engine, runs on the simulated registers
+// Compile: gcc -Wall wiringpi_test14_softtone.c -o wiringpi_test14_softtone -lwiringPi
+
+#include "wpi_test.h"
+#include <softTone.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_DEPTH 8192
+
+const int GPIO1 = 17;
+const int GPIO2 = 22;
+const int GPIO3 = 27;
+
+struct WPISimWrite simLog[LOG_DEPTH];
+
+
+int CompareLL(const void* a, const void* b) {
+	long long x = *(const long long*)a, y = *(const long long*)b;
+	return (x > y) - (x < y);
+}
+
+
+// Toggles of a pin in the log, first and last time stamp
+int Toggles(int count, int gpio, long long* first, long long* last) {
+	int toggles = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & (1u << gpio)) {
+			if (toggles == 0) {
+				*first = simLog[i].timeStamp_ns;
+			}
+			*last = simLog[i].timeStamp_ns;
+			toggles++;
+		}
+	}
+	return toggles;
+}
+
+
+// Median interval between the toggles of a pin
+long long MedianInterval(int count, int gpio) {
+	static long long intervals[LOG_DEPTH];
+	long long prev = 0;
+	int n = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & (1u << gpio)) {
+			if (prev != 0) {
+				intervals[n++] = simLog[i].timeStamp_ns - prev;
+			}
+			prev = simLog[i].timeStamp_ns;
+		}
+	}
+	if (n == 0) {
+		return 0;
+	}
+	qsort(intervals, n, sizeof(intervals[0]), CompareLL);
+	return intervals[n/2];
+}
+
+
+int main (void) {
+	long long first = 0, last = 0;
+	int major, minor, count;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi soft tone test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+
+	CheckSame("softToneCreate GPIO1", softToneCreate(GPIO1), 0);
+	CheckSame("softToneCreate GPIO2", softToneCreate(GPIO2), 0);
+	CheckSame("softToneCreate GPIO3", softToneCreate(GPIO3), 0);
+	CheckSame("softToneCreate twice", softToneCreate(GPIO3), -1);
+	CheckSame("softToneQueue not running", softToneQueue(24, 440, 10), -1);
+
+	// two tones started together toggle in the same bank write
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	softToneWrite(GPIO1, 1000);
+	softToneWrite(GPIO2, 1000);
+	delay(300);
+	softToneWrite(GPIO1, 0);
+	softToneWrite(GPIO2, 0);
+	delay(10);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+
+	int toggles = Toggles(count, GPIO1, &first, &last);
+	int together = 0;
+	for (int i = 0; i < count; i++) {
+		if ((simLog[i].changed & (1u << GPIO1)) && (simLog[i].changed & (1u << GPIO2))) {
+			together++;
+		}
+	}
+	printf("\n%d toggles on GPIO %d, %d together with GPIO %d\n", toggles, GPIO1, together, GPIO2);
+	CheckSame("Same frequency, one bank write", together >= toggles - 1, 1);
+	if (toggles > 2) {
+		double freq = (toggles - 1) / 2.0 / ((last - first) / 1e9);
+		CheckSameFloat("Median half period 500 us", MedianInterval(count, GPIO1) / 1e3, 500.0, 20.0);
+		CheckSameFloat("Frequency 1000 Hz", freq, 1000.0, 20.0);
+	}
+	CheckSame("Silent LOW", digitalRead(GPIO1), LOW);
+
+	// queued melody, no caller thread sleeping between the notes
+	CheckSame("Queue note 1", softToneQueue(GPIO3, 500, 100), 0);
+	CheckSame("Queue rest",   softToneQueue(GPIO3, 0, 50), 0);
+	CheckSame("Queue note 2", softToneQueue(GPIO3, 1000, 100), 0);
+	CheckSame("Queued notes", softToneQueued(GPIO3), 3);
+	while (softToneQueued(GPIO3) > 0) {
+		delay(5);
+	}
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+
+	long long start = 0, gapStart = 0, gapEnd = 0;
+	int notes[2] = { 0, 0 }, note = 0;
+	for (int i = 0; i < count; i++) {
+		if (!(simLog[i].changed & (1u << GPIO3))) {
+			continue;
+		}
+		if (start == 0) {
+			start = simLog[i].timeStamp_ns;
+		} else if (note == 0 && simLog[i].timeStamp_ns - gapStart > 20000000LL && gapStart) {
+			gapEnd = simLog[i].timeStamp_ns;
+			note = 1;
+		}
+		if (note == 0) {
+			gapStart = simLog[i].timeStamp_ns;
+		}
+		notes[note]++;
+	}
+	printf("Melody: %d toggles, rest %.1f ms, %d toggles, second note at %.1f ms\n",
+	  notes[0], (gapEnd - gapStart)/1e6, notes[1], (gapEnd - start)/1e6);
+	CheckSameFloat("Note 1 toggles (500 Hz, 100 ms)", notes[0], 100.0, 10.0);
+	CheckSameFloat("Note 2 toggles (1000 Hz, 100 ms)", notes[1], 200.0, 20.0);
+	CheckSameFloat("Note 2 starts after 150 ms", (gapEnd - start)/1e6, 150.0, 2.0);
+	CheckSame("Melody ends LOW", digitalRead(GPIO3), LOW);
+
+	softToneStop(GPIO1);
+	softToneStop(GPIO2);
+	softToneStop(GPIO3);
+
+	// restart after the thread has ended
+	CheckSame("softToneCreate again", softToneCreate(GPIO1), 0);
+	softToneWrite(GPIO1, 2000);
+	delay(20);
+	softToneStop(GPIO1);
+	CheckSame("Stopped LOW", digitalRead(GPIO1), LOW);
+
+	return UnitTestState();
+}
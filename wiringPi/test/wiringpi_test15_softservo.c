@@ -0,0 +1,111 @@
+// WiringPi test program: soft servo pulse generator, runs on the simulated registers
+// Compile: gcc -Wall wiringpi_test15_softservo.c -o wiringpi_test15_softservo -lwiringPi
+
+#include "wpi_test.h"
+#include <softServo.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_DEPTH 4096
+
+const int pins[] = { 17, 22, 27, 23, 24 };
+const int values[] = { 0, 500, 500, 1000, 250 };   // 1000, 1500, 1500, 2000, 1250 us
+#define SERVOS (int)(sizeof(pins)/sizeof(pins[0]))
+
+struct WPISimWrite simLog[LOG_DEPTH];
+double widths[SERVOS][64];
+
+
+int CompareDouble(const void* a, const void* b) {
+	double da = *(const double*)a, db = *(const double*)b;
+	return (da > db) - (da < db);
+}
+
+
+int main (void) {
+	struct softServoStats stats;
+	unsigned int all = 0;
+	int major, minor;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi soft servo test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+
+	CheckSame("softServoSetupPins", softServoSetupPins(pins, SERVOS), 0);
+	for (int s = 0; s < SERVOS; s++) {
+		softServoWrite(pins[s], values[s]);
+		all |= 1u << pins[s];
+	}
+	delay(20);
+	softServoGetStats(&stats, 1);
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	delay(200);
+	softServoGetStats(&stats, 0);
+	int count = wiringPiSimLog(simLog, LOG_DEPTH);
+
+	printf("\n%llu frames, %llu pulse ends, %llu wake ups, frame late max %lld us, pulse late avg %lld max %lld us\n",
+	  stats.frames, stats.frames ? stats.pulses/stats.frames : 0, stats.wakeups,
+	  stats.frameLateMax_ns/1000, stats.pulseLateAvg_ns/1000, stats.pulseLateMax_ns/1000);
+	CheckSameFloat("Frames in 200 ms", stats.frames, 25.0, 2.0);
+	CheckSame("4 pulse ends per frame (2 same width)", stats.pulses == stats.frames*4, 1);
+
+	// every frame: one write sets all, then the pulses end in width order
+	int frames = 0, together = 1, ordered = 1;
+	int widthCount[SERVOS];
+	memset(widthCount, 0, sizeof(widthCount));
+	long long frameStart = 0, lastStart = 0, periodSum = 0;
+	for (int i = 0; i < count; i++) {
+		unsigned int rising = simLog[i].changed & simLog[i].level;
+		unsigned int falling = simLog[i].changed & ~simLog[i].level;
+		if (rising) {
+			if (rising != all) {
+				together = 0;
+			}
+			if (lastStart) {
+				periodSum += simLog[i].timeStamp_ns - lastStart;
+			}
+			lastStart = frameStart = simLog[i].timeStamp_ns;
+			frames++;
+		}
+		if (falling && frameStart) {
+			for (int s = 0; s < SERVOS; s++) {
+				if ((falling & (1u << pins[s])) && widthCount[s] < 64) {
+					widths[s][widthCount[s]++] = (simLog[i].timeStamp_ns - frameStart) / 1000.0;
+				}
+			}
+			if (i + 1 < count && !(simLog[i+1].changed & simLog[i+1].level) &&
+			    simLog[i+1].timeStamp_ns < simLog[i].timeStamp_ns) {
+				ordered = 0;
+			}
+		}
+	}
+	CheckSame("All pulses start in one write", together, 1);
+	CheckSame("Pulse ends in order", ordered, 1);
+	if (frames > 1) {
+		CheckSameFloat("Frame period ms", periodSum / (frames - 1) / 1e6, 8.0, 0.2);
+	}
+	for (int s = 0; s < SERVOS; s++) {
+		char msg[64];
+		snprintf(msg, sizeof(msg), "Pulse width GPIO %d us (median)", pins[s]);
+		if (widthCount[s]) {
+			qsort(widths[s], widthCount[s], sizeof(double), CompareDouble);
+			CheckSameFloat(msg, widths[s][widthCount[s]/2], 1000.0 + values[s], 20.0);
+		} else {
+			CheckSame(msg, widthCount[s], 1);
+		}
+	}
+
+	// more servos later, at most 64
+	const int more[] = { 5, 6 };
+	CheckSame("softServoSetupPins add", softServoSetupPins(more, 2), 0);
+	CheckSame("softServoSetupPins add again", softServoSetupPins(more, 2), 0);
+	softServoWrite(5, 100);   // 1100 us, GPIO 6 stays at 1500 us like 22 and 27
+	softServoGetStats(&stats, 1);
+	delay(50);
+	softServoGetStats(&stats, 0);
+	CheckSame("5 pulse ends per frame", stats.pulses == stats.frames*5, 1);
+
+	return UnitTestState();
+}
@@ -0,0 +1,151 @@
+// WiringPi test program: shift register buffer functions, runs on the simulated registers
+// Compile: gcc -Wall wiringpi_test16_shift.c -o wiringpi_test16_shift -lwiringPi
+
+#include "wpi_test.h"
+#include <wiringShift.h>
+#include <string.h>
+
+#define LOG_DEPTH 4096
+#define NODE_BASE 100
+
+const int DATA  = 17;
+const int CLOCK = 27;
+const int DATA2 = 22;
+const int IN1   = 23;
+const int IN2   = 24;
+
+struct WPISimWrite simLog[LOG_DEPTH];
+int nodeWrites = 0, nodeClock = 0, nodeData = 0, nodeBits = 0;
+uint8_t nodeShift[8];
+
+
+// What a 74HC595 chain sees: data sampled on the rising clock edges, MSB first
+int Decode(int count, int gpio, uint8_t* out, int maxBytes) {
+	int bits = 0;
+
+	memset(out, 0, maxBytes);
+	for (int i = 0; i < count; i++) {
+		if ((simLog[i].changed & simLog[i].level & (1u << CLOCK)) && bits < maxBytes*8) {
+			if (simLog[i].level & (1u << gpio)) {
+				out[bits/8] |= 0x80 >> (bits%8);
+			}
+			bits++;
+		}
+	}
+	return bits;
+}
+
+
+// Node pins are not in a GPIO bank and go the digitalWrite way
+void NodeWrite(struct wiringPiNodeStruct* node, int pin, int value) {
+	(void)node;
+	nodeWrites++;
+	if (pin == NODE_BASE + 1) {
+		if (value && !nodeClock && nodeBits < 64) {
+			if (nodeData) {
+				nodeShift[nodeBits/8] |= 0x80 >> (nodeBits%8);
+			}
+			nodeBits++;
+		}
+		nodeClock = value;
+	} else {
+		nodeData = value;
+	}
+}
+
+
+int main (void) {
+	const uint8_t chain[] = { 0xA5, 0x3C, 0x01, 0xFF };
+	const uint8_t lines[] = { 0xA5, 0x3C,   0x5A, 0xC3 };  // 2 lines of 2 bytes
+	uint8_t got[8];
+	int major, minor, count, bits;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi shift register test program (WiringPi %d.%d)\n", major, minor);
+
+	shiftSetClockPeriod(40000);
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+	pinMode(DATA, OUTPUT);
+	pinMode(DATA2, OUTPUT);
+	pinMode(CLOCK, OUTPUT);
+
+	// minimum clock period, set before the setup changes the time source
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	shiftOutBuffer(DATA, CLOCK, MSBFIRST, chain, 2);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	shiftSetClockPeriod(0);
+	long long last = 0, sum = 0;
+	int periods = 0;
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & simLog[i].level & (1u << CLOCK)) {
+			if (last) {
+				sum += simLog[i].timeStamp_ns - last;
+				periods++;
+			}
+			last = simLog[i].timeStamp_ns;
+		}
+	}
+	bits = Decode(count, DATA, got, 2);
+	CheckSame("Slow clock data", memcmp(got, chain, 2), 0);
+	if (periods) {
+		printf("Clock period %.1f us\n", sum / periods / 1000.0);
+		CheckSame("Clock period >= 40 us", sum / periods >= 39000, 1);
+		CheckSame("Clock period < 80 us", sum / periods < 80000, 1);
+	}
+
+	pinMode(IN1, INPUT);
+	pinMode(IN2, INPUT);
+
+	// 74HC595 chain, 2 bank writes per bit
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	shiftOutBuffer(DATA, CLOCK, MSBFIRST, chain, sizeof(chain));
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	bits = Decode(count, DATA, got, sizeof(chain));
+	printf("\nshiftOutBuffer: %d bits in %d writes\n", bits, count);
+	CheckSame("shiftOutBuffer bits", bits, (int)sizeof(chain)*8);
+	CheckSame("shiftOutBuffer data", memcmp(got, chain, sizeof(chain)), 0);
+	CheckSame("At most 2 writes per bit", count <= bits*2 + 1, 1);
+	CheckSame("Clock ends LOW", digitalRead(CLOCK), LOW);
+
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	shiftOut(DATA, CLOCK, LSBFIRST, 0x81 >> 1);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	Decode(count, DATA, got, 1);
+	CheckSame("shiftOut LSBFIRST", got[0], 0x02);
+
+	// two lines on one clock
+	const int dPins[] = { DATA, DATA2 };
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	shiftOutParallel(dPins, 2, CLOCK, MSBFIRST, lines, 2);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	bits = Decode(count, DATA, got, 2);
+	Decode(count, DATA2, got + 2, 2);
+	printf("shiftOutParallel: 2x%d bits in %d writes\n", bits, count);
+	CheckSame("shiftOutParallel bits", bits, 16);
+	CheckSame("shiftOutParallel data", memcmp(got, lines, 4), 0);
+	CheckSame("At most 2 writes per clock", count <= bits*2 + 1, 1);
+
+	// 74HC165 reads, one bank read per clock
+	const int inPins[] = { IN1, IN2 };
+	wiringPiSimInput(IN1, 1);
+	wiringPiSimInput(IN2, 0);
+	shiftInParallel(inPins, 2, CLOCK, MSBFIRST, got, 2);
+	CheckSame("shiftInParallel line 1", got[0] == 0xFF && got[1] == 0xFF, 1);
+	CheckSame("shiftInParallel line 2", got[2] == 0x00 && got[3] == 0x00, 1);
+	shiftInBuffer(IN2, CLOCK, LSBFIRST, got, 1);
+	CheckSame("shiftInBuffer", got[0], 0x00);
+	CheckSame("shiftIn", shiftIn(IN1, CLOCK, MSBFIRST), 0xFF);
+
+	// pins without a bank: digitalWrite per edge
+	struct wiringPiNodeStruct* node = wiringPiNewNode(NODE_BASE, 2);
+	node->digitalWrite = NodeWrite;
+	memset(nodeShift, 0, sizeof(nodeShift));
+	shiftOutBuffer(NODE_BASE, NODE_BASE + 1, MSBFIRST, chain, sizeof(chain));
+	printf("Node pins: %d bits in %d writes\n", nodeBits, nodeWrites);
+	CheckSame("Node pins bits", nodeBits, (int)sizeof(chain)*8);
+	CheckSame("Node pins data", memcmp(nodeShift, chain, sizeof(chain)), 0);
+	CheckSame("Node clock ends LOW", nodeClock, LOW);
+
+	return UnitTestState();
+}
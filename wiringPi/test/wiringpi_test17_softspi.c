@@ -0,0 +1,206 @@
+// WiringPi test program: software SPI buses, runs on the simulated registers
+// Compile: gcc -Wall wiringpi_test17_softspi.c -o wiringpi_test17_softspi -lwiringPi
+
+#include "wpi_test.h"
+#include <wiringPiSPI.h>
+#include <softSpi.h>
+#include <mcp3004.h>
+#include <mcp23s17.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LOG_DEPTH 4096
+
+const int SCLK = 11;
+const int MOSI = 10;
+const int MISO = 9;
+const int CS0  = 8;
+const int CS1  = 7;
+const int BUS  = SOFT_SPI_FIRST;
+
+struct WPISimWrite simLog[LOG_DEPTH];
+
+
+// Chip select activations in the log
+int Selects(int count, int cs) {
+	int selects = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & ~simLog[i].level & (1u << cs)) {
+			selects++;
+		}
+	}
+	return selects;
+}
+
+
+// What a slave on chip select cs sees: MOSI at the sampling edges of the mode
+int Decode(int count, int cs, int mode, uint8_t* out, int maxBytes) {
+	int bits = 0, selected = 0;
+	int idle = (mode & 2) ? 1 : 0;
+
+	memset(out, 0, maxBytes);
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & (1u << cs)) {
+			selected = !(simLog[i].level & (1u << cs));
+		}
+		if (!selected || !(simLog[i].changed & (1u << SCLK))) {
+			continue;
+		}
+		int clock = (simLog[i].level >> SCLK) & 1;
+		int leading = (clock != idle);
+		if (leading == !(mode & 1) && bits < maxBytes*8) {
+			if (simLog[i].level & (1u << MOSI)) {
+				out[bits/8] |= 0x80 >> (bits%8);
+			}
+			bits++;
+		}
+	}
+	return bits;
+}
+
+
+int main (void) {
+	const int csPins[] = { CS0, CS1 };
+	uint8_t tx[4] = { 0xA5, 0x3C, 0x81, 0x7E };
+	unsigned char rx[4];
+	uint8_t got[8];
+	char msg[64];
+	int major, minor, count, bits;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi software SPI test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+
+	CheckSame("softSpiSetup", softSpiSetup(BUS, SCLK, MOSI, MISO, csPins, 2), 0);
+	CheckSame("softSpiSetup spidev number", softSpiSetup(0, SCLK, MOSI, MISO, csPins, 2) < 0, 1);
+	CheckSame("Not set up bus", wiringPiSPIxDataRW(BUS + 1, 0, rx, 1) < 0, 1);
+	CheckSame("Invalid channel", wiringPiSPIxDataRW(BUS, 2, rx, 1) < 0, 1);
+	CheckSame("Chip selects HIGH", digitalRead(CS0) == HIGH && digitalRead(CS1) == HIGH, 1);
+
+	// all four modes, MISO tied high
+	wiringPiSimInput(MISO, 1);
+	for (int mode = 0; mode < 4; mode++) {
+		CheckSame("wiringPiSPIxSetupMode", wiringPiSPIxSetupMode(BUS, 0, 0, mode), 0);
+		wiringPiSimLog(simLog, LOG_DEPTH);
+		CheckSame("wiringPiSPIxTransfer", wiringPiSPIxTransfer(BUS, 0, tx, rx, sizeof(tx), 8), (int)sizeof(tx));
+		count = wiringPiSimLog(simLog, LOG_DEPTH);
+		bits = Decode(count, CS0, mode, got, sizeof(tx));
+		snprintf(msg, sizeof(msg), "Mode %d MOSI", mode);
+		CheckSame(msg, bits == 32 && memcmp(got, tx, sizeof(tx)) == 0, 1);
+		snprintf(msg, sizeof(msg), "Mode %d %d writes for 32 bits", mode, count);
+		CheckSame(msg, count <= 2*32 + 4, 1);
+		snprintf(msg, sizeof(msg), "Mode %d MISO", mode);
+		CheckSame(msg, rx[0] == 0xFF && rx[3] == 0xFF, 1);
+		snprintf(msg, sizeof(msg), "Mode %d clock idle", mode);
+		CheckSame(msg, digitalRead(SCLK), (mode & 2) ? HIGH : LOW);
+	}
+	CheckSame("Chip select released", digitalRead(CS0), HIGH);
+	wiringPiSPIxSetupMode(BUS, 0, 0, 0);
+
+	// 16 bit words, MSB first from native order, MISO low
+	wiringPiSimInput(MISO, 0);
+	uint16_t words[2] = { 0xA55A, 0x0102 }, wordsIn[2] = { 1, 1 };
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	wiringPiSPIxTransfer(BUS, 0, words, wordsIn, sizeof(words), 16);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	Decode(count, CS0, 0, got, 4);
+	CheckSame("16 bit words", got[0] == 0xA5 && got[1] == 0x5A && got[2] == 0x01 && got[3] == 0x02, 1);
+	CheckSame("16 bit words in", wordsIn[0] == 0 && wordsIn[1] == 0, 1);
+	CheckSame("Odd length for 32 bit words", wiringPiSPIxTransfer(BUS, 0, tx, rx, 3, 32) < 0, 1);
+
+	// MISO on the MOSI pin: the data read is the data sent, in every mode
+	CheckSame("softSpiSetup loopback", softSpiSetup(BUS + 1, SCLK, MOSI, MOSI, NULL, 1), 0);
+	for (int mode = 0; mode < 4; mode++) {
+		uint32_t out = 0xDEADBEEF, in = 0;
+		wiringPiSPIxSetupMode(BUS + 1, 0, 0, mode);
+		wiringPiSPIxTransfer(BUS + 1, 0, &out, &in, 4, 32);
+		snprintf(msg, sizeof(msg), "Mode %d loopback 32 bit", mode);
+		CheckSame(msg, in == out, 1);
+	}
+	memcpy(rx, tx, sizeof(tx));
+	wiringPiSPIDataRW(wiringPiSPIChannel(BUS + 1, 0), rx, sizeof(rx));
+	CheckSame("wiringPiSPIDataRW loopback", memcmp(rx, tx, sizeof(tx)), 0);
+
+	// clock rate
+	CheckSame("100 kHz", wiringPiSPIxSetupMode(BUS, 1, 100000, 0), 0);
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	wiringPiSPIxTransfer(BUS, 1, tx, NULL, 2, 8);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	long long first = 0, last = 0;
+	int rising = 0;
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & simLog[i].level & (1u << SCLK)) {
+			if (!first) {
+				first = simLog[i].timeStamp_ns;
+			}
+			last = simLog[i].timeStamp_ns;
+			rising++;
+		}
+	}
+	if (rising > 1) {
+		double period = (last - first) / (rising - 1) / 1000.0;
+		printf("Clock period at 100 kHz: %.1f us\n", period);
+		CheckSame("Clock period >= 10 us", period >= 9.9, 1);
+	}
+
+	// an SPI node on the software bus, driver unchanged
+	wiringPiSimInput(MISO, 1);
+	CheckSame("mcp3004Setup on bus 7", mcp3004Setup(200, wiringPiSPIChannel(BUS, 1)), TRUE);
+	wiringPiSPIxSetupMode(BUS, 1, 0, 0);
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	int value = analogRead(202);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	Decode(count, CS1, 0, got, 3);
+	printf("mcp3004 request %02X %02X %02X, value %d\n", got[0], got[1], got[2], value);
+	CheckSame("mcp3004 request", got[0] == 0x01 && got[1] == 0xA0 && got[2] == 0x00, 1);
+	CheckSame("mcp3004 value", value, 0x3FF);
+
+	// transactions: separate buffers, one chip select unless csChange
+	const uint8_t cmd[2] = { 0x40, 0x12 };
+	uint8_t payload[2] = { 0xAA, 0x55 }, readBack[2] = { 0, 0 };
+	struct wiringPiSPISegment segs[2];
+	memset(segs, 0, sizeof(segs));
+	segs[0].tx = cmd;
+	segs[0].len = 2;
+	segs[1].tx = payload;
+	segs[1].rx = readBack;
+	segs[1].len = 2;
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	CheckSame("wiringPiSPIxTransaction", wiringPiSPIxTransaction(BUS, 0, segs, 2), 4);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	Decode(count, CS0, 0, got, 4);
+	CheckSame("Transaction data", got[0] == 0x40 && got[1] == 0x12 && got[2] == 0xAA && got[3] == 0x55, 1);
+	CheckSame("Transaction one chip select", Selects(count, CS0), 1);
+	CheckSame("Transaction tx kept", payload[0] == 0xAA && payload[1] == 0x55, 1);
+	CheckSame("Transaction rx", readBack[0] == 0xFF && readBack[1] == 0xFF, 1);
+	segs[0].csChange = 1;
+	segs[1].csChange = 1;
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	wiringPiSPITransaction(wiringPiSPIChannel(BUS, 0), segs, 2);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	CheckSame("csChange chip selects", Selects(count, CS0), 2);
+	CheckSame("Chip select released", digitalRead(CS0), HIGH);
+
+	// drivers on transactions
+	int values[8];
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	CheckSame("mcp3004AnalogReadAll", mcp3004AnalogReadAll(200, values, 8), 8);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	Decode(count, CS1, 0, got, 6);
+	CheckSame("mcp3004 conversions", Selects(count, CS1), 8);
+	CheckSame("mcp3004 channels 0 and 1", got[1] == 0x80 && got[4] == 0x90, 1);
+	CheckSame("mcp3004 values", values[0] == 0x3FF && values[7] == 0x3FF, 1);
+	CheckSame("mcp3004AnalogReadAll no node", mcp3004AnalogReadAll(900, values, 8), -1);
+
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	CheckSame("mcp23s17Setup on bus 7", mcp23s17Setup(300, wiringPiSPIChannel(BUS, 0), 0), TRUE);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	Decode(count, CS0, 0, got, 3);
+	CheckSame("mcp23s17 IOCON write", got[0] == 0x40 && got[1] == 0x0A, 1);
+	CheckSame("mcp23s17 2 writes, 2 reads", Selects(count, CS0), 4);
+
+	return UnitTestState();
+}
@@ -0,0 +1,188 @@
+// WiringPi test program: asynchronous SPI queue, runs on a software SPI bus on the simulated registers
+// Compile: gcc -Wall wiringpi_test18_spiasync.c -o wiringpi_test18_spiasync -lwiringPi
+
+#include "wpi_test.h"
+#include <wiringPiSPI.h>
+#include <softSpi.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define LOG_DEPTH 65536
+#define REQUESTS  32
+#define LEN       64
+#define RUNS      5
+
+const int SCLK = 11;
+const int MOSI = 10;
+const int CS0  = 8;
+const int BUS  = SOFT_SPI_FIRST;
+
+struct WPISimWrite simLog[LOG_DEPTH];
+uint8_t frames[REQUESTS][LEN];
+unsigned int doneTickets[REQUESTS];
+int doneCount = 0, doneBytes = 0;
+
+
+long long NowNs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+
+void Done(void* userData, unsigned int ticket, int result) {
+	(void)userData;
+	if (doneCount < REQUESTS) {
+		doneTickets[doneCount] = ticket;
+	}
+	doneCount++;
+	doneBytes += result;
+}
+
+
+// A callback waiting for its own bus
+void FenceDone(void* userData, unsigned int ticket, int result) {
+	(void)ticket;
+	(void)result;
+	*(int*)userData = wiringPiSPIxFence(BUS);
+}
+
+
+// First byte of every chip select frame on the bus, mode 0
+int FirstBytes(int count, uint8_t* out, int max) {
+	int frames = 0, bits = 0, selected = 0;
+	uint8_t value = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & (1u << CS0)) {
+			selected = !(simLog[i].level & (1u << CS0));
+			bits = 0;
+			value = 0;
+		}
+		if (selected && (simLog[i].changed & simLog[i].level & (1u << SCLK)) && bits < 8) {
+			value = (value << 1) | ((simLog[i].level >> MOSI) & 1);
+			if (++bits == 8 && frames < max) {
+				out[frames++] = value;
+			}
+		}
+	}
+	return frames;
+}
+
+
+int main (void) {
+	struct wiringPiSPISegment seg;
+	struct wiringPiSPIAsyncStats stats;
+	struct wiringPiSPICompletion c;
+	const int csPins[] = { CS0 };
+	uint8_t first[REQUESTS];
+	int major, minor, count, ordered;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi asynchronous SPI test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+	CheckSame("softSpiSetup", softSpiSetup(BUS, SCLK, MOSI, -1, csPins, 1), 0);
+	CheckSame("Too many segments", wiringPiSPIxSubmit(BUS, 0, &seg, WPI_SPI_ASYNC_SEGMENTS + 1, NULL, NULL), -EINVAL);
+
+	for (int r = 0; r < REQUESTS; r++) {
+		memset(frames[r], r, LEN);
+	}
+	memset(&seg, 0, sizeof(seg));
+	seg.len = LEN;
+
+	// blocking reference, best of RUNS
+	long long t, blocking = 0;
+	for (int run = 0; run < RUNS; run++) {
+		t = NowNs();
+		for (int r = 0; r < REQUESTS; r++) {
+			wiringPiSPIxDataRW(BUS, 0, frames[r], LEN);
+			memset(frames[r], r, LEN);
+		}
+		t = NowNs() - t;
+		if (run == 0 || t < blocking) {
+			blocking = t;
+		}
+	}
+
+	// queued with callbacks: the caller is back at once. The worker thread
+	// starts with the first request, best of RUNS like the reference.
+	seg.tx = frames[0];
+	wiringPiSPIxSubmit(BUS, 0, &seg, 1, NULL, NULL);
+	wiringPiSPIxFence(BUS);
+	wiringPiSPIxPollCompletion(BUS, &c);
+	long long submit = 0, async = 0;
+	for (int run = 0; run < RUNS; run++) {
+		doneCount = doneBytes = 0;
+		wiringPiSimLog(simLog, LOG_DEPTH);
+		wiringPiSPIxAsyncStats(BUS, &stats, 1);
+		t = NowNs();
+		for (int r = 0; r < REQUESTS; r++) {
+			seg.tx = frames[r];
+			CheckSame("Submit", wiringPiSPIxSubmit(BUS, 0, &seg, 1, Done, NULL) > 0, 1);
+		}
+		long long s = NowNs() - t;
+		CheckSame("Fence", wiringPiSPIxFence(BUS), 0);
+		t = NowNs() - t;
+		if (run == 0 || t < async) {
+			async = t;
+		}
+		if (run == 0 || s < submit) {
+			submit = s;
+		}
+	}
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	wiringPiSPIxAsyncStats(BUS, &stats, 0);
+
+	printf("\n%d x %d bytes: blocking %.2f ms, queued %.2f ms (submit %.3f ms), %llu requests in %llu transactions\n",
+	  REQUESTS, LEN, blocking/1e6, async/1e6, submit/1e6, stats.submitted, stats.messages);
+	CheckSame("All callbacks", doneCount, REQUESTS);
+	CheckSame("All bytes", doneBytes, REQUESTS*LEN);
+	CheckSame("Submit faster than the transfers", submit < async/4, 1);
+	CheckSame("Merged into less transactions", stats.messages < stats.submitted, 1);
+	CheckSame("Throughput like blocking (+50% noise)", async < blocking*3/2, 1);
+
+	ordered = 1;
+	for (int r = 1; r < REQUESTS; r++) {
+		if (doneTickets[r] != doneTickets[r-1] + 1) {
+			ordered = 0;
+		}
+	}
+	CheckSame("Callbacks in order", ordered, 1);
+	int frameCount = FirstBytes(count, first, REQUESTS);
+	CheckSame("One chip select per request", frameCount, REQUESTS);
+	ordered = 1;
+	for (int r = 0; r < frameCount; r++) {
+		if (first[r] != r) {
+			ordered = 0;
+		}
+	}
+	CheckSame("Transferred in order", ordered, 1);
+
+	// without callback the results go to the completion ring
+	seg.tx = frames[0];
+	int ticket1 = wiringPiSPIxSubmit(BUS, 0, &seg, 1, NULL, frames[0]);
+	int ticket2 = wiringPiSPIxSubmit(BUS, 0, &seg, 1, NULL, frames[1]);
+	wiringPiSPIxFence(BUS);
+	CheckSame("Completion 1", wiringPiSPIxPollCompletion(BUS, &c), 1);
+	CheckSame("Completion 1 ticket", c.ticket == (unsigned int)ticket1 && c.result == LEN && c.userData == frames[0], 1);
+	CheckSame("Completion 2", wiringPiSPIxPollCompletion(BUS, &c), 1);
+	CheckSame("Completion 2 ticket", c.ticket == (unsigned int)ticket2 && c.userData == frames[1], 1);
+	CheckSame("No more completions", wiringPiSPIxPollCompletion(BUS, &c), 0);
+
+	// errors are reported, not blocking
+	wiringPiSPIxSubmit(BUS, 5, &seg, 1, NULL, NULL);
+	wiringPiSPIxFence(BUS);
+	CheckSame("Invalid channel completion", wiringPiSPIxPollCompletion(BUS, &c) == 1 && c.result < 0, 1);
+
+	// fence from a callback of the bus
+	int fenceResult = 0;
+	wiringPiSPIxSubmit(BUS, 0, &seg, 1, FenceDone, &fenceResult);
+	CheckSame("Fence after the callback", wiringPiSPIxFence(BUS), 0);
+	CheckSame("Fence in the callback", fenceResult, -EDEADLK);
+
+	return UnitTestState();
+}
@@ -0,0 +1,175 @@
+// WiringPi test program: SPI devices with own settings on a shared bus, runs on the simulated registers
+// Compile: gcc -Wall wiringpi_test19_spidevice.c -o wiringpi_test19_spidevice -lwiringPi -lpthread
+
+#include "wpi_test.h"
+#include <wiringPiSPI.h>
+#include <softSpi.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#define LOG_DEPTH 32768
+#define TRANSACTIONS 20
+#define BYTES 4
+
+const int SCLK = 11;
+const int MOSI = 10;
+const int CS0  = 8;
+const int CS1  = 7;
+const int BUS  = SOFT_SPI_FIRST;
+
+struct WPISimWrite simLog[LOG_DEPTH];
+
+struct Job {
+	int handle;
+	uint8_t seed;
+	uint8_t sent[TRANSACTIONS*BYTES];
+	int errors;
+};
+
+
+// What a slave on chip select cs sees: MOSI at the sampling edges of the mode
+int Decode(int count, int cs, int mode, uint8_t* out, int maxBytes) {
+	int bits = 0, selected = 0;
+	int idle = (mode & 2) ? 1 : 0;
+
+	memset(out, 0, maxBytes);
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & (1u << cs)) {
+			selected = !(simLog[i].level & (1u << cs));
+		}
+		if (!selected || !(simLog[i].changed & (1u << SCLK))) {
+			continue;
+		}
+		int clock = (simLog[i].level >> SCLK) & 1;
+		int leading = (clock != idle);
+		if (leading == !(mode & 1) && bits < maxBytes*8) {
+			if (simLog[i].level & (1u << MOSI)) {
+				out[bits/8] |= 0x80 >> (bits%8);
+			}
+			bits++;
+		}
+	}
+	return bits;
+}
+
+
+void* Poll(void* arg) {
+	struct Job* job = arg;
+	unsigned char data[BYTES];
+
+	for (int t = 0; t < TRANSACTIONS; t++) {
+		for (int b = 0; b < BYTES; b++) {
+			data[b] = job->sent[t*BYTES + b] = (uint8_t)(job->seed + t*7 + b*0x31);
+		}
+		if (wiringPiSPIDeviceDataRW(job->handle, data, BYTES) != BYTES) {
+			job->errors++;
+		}
+	}
+	return NULL;
+}
+
+
+int main (void) {
+	const int csPins[] = { CS0, CS1 };
+	struct Job jobA, jobB;
+	pthread_t threadA, threadB;
+	uint8_t got[TRANSACTIONS*BYTES];
+	unsigned char data[BYTES];
+	int major, minor, count, devA, devB;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi SPI device test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+	CheckSame("softSpiSetup", softSpiSetup(BUS, SCLK, MOSI, -1, csPins, 2), 0);
+	CheckSame("Legacy channel mode 1", wiringPiSPIxSetupMode(BUS, 0, 1000000, 1), 0);
+
+	devA = wiringPiSPIxOpenDevice(BUS, 0, 500000, 0);
+	devB = wiringPiSPIxOpenDevice(BUS, 1, 250000, 3);
+	CheckSame("Open device A", devA >= 0, 1);
+	CheckSame("Open device B", devB >= 0 && devB != devA, 1);
+	CheckSame("Open invalid mode", wiringPiSPIxOpenDevice(BUS, 0, 500000, 4), -EINVAL);
+	CheckSame("Config invalid bits", wiringPiSPIDeviceConfig(devA, 500000, 0, 12, 0), -EINVAL);
+	CheckSame("Lock invalid bus", wiringPiSPIxLockBus(16), -EINVAL);
+
+	// two threads, one bus, different modes and speeds
+	memset(&jobA, 0, sizeof(jobA));
+	memset(&jobB, 0, sizeof(jobB));
+	jobA.handle = devA;
+	jobA.seed = 0x11;
+	jobB.handle = devB;
+	jobB.seed = 0xC3;
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	pthread_create(&threadA, NULL, Poll, &jobA);
+	pthread_create(&threadB, NULL, Poll, &jobB);
+	pthread_join(threadA, NULL);
+	pthread_join(threadB, NULL);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	CheckSame("Log not full", count < LOG_DEPTH, 1);
+	CheckSame("Thread A transfers", jobA.errors, 0);
+	CheckSame("Thread B transfers", jobB.errors, 0);
+
+	int both = 0;
+	for (int i = 0; i < count; i++) {
+		if (!(simLog[i].level & (1u << CS0)) && !(simLog[i].level & (1u << CS1))) {
+			both++;
+		}
+	}
+	CheckSame("Never both chip selects active", both, 0);
+	CheckSame("Device A bits (mode 0)", Decode(count, CS0, 0, got, sizeof(got)), TRANSACTIONS*BYTES*8);
+	CheckSame("Device A data", memcmp(got, jobA.sent, sizeof(got)), 0);
+	CheckSame("Device B bits (mode 3)", Decode(count, CS1, 3, got, sizeof(got)), TRANSACTIONS*BYTES*8);
+	CheckSame("Device B data", memcmp(got, jobB.sent, sizeof(got)), 0);
+
+	// the channel keeps the mode of wiringPiSPIxSetupMode
+	data[0] = 0x96;
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	CheckSame("Legacy DataRW", wiringPiSPIxDataRW(BUS, 0, data, 1), 1);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+	Decode(count, CS0, 1, got, 1);
+	CheckSame("Legacy channel still mode 1", got[0], 0x96);
+
+	// a locked bus runs two transactions without the other thread in between
+	CheckSame("Device A 16 bit words", wiringPiSPIDeviceConfig(devA, 500000, 0, 16, 0), 0);
+	jobB.seed = 0x42;
+	CheckSame("Lock bus", wiringPiSPIxLockBus(BUS), 0);
+	pthread_create(&threadB, NULL, Poll, &jobB);
+	delay(5);
+	for (int t = 0; t < 2; t++) {
+		for (int b = 0; b < BYTES; b++) {
+			data[b] = (uint8_t)(0xA0 + t*BYTES + b);
+		}
+		CheckSame("Device A while locked", wiringPiSPIDeviceDataRW(devA, data, BYTES), BYTES);
+		delay(5);
+	}
+	CheckSame("Unlock bus", wiringPiSPIxUnlockBus(BUS), 0);
+	pthread_join(threadB, NULL);
+	count = wiringPiSimLog(simLog, LOG_DEPTH);
+
+	int selectsA = 0, firstB = -1, secondA = -1;
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & ~simLog[i].level & (1u << CS0)) {
+			if (++selectsA == 2) {
+				secondA = i;
+			}
+		}
+		if (firstB < 0 && (simLog[i].changed & ~simLog[i].level & (1u << CS1))) {
+			firstB = i;
+		}
+	}
+	CheckSame("Two selects of device A", selectsA, 2);
+	CheckSame("Device B waits for the unlock", firstB > secondA, 1);
+	Decode(count, CS0, 0, got, 2*BYTES);
+	uint8_t wordsA[2*BYTES] = { 0xA1, 0xA0, 0xA3, 0xA2, 0xA5, 0xA4, 0xA7, 0xA6 };  // 16 bit words, MSB first
+	CheckSame("Device A 16 bit data", memcmp(got, wordsA, sizeof(wordsA)), 0);
+
+	CheckSame("Close device A", wiringPiSPICloseDevice(devA), 0);
+	CheckSame("Close device A twice", wiringPiSPICloseDevice(devA), -EBADF);
+	CheckSame("Closed device", wiringPiSPIDeviceDataRW(devA, data, 1), -EBADF);
+	CheckSame("Close device B", wiringPiSPICloseDevice(devB), 0);
+
+	return UnitTestState();
+}
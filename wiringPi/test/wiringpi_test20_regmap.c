@@ -0,0 +1,110 @@
+// WiringPi test program: register cache of the device nodes, on a fake register file
+// Compile: gcc -Wall wiringpi_test20_regmap.c -o wiringpi_test20_regmap -lwiringPi
+
+#include "wpi_test.h"
+#include <wiringPiRegmap.h>
+#include <string.h>
+
+#define REGS 22
+#define GPIOA 0x12
+#define OLATA 0x14
+
+uint8_t chip[REGS];
+int reads, writes, lastCount;
+
+
+int FakeRead(void* ctx, int reg, uint8_t* values, int count) {
+	(void)ctx;
+	memcpy(values, &chip[reg], count);
+	reads++;
+	lastCount = count;
+	return 0;
+}
+
+
+int FakeWrite(void* ctx, int reg, const uint8_t* values, int count) {
+	(void)ctx;
+	memcpy(&chip[reg], values, count);
+	writes++;
+	lastCount = count;
+	return 0;
+}
+
+
+int main (void) {
+	struct wiringPiRegmapStats stats;
+	struct wiringPiRegmap* map;
+	int major, minor;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi register cache test program (WiringPi %d.%d)\n", major, minor);
+
+	for (int r = 0; r < REGS; r++) {
+		chip[r] = 0x10 + r;
+	}
+	CheckSame("Invalid map", wiringPiRegmapNew(0, 1, FakeRead, FakeWrite, NULL) == NULL, 1);
+	map = wiringPiRegmapNew(REGS, 2, FakeRead, FakeWrite, NULL);
+	CheckSame("New map", map != NULL, 1);
+	if (map == NULL) {
+		return UnitTestState();
+	}
+	wiringPiRegmapVolatile(map, GPIOA, 2);
+
+	// first read loads the pair, then memory
+	CheckSame("Read IODIRB", wiringPiRegmapRead(map, 1), 0x11);
+	CheckSame("Pair in one read", reads == 1 && lastCount == 2, 1);
+	CheckSame("Read IODIRA cached", wiringPiRegmapRead(map, 0), 0x10);
+	CheckSame("Read IODIRB cached", wiringPiRegmapRead(map, 1), 0x11);
+	CheckSame("No more bus reads", reads, 1);
+	CheckSame("Out of range", wiringPiRegmapRead(map, REGS), -22);
+
+	// volatile: always the chip, one register
+	chip[GPIOA] = 0x5A;
+	CheckSame("Read GPIOA", wiringPiRegmapRead(map, GPIOA), 0x5A);
+	chip[GPIOA] = 0xA5;
+	CheckSame("Read GPIOA again", wiringPiRegmapRead(map, GPIOA), 0xA5);
+	CheckSame("Volatile reads", reads == 3 && lastCount == 1, 1);
+
+	// writes: same value skips the bus
+	chip[OLATA] = 0;
+	CheckSame("Load OLAT pair", wiringPiRegmapLoad(map, OLATA, 2), 0);
+	reads = writes = 0;
+	wiringPiRegmapGetStats(map, &stats, 1);
+	for (int i = 0; i < 8; i++) {
+		wiringPiRegmapUpdate(map, OLATA, 1 << i, 0xFF);
+		wiringPiRegmapUpdate(map, OLATA, 1 << i, 0xFF);   // already set
+	}
+	CheckSame("OLATA all set", chip[OLATA], 0xFF);
+	CheckSame("8 bus writes for 16 updates", writes, 8);
+	CheckSame("No bus reads", reads, 0);
+	wiringPiRegmapGetStats(map, &stats, 0);
+	printf("\n%llu bus reads, %llu bus writes, %llu cache hits, %llu skipped, %llu coalesced\n",
+	  stats.busReads, stats.busWrites, stats.cacheHits, stats.skipped, stats.coalesced);
+	CheckSame("Skipped writes", (int)stats.skipped, 8);
+	CheckSame("Cache hits", (int)stats.cacheHits, 16);
+
+	// deferred: the A/B pair goes out in one transaction
+	writes = 0;
+	wiringPiRegmapDefer(map, 1);
+	wiringPiRegmapWrite(map, 0x0C, 0x0F);
+	wiringPiRegmapWrite(map, 0x0D, 0xF0);
+	wiringPiRegmapWrite(map, 0x02, 0x33);
+	CheckSame("Deferred, no bus writes", writes, 0);
+	CheckSame("Deferred value read back", wiringPiRegmapRead(map, 0x0D), 0xF0);
+	CheckSame("Chip not written yet", chip[0x0D], 0x10 + 0x0D);
+	CheckSame("Defer off syncs", wiringPiRegmapDefer(map, 0), 0);
+	CheckSame("2 transactions for 3 registers", writes, 2);
+	CheckSame("Chip written", chip[0x0C] == 0x0F && chip[0x0D] == 0xF0 && chip[0x02] == 0x33, 1);
+	wiringPiRegmapGetStats(map, &stats, 0);
+	CheckSame("Coalesced", (int)stats.coalesced, 1);
+	CheckSame("Nothing left to sync", wiringPiRegmapSync(map) == 0 && writes == 2, 1);
+
+	// invalidate: next read goes to the chip
+	chip[0] = 0x77;
+	wiringPiRegmapInvalidate(map);
+	CheckSame("Read after invalidate", wiringPiRegmapRead(map, 0), 0x77);
+
+	wiringPiRegmapFree(map);
+
+	return UnitTestState();
+}
@@ -0,0 +1,152 @@
+// WiringPi test program: whole port read/write, on the simulated registers and a fake node
+// Compile: gcc -Wall wiringpi_test21_port.c -o wiringpi_test21_port -lwiringPi
+
+#include "wpi_test.h"
+#include <wiringPiRegmap.h>
+#include <string.h>
+
+#define PIN_BASE 100
+#define GPIOA 0x12
+#define OLATA 0x14
+
+uint8_t chip[22];
+int reads, writes, lastCount;
+int portReads, portWrites, pinWrites;
+unsigned int lastMask;
+
+
+int FakeRead(void* ctx, int reg, uint8_t* values, int count) {
+	(void)ctx;
+	memcpy(values, &chip[reg], count);
+	reads++;
+	lastCount = count;
+	return 0;
+}
+
+
+int FakeWrite(void* ctx, int reg, const uint8_t* values, int count) {
+	(void)ctx;
+	memcpy(&chip[reg], values, count);
+	writes++;
+	lastCount = count;
+	return 0;
+}
+
+
+// fake 16 pin node, the outputs loop back to the inputs
+int NodeRead(struct wiringPiNodeStruct* node, int pin) {
+	return (node->data0 >> (pin - node->pinBase)) & 1;
+}
+
+
+void NodeWrite(struct wiringPiNodeStruct* node, int pin, int value) {
+	pinWrites++;
+	if (value) {
+		node->data0 |= 1u << (pin - node->pinBase);
+	} else {
+		node->data0 &= ~(1u << (pin - node->pinBase));
+	}
+}
+
+
+unsigned int NodeReadPort(struct wiringPiNodeStruct* node, int pin, int bits) {
+	portReads++;
+	return (node->data0 >> (pin - node->pinBase)) & ((1u << bits) - 1);
+}
+
+
+void NodeWritePort(struct wiringPiNodeStruct* node, int pin, int bits, unsigned int value, unsigned int mask) {
+	(void)bits;
+	portWrites++;
+	lastMask = mask;
+	pin -= node->pinBase;
+	node->data0 = (node->data0 & ~(mask << pin)) | ((value & mask) << pin);
+}
+
+
+int main (void) {
+	struct wiringPiNodeStruct* node;
+	struct wiringPiRegmap* map;
+	int major, minor;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi port read/write test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, 0), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+
+	// on-board pins, one by one
+	for (int pin = 17; pin < 21; pin++) {
+		pinMode(pin, OUTPUT);
+	}
+	digitalWritePort(17, 4, 0x5, 0xF);
+	CheckSame("On-board write", digitalReadPort(17, 4), 0x5);
+	CheckSame("On-board single pin", digitalRead(19), HIGH);
+	digitalWritePort(17, 4, 0xF, 0x2);
+	CheckSame("On-board masked write", digitalReadPort(17, 4), 0x7);
+	CheckSame("Invalid width", digitalReadPort(17, 0), 0);
+
+	// node with port functions, one call for the port
+	node = wiringPiNewNode(PIN_BASE, 16);
+	node->digitalRead      = NodeRead;
+	node->digitalWrite     = NodeWrite;
+	node->digitalReadPort  = NodeReadPort;
+	node->digitalWritePort = NodeWritePort;
+
+	digitalWritePort(PIN_BASE + 4, 8, 0x1A5, 0xFF);
+	CheckSame("Port write one call", portWrites, 1);
+	CheckSame("Mask limited to the width", lastMask, 0xFF);
+	CheckSame("Port written", node->data0, 0xA50);
+	CheckSame("Port read", digitalReadPort(PIN_BASE + 4, 8), 0xA5);
+	CheckSame("Port read one call", portReads, 1);
+	CheckSame("No pin writes", pinWrites, 0);
+
+	digitalWrite8(PIN_BASE, 0x3C);
+	CheckSame("digitalWrite8 uses the port", portWrites, 2);
+	CheckSame("digitalRead8 uses the port", digitalRead8(PIN_BASE), 0x3C);
+
+	// past the end of the node: pin by pin
+	digitalWritePort(PIN_BASE + 12, 8, 0x0, 0x0F);
+	CheckSame("Past the end not native", portWrites, 2);
+	CheckSame("Past the end pin writes", pinWrites, 4);
+
+	// no port functions: pin by pin
+	node->digitalReadPort  = NULL;
+	node->digitalWritePort = NULL;
+	digitalWritePort(PIN_BASE, 16, 0xFFFF, 0x0101);
+	CheckSame("Fallback pin writes", pinWrites, 6);
+	CheckSame("Fallback read", digitalReadPort(PIN_BASE, 16), 0x0B3D);
+
+	// register cache: both ports of a chip in one transfer
+	map = wiringPiRegmapNew(OLATA + 2, 2, FakeRead, FakeWrite, NULL);
+	CheckSame("New map", map != NULL, 1);
+	if (map == NULL) {
+		return UnitTestState();
+	}
+	wiringPiRegmapVolatile(map, GPIOA, 2);
+	chip[GPIOA] = 0x12;
+	chip[GPIOA+1] = 0x34;
+
+	uint8_t ports[2], masks[2] = { 0xFF, 0xFF }, values[2] = { 0xAA, 0x55 };
+	CheckSame("ReadBlock", wiringPiRegmapReadBlock(map, GPIOA, ports, 2), 0);
+	CheckSame("ReadBlock one read", reads == 1 && lastCount == 2, 1);
+	CheckSame("ReadBlock values", ports[0] == 0x12 && ports[1] == 0x34, 1);
+	wiringPiRegmapReadBlock(map, GPIOA, ports, 2);
+	CheckSame("Volatile read again", reads, 2);
+
+	CheckSame("UpdateBlock", wiringPiRegmapUpdateBlock(map, OLATA, masks, values, 2), 0);
+	CheckSame("UpdateBlock one write", writes == 1 && lastCount == 2, 1);
+	CheckSame("Latches written", chip[OLATA] == 0xAA && chip[OLATA+1] == 0x55, 1);
+	wiringPiRegmapUpdateBlock(map, OLATA, masks, values, 2);
+	CheckSame("Unchanged not written", writes, 1);
+
+	masks[0] = 0;
+	values[1] = 0x50;
+	wiringPiRegmapUpdateBlock(map, OLATA, masks, values, 2);
+	CheckSame("One port changed", writes == 2 && lastCount == 1 && chip[OLATA+1] == 0x50, 1);
+	CheckSame("ReadBlock cached", wiringPiRegmapReadBlock(map, OLATA, ports, 2) == 0 && reads == 3, 1);
+	CheckSame("ReadBlock cached values", ports[0] == 0xAA && ports[1] == 0x50, 1);
+	wiringPiRegmapFree(map);
+
+	return UnitTestState();
+}
@@ -0,0 +1,143 @@
+// WiringPi test program: write combining of device nodes, fake register file and 74x595 on the simulated registers
+// Compile: gcc -Wall wiringpi_test22_nodebatch.c -o wiringpi_test22_nodebatch -lwiringPi
+
+#include "wpi_test.h"
+#include <wiringPiRegmap.h>
+#include <sr595.h>
+#include <string.h>
+
+#define LOG_DEPTH 4096
+#define OLATA 0x14
+
+const int DATA  = 17;
+const int CLOCK = 27;
+const int LATCH = 22;
+
+uint8_t chip[22];
+int writes, lastCount;
+int chainLatches, chainShift, chainOutput;	// 74x595 on node pins 100-102
+struct WPISimWrite simLog[LOG_DEPTH];
+
+
+int FakeRead(void* ctx, int reg, uint8_t* values, int count) {
+	(void)ctx;
+	memcpy(values, &chip[reg], count);
+	return 0;
+}
+
+
+int FakeWrite(void* ctx, int reg, const uint8_t* values, int count) {
+	(void)ctx;
+	if (reg == OLATA) {
+		uint8_t rising = values[0] & ~chip[OLATA];
+		if (rising & 0x2) {
+			chainShift = (chainShift << 1) | (values[0] & 0x1);
+		}
+		if (rising & 0x4) {
+			chainOutput = chainShift & 0xFF;
+			chainLatches++;
+		}
+	}
+	memcpy(&chip[reg], values, count);
+	writes++;
+	lastCount = count;
+	return 0;
+}
+
+
+// 16 outputs on the A/B latch pair, like the MCP23017
+void NodeWrite(struct wiringPiNodeStruct* node, int pin, int value) {
+	pin -= node->pinBase;
+	wiringPiRegmapUpdate(node->regmap, OLATA + pin/8, 1 << (pin & 7), value ? 0xFF : 0);
+}
+
+
+// Latch pulses of the shift register in the log
+int LatchPulses(int count) {
+	int pulses = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (simLog[i].changed & simLog[i].level & (1u << LATCH)) {
+			pulses++;
+		}
+	}
+	return pulses;
+}
+
+
+int main (void) {
+	struct wiringPiNodeStruct* node;
+	int major, minor;
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi node write combining test program (WiringPi %d.%d)\n", major, minor);
+
+	CheckSame("Simulation setup", wiringPiSimSetup(0xC03111, NULL, LOG_DEPTH), 0);
+	CheckSame("wiringPiSetupGpio", wiringPiSetupGpio(), 0);
+
+	node = wiringPiNewNode(100, 16);
+	node->regmap = wiringPiRegmapNew(OLATA + 2, 2, FakeRead, FakeWrite, node);
+	node->digitalWrite = NodeWrite;
+	CheckSame("sr595Setup", sr595Setup(200, 16, DATA, CLOCK, LATCH), TRUE);
+
+	// without a transaction every pin is written
+	for (int pin = 100; pin < 116; pin++) {
+		digitalWrite(pin, HIGH);
+	}
+	CheckSame("16 writes", writes, 16);
+
+	// 16 pins in one write of the pair
+	writes = 0;
+	wiringPiNodeBegin();
+	for (int pin = 100; pin < 116; pin++) {
+		digitalWrite(pin, pin & 1);
+	}
+	CheckSame("Nothing written before the commit", writes, 0);
+	CheckSame("Commit", wiringPiNodeCommit(), 0);
+	CheckSame("One write", writes == 1 && lastCount == 2, 1);
+	CheckSame("Latches", chip[OLATA] == 0xAA && chip[OLATA+1] == 0xAA, 1);
+
+	// nested, the outer commit writes, only the changed register
+	writes = 0;
+	wiringPiNodeBegin();
+	wiringPiNodeBegin();
+	digitalWrite(109, LOW);
+	digitalWrite(111, LOW);
+	wiringPiNodeCommit();
+	CheckSame("Inner commit not written", writes, 0);
+	wiringPiNodeCommit();
+	CheckSame("Outer commit one write", writes == 1 && lastCount == 1, 1);
+	CheckSame("Port B", chip[OLATA+1], 0xA0);
+	CheckSame("Commit without begin", wiringPiNodeCommit(), 0);
+	CheckSame("No more writes", writes, 1);
+
+	// shift register: one pass through the chain
+	wiringPiSimLog(simLog, LOG_DEPTH);
+	for (int pin = 200; pin < 216; pin++) {
+		digitalWrite(pin, HIGH);
+	}
+	CheckSame("74x595 pass per write", LatchPulses(wiringPiSimLog(simLog, LOG_DEPTH)), 16);
+	wiringPiNodeBegin();
+	for (int pin = 200; pin < 216; pin++) {
+		digitalWrite(pin, pin & 1);
+	}
+	CheckSame("74x595 nothing before the commit", LatchPulses(wiringPiSimLog(simLog, LOG_DEPTH)), 0);
+	wiringPiNodeCommit();
+	CheckSame("74x595 one pass", LatchPulses(wiringPiSimLog(simLog, LOG_DEPTH)), 1);
+
+	// 74x595 on the pins of the register node: the node writes every edge
+	CheckSame("sr595Setup on node pins", sr595Setup(300, 8, 100, 101, 102), TRUE);
+	chainLatches = 0;
+	wiringPiNodeBegin();
+	for (int pin = 300; pin < 308; pin++) {
+		digitalWrite(pin, pin & 1);
+	}
+	digitalWrite(115, HIGH);
+	CheckSame("Chain nothing before the commit", chainLatches, 0);
+	CheckSame("Chain commit", wiringPiNodeCommit(), 0);
+	CheckSame("Chain one pass", chainLatches, 1);
+	CheckSame("Chain output", chainOutput, 0xAA);
+	CheckSame("Node write kept", chip[OLATA+1] & 0x80, 0x80);
+
+	return UnitTestState();
+}
@@ -35,6 +35,15 @@ int main (void) {
 	digitalWriteEx(GPIO, GPIOIN, LOW);
 	delayMicroseconds(600000);
 
+	printf("\nTest bank output (single multi-line request)\n");
+	digitalWriteMask(digitalPinToBank(GPIO), digitalPinToBitMask(GPIO), 0);
+	delayMicroseconds(5000);
+	CheckSame("Bank write HIGH, read GPIOIN", digitalRead(GPIOIN), HIGH);
+	digitalWriteMask(digitalPinToBank(GPIO), 0, digitalPinToBitMask(GPIO));
+	delayMicroseconds(5000);
+	CheckSame("Bank write LOW, read GPIOIN", digitalRead(GPIOIN), LOW);
+	CheckGPIO(GPIO, GPIOIN, LOW);
+
     printf("\nTest output off with pull up\n");
     pinMode(GPIO, OUTPUT);
     digitalWriteEx(GPIO, GPIOIN, LOW);
@@ -81,6 +81,18 @@ int main (void) {
 
 	digitalWrite(GPIO, LOW);
 
+	printf("\nbank write/read (digitalWriteMask, digitalReadBank) ...\n");
+	CheckSame("Bank of GPIO", digitalPinToBank(GPIO), GPIO/32);
+	for (int loop=1; loop<ToggleValue; loop++) {
+		digitalWriteMask(digitalPinToBank(GPIO), digitalPinToBitMask(GPIO), 0);
+		delayMicroseconds(5000);
+		CheckSame("Bank read GPIOIN HIGH", (digitalReadBank(digitalPinToBank(GPIOIN)) & digitalPinToBitMask(GPIOIN)) ? HIGH : LOW, HIGH);
+		digitalWriteMask(digitalPinToBank(GPIO), 0, digitalPinToBitMask(GPIO));
+		delayMicroseconds(5000);
+		CheckSame("Bank read GPIOIN LOW", (digitalReadBank(digitalPinToBank(GPIOIN)) & digitalPinToBitMask(GPIOIN)) ? HIGH : LOW, LOW);
+	}
+	CheckGPIO(GPIO, GPIOIN, LOW);
+
 	printf("\nWiringPi GPIO test program (using GPIO%d (input pull up/down) and GPIO%d (input))\n", GPIO, GPIOIN);
 	pullUpDnControl (GPIO, PUD_UP);
 	SetAndCheckMode(GPIO, INPUT);
@@ -116,6 +116,144 @@ double DurationTime(int Enge, int OUTpin, int IRQpin) {
 }
 
 
+struct ISR2Data {
+	int count;
+	int rising;
+	int falling;
+	unsigned int pinBCM;
+	long long lastTimeStamp;
+	int timeOrderOK;
+};
+
+
+static void wfi2 (struct WPIWfiStatus wfiStatus, void* userdata) {
+  struct ISR2Data* data = (struct ISR2Data*)userdata;
+
+  if (wfiStatus.timeStamp_ns < data->lastTimeStamp) {
+    data->timeOrderOK = 0;
+  }
+  data->lastTimeStamp = wfiStatus.timeStamp_ns;
+  data->pinBCM = wfiStatus.pinBCM;
+  if (INT_EDGE_RISING == wfiStatus.edge) {
+    data->rising++;
+  } else if (INT_EDGE_FALLING == wfiStatus.edge) {
+    data->falling++;
+  }
+  data->count++;
+}
+
+
+void ISR2Test(int OUTpin, int IRQpin) {
+  struct ISR2Data data;
+  struct timeval t1, t2;
+
+  memset(&data, 0, sizeof(data));
+  data.timeOrderOK = 1;
+  digitalWrite(OUTpin, LOW);
+
+  gettimeofday(&t1, 0);
+  int result = wiringPiISR2(IRQpin, INT_EDGE_BOTH, &wfi2, 0, &data);
+  gettimeofday(&t2, 0);
+  CheckSame("Register ISR2", result, 0);
+  double regTime = (t2.tv_sec - t1.tv_sec)*1000000.0 + (t2.tv_usec - t1.tv_usec);
+  printf("Register time %g usec\n", regTime);
+  CheckSame("Register without delay", regTime < 100000 ? 1 : 0, 1);
+
+  for (int loop=0; loop<ToggleValue; loop++) {
+    digitalWrite(OUTpin, HIGH);
+    delay(20);
+    digitalWrite(OUTpin, LOW);
+    delay(20);
+  }
+  delay(100);
+  wiringPiISRStop (IRQpin) ;
+
+  CheckSame("ISR2 events", data.count, 2*ToggleValue);
+  CheckSame("ISR2 rising edges", data.rising, ToggleValue);
+  CheckSame("ISR2 falling edges", data.falling, ToggleValue);
+  CheckSame("ISR2 pin", data.pinBCM, IRQpin);
+  CheckSame("ISR2 timestamps ascending", data.timeOrderOK, 1);
+}
+
+
+void BouncingContact(int OUTpin) {
+  // short pulses, then stable high and stable low
+  for (int bounce=0; bounce<5; bounce++) {
+    digitalWrite(OUTpin, HIGH);
+    delayMicroseconds(200);
+    digitalWrite(OUTpin, LOW);
+    delayMicroseconds(200);
+  }
+  digitalWrite(OUTpin, HIGH);
+  delay(50);
+  digitalWrite(OUTpin, LOW);
+  delay(50);
+}
+
+
+void DebounceTest(int OUTpin, int IRQpin) {
+  struct ISR2Data data;
+
+  memset(&data, 0, sizeof(data));
+  data.timeOrderOK = 1;
+  digitalWrite(OUTpin, LOW);
+  delay(20);
+
+  CheckSame("Register ISR2 with debounce", wiringPiISR2(IRQpin, INT_EDGE_BOTH, &wfi2, 10000, &data), 0);
+  BouncingContact(OUTpin);
+  CheckSame("Debounce 10ms, rising edges", data.rising, 1);
+  CheckSame("Debounce 10ms, falling edges", data.falling, 1);
+
+  // active line, turn it off
+  CheckSame("Set debounce off", wiringPiSetDebounce(IRQpin, 0), 0);
+  data.rising = data.falling = 0;
+  BouncingContact(OUTpin);
+  CheckSame("Debounce off, rising edges", data.rising, 6);
+  CheckSame("Debounce off, falling edges", data.falling, 6);
+
+  wiringPiISRStop (IRQpin) ;
+}
+
+
+void EdgeCaptureTest(int OUTpin, int IRQpin) {
+  struct WPIEdgeEvent events[64];
+  int total = 0, seqOK = 1, edgeOK = 1, got;
+  long long lastTime = 0;
+  unsigned int lastSeqno = 0;
+  const int edges = 2*50;
+
+  digitalWrite(OUTpin, LOW);
+  CheckSame("Register edge capture", wiringPiEdgeCapture(IRQpin, INT_EDGE_BOTH, 256), 0);
+
+  for (int loop=0; loop<edges/2; loop++) {
+    digitalWrite(OUTpin, HIGH);
+    delayMicroseconds(200);
+    digitalWrite(OUTpin, LOW);
+    delayMicroseconds(200);
+  }
+
+  while ((got = wiringPiEdgeRead(IRQpin, events, 64, 100)) > 0) {
+    for (int idx=0; idx<got; idx++) {
+      if (lastSeqno && events[idx].seqno != lastSeqno+1) {
+        seqOK = 0;
+      }
+      if (events[idx].edge != ((total+idx) % 2 ? INT_EDGE_FALLING : INT_EDGE_RISING) || events[idx].timeStamp_ns < lastTime) {
+        edgeOK = 0;
+      }
+      lastSeqno = events[idx].seqno;
+      lastTime = events[idx].timeStamp_ns;
+    }
+    total += got;
+  }
+  CheckSame("Edge capture events", total, edges);
+  CheckSame("Edge capture sequence numbers", seqOK, 1);
+  CheckSame("Edge capture edge order", edgeOK, 1);
+  CheckSame("Edge capture overflow", wiringPiEdgeOverflow(IRQpin), 0);
+  wiringPiISRStop (IRQpin) ;
+  CheckSame("Edge read after stop", wiringPiEdgeRead(IRQpin, events, 64, 0), -1);
+}
+
+
 int main (void) {
 
 	int major, minor;
@@ -169,6 +307,15 @@ int main (void) {
 	printf("Measuring duration IRQ @ GPIO%d with trigger @ GPIO%d falling\n", IRQpin, OUTpin);
 	DurationTime(INT_EDGE_FALLING, OUTpin, IRQpin);
 	}
+	printf("Testing ISR2 @ GPIO%d with trigger @ GPIO%d both\n", IRQpin, OUTpin);
+	ISR2Test(OUTpin, IRQpin);
+
+	printf("Testing debounce @ GPIO%d with trigger @ GPIO%d both\n", IRQpin, OUTpin);
+	DebounceTest(OUTpin, IRQpin);
+
+	printf("Testing edge capture @ GPIO%d with trigger @ GPIO%d both\n", IRQpin, OUTpin);
+	EdgeCaptureTest(OUTpin, IRQpin);
+
 	pinMode(OUTpin, INPUT);
 
 	return UnitTestState();
@@ -1,189 +1,366 @@
 // WiringPi test program: benchmark
 // Compile: gcc -Wall wiringpi_test7_bench.c -o wiringpi_test7_bench -lwiringPi
+//
+// Usage: wiringpi_test7_bench [-c cpu] [-n samples] [-w warmup] [--csv file] [--json file]
+//                              [--baseline file.csv] [--tolerance percent]
+//                              [--spi-speed Hz] [--spi-chunk bytes]
+//   Every operation is timed in batches, min/median/p99/max per operation are reported.
+//   Save a run with --csv and compare later runs against it with --baseline.
+//   Runs against the simulated registers too (WIRINGPI_SIM=<revision>).
+//   With /dev/spidev0.0 a 64 KB transfer is timed, --spi-chunk sets the chunk size.
 
+#define _GNU_SOURCE   // sched_setaffinity
 #include "wpi_test.h"
-//#include <stdio.h>
-//#include <stdlib.h>
-//#include <signal.h>
+#include "wpi_bench.h"
+#include <wiringPiSPI.h>
+#include <softSpi.h>
 #include <string.h>
-#include <time.h>
-#include <sys/time.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 
-int ToggleValue = 240000000;
-float fExpectTimedigitalWrite = 0.1;
-float fExpectTimedigitalRead  = 0.1;
-float fExpectTimepinMode      = 0.1;
-float fWriteReadDelayFactor   = 1.0;
-float fWriteReadFactor        = 1.0;
-float fPi4ExpectTimedigitalWrite = 0.020;
 int GPIO = 19;
 int GPIOIN = 26;
 int RaspberryPiModel = -1;
+int BenchCPU = -2;   // -2 last CPU, -1 no pinning
+int SpiSpeed = 32000000;
+int SpiChunk = 0;    // 0 spidev bufsiz
 
+#define SPI_FRAME 65536
+static unsigned char spiFrame[SPI_FRAME];
 
-double ReportElapedTime(const char* msg, int multiop, const float fExpectTime, struct timeval t1, struct timeval t2) {
-    double elapsedTime, fTimePerOperation, fFreq;
+// Expected median time per operation (ns) in wiringPiSetupGpio mode,
+// coarse plausibility check if no baseline file is given
+struct BenchExpect {
+	float digitalWrite, digitalRead, pinMode;
+};
 
-	elapsedTime = (t2.tv_sec-t1.tv_sec)+(t2.tv_usec-t1.tv_usec)/1000000.0;
-	fTimePerOperation = elapsedTime*1000000.0/ToggleValue/multiop;
-	fFreq = 1.0f/(fTimePerOperation*2); //ToggleValue/elapsedTime/1000000.0;
-	printf("  % 9d took %.3f s, Time per operation %.3f us (toggle Freq %.3f MHz) \n",
-	  ToggleValue, elapsedTime, fTimePerOperation, fFreq);
-  CheckSameFloat(msg, fTimePerOperation, fExpectTime, fExpectTime*0.2f);
 
-  return fTimePerOperation;
+// Operation context
+struct BenchPins {
+	int pin, pinin, value;
+	volatile unsigned int *set, *clr;
+	unsigned int mask;
+};
+
+static void OpRegister(void* ctx) {
+	struct BenchPins* p = ctx;
+	*p->set = p->mask;
+	*p->clr = p->mask;
+}
+
+static void OpDigitalWrite(void* ctx) {
+	struct BenchPins* p = ctx;
+	p->value = !p->value;
+	digitalWrite(p->pin, p->value);
+}
+
+static void OpDigitalRead(void* ctx) {
+	struct BenchPins* p = ctx;
+	p->value = digitalRead(p->pinin);
 }
 
+static void OpPinMode(void* ctx) {
+	struct BenchPins* p = ctx;
+	p->value = !p->value;
+	pinMode(p->pin, p->value ? OUTPUT : INPUT);
+}
 
-int main (void) {
-	struct timeval t1, t2;
+static void OpPullUpDn(void* ctx) {
+	struct BenchPins* p = ctx;
+	p->value = !p->value;
+	pullUpDnControl(p->pinin, p->value ? PUD_UP : PUD_DOWN);
+}
 
-	if (wiringPiSetupGpio()  == -1) {
-		printf("wiringPiSetupGpio failed\n\n");
+static void OpWriteMask(void* ctx) {
+	struct BenchPins* p = ctx;
+	p->value = !p->value;
+	digitalWriteMask(0, p->value ? p->mask : 0, p->value ? 0 : p->mask);
+}
+
+static void OpReadBank(void* ctx) {
+	struct BenchPins* p = ctx;
+	p->value = digitalReadBank(0);
+}
+
+
+// Node with no hardware behind it, measures the pin base lookup and call
+static int nodeLevel;
+
+static void NodeDigitalWrite(struct wiringPiNodeStruct *node, int pin, int value) {
+	nodeLevel = value;
+}
+
+static int NodeDigitalRead(struct wiringPiNodeStruct *node, int pin) {
+	return nodeLevel;
+}
+
+
+// SPI, context is the bus number
+static void OpSpiFrame(void* ctx) {
+	wiringPiSPIxDataRW(*(int*)ctx, 0, spiFrame, SPI_FRAME);
+}
+
+static void OpSpiSoft(void* ctx) {
+	wiringPiSPIxDataRW(*(int*)ctx, 0, spiFrame, 64);
+}
+
+static void BenchSpi(void) {
+	struct BenchResult* r;
+	int bus = 0;
+
+	if (access("/dev/spidev0.0", F_OK) == 0 && wiringPiSPISetup(0, SpiSpeed) >= 0) {
+		wiringPiSPISetChunkSize(SpiChunk);
+		r = BenchRun("spi/DataRW 64KB", OpSpiFrame, &bus, 1);
+		if (r != NULL && r->median > 0) {
+			printf("  spi: %.2f MB/s at %.1f MHz, chunk %d of bufsiz %d\n", SPI_FRAME * 1000.0 / r->median,
+			  SpiSpeed / 1e6, wiringPiSPIGetChunkSize(), wiringPiSPIGetBufSize());
+		}
+		wiringPiSPIClose(0);
+	}
+	// bit banged on the benchmark pins, no MOSI
+	bus = SOFT_SPI_FIRST;
+	if (softSpiSetup(bus, GPIO, -1, GPIOIN, NULL, 1) == 0) {
+		r = BenchRun("softspi/DataRW 64B", OpSpiSoft, &bus, 1);
+		if (r != NULL && r->median > 0) {
+			printf("  softspi: %.2f MHz clock\n", 64 * 8 * 1000.0 / r->median);
+		}
+	}
+}
+
+
+static void BenchName(char* name, size_t size, const char* mode, const char* op) {
+	snprintf(name, size, "%s/%s", mode, op);
+}
+
+
+// All operations of one setup mode, runs in a child process because
+// wiringPi can only be set up once per process.
+void BenchSetupMode(const char* mode, int setupmode) {
+	struct BenchPins p = { 0 };
+	char name[BENCH_NAME_LEN];
+	int device = 0;
+	int batch;
+	int status;
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid<0) {
+		return;
+	} else if (pid>0) {
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status)!=EXIT_SUCCESS) {
+			printf("  %s: not available\n", mode);
+		}
+		return;
+	}
+
+	int ret = -1;
+	switch(setupmode) {
+		case WPI_MODE_PINS:             ret = wiringPiSetup(); break;
+		case WPI_MODE_GPIO:             ret = wiringPiSetupGpio(); break;
+		case WPI_MODE_PHYS:             ret = wiringPiSetupPhys(); break;
+		case WPI_MODE_GPIO_DEVICE_BCM:  device = 1; ret = wiringPiSetupGpioDevice(WPI_PIN_BCM); break;
+		case WPI_MODE_GPIO_DEVICE_WPI:  device = 1; ret = wiringPiSetupGpioDevice(WPI_PIN_WPI); break;
+		case WPI_MODE_GPIO_DEVICE_PHYS: device = 1; ret = wiringPiSetupGpioDevice(WPI_PIN_PHYS); break;
+	}
+	if (ret != 0) {
 		exit(EXIT_FAILURE);
 	}
+	p.pin = GPIO;
+	p.pinin = GPIOIN;
+	for (int pin=0; pin<64; pin++) {
+		int gpio = -1;
+		if (WPI_MODE_PINS==setupmode || WPI_MODE_GPIO_DEVICE_WPI==setupmode) {
+			gpio = wpiPinToGpio(pin);
+		} else if (WPI_MODE_PHYS==setupmode || WPI_MODE_GPIO_DEVICE_PHYS==setupmode) {
+			gpio = physPinToGpio(pin);
+		} else {
+			break;
+		}
+		if (gpio==GPIO)   { p.pin = pin; }
+		if (gpio==GPIOIN) { p.pinin = pin; }
+	}
+	// register access is a few ns, time batches; chardev ioctls one by one
+	batch = device ? 1 : 1000;
+
+	pinMode(p.pin, OUTPUT);
+	pinMode(p.pinin, INPUT);
+	p.mask = 1u << (GPIO & 31);
+
+	if (!device) {
+		if (piRP1Model()) {
+			p.set = _wiringPiRio + 0x2000/4;
+			p.clr = _wiringPiRio + 0x3000/4;
+		} else {
+			p.set = _wiringPiGpio + 7 + GPIO/32;
+			p.clr = _wiringPiGpio + 10 + GPIO/32;
+		}
+		BenchName(name, sizeof(name), mode, "register set+clr");
+		BenchRun(name, OpRegister, &p, batch);
+	}
+	BenchName(name, sizeof(name), mode, "digitalWrite");
+	BenchRun(name, OpDigitalWrite, &p, batch);
+	BenchName(name, sizeof(name), mode, "digitalRead");
+	BenchRun(name, OpDigitalRead, &p, batch);
+	BenchName(name, sizeof(name), mode, "digitalWriteMask");
+	BenchRun(name, OpWriteMask, &p, batch);
+	BenchName(name, sizeof(name), mode, "digitalReadBank");
+	BenchRun(name, OpReadBank, &p, batch);
+	BenchName(name, sizeof(name), mode, "pullUpDnControl");
+	BenchRun(name, OpPullUpDn, &p, device ? 1 : 100);
+	p.value = 1;
+	BenchName(name, sizeof(name), mode, "pinMode");
+	BenchRun(name, OpPinMode, &p, batch);
+
+	if (WPI_MODE_GPIO==setupmode) {
+		struct wiringPiNodeStruct* node = wiringPiNewNode(1000, 8);
+		node->digitalWrite = NodeDigitalWrite;
+		node->digitalRead  = NodeDigitalRead;
+		p.pin = p.pinin = 1003;
+		BenchRun("node/digitalWrite", OpDigitalWrite, &p, 1000);
+		BenchRun("node/digitalRead", OpDigitalRead, &p, 1000);
+	}
+
+	if (WPI_MODE_GPIO==setupmode) {
+		BenchSpi();
+	}
+
+	pullUpDnControl(p.pinin, PUD_OFF);
+	pinMode(GPIO, INPUT);
+	exit(EXIT_SUCCESS);
+}
+
+
+int GetExpect(struct BenchExpect* expect) {
+	switch(RaspberryPiModel) {
+		case PI_MODEL_A:
+		case PI_MODEL_B:     //ARM=800MHz
+		case PI_MODEL_BP:
+		case PI_MODEL_AP:
+		case PI_MODEL_CM:
+			*expect = (struct BenchExpect){ 132.0f, 171.0f, 334.0f };
+			return 1;
+		case PI_MODEL_ZERO:
+		case PI_MODEL_ZERO_W: //ARM=1000MHz
+			*expect = (struct BenchExpect){ 104.0f, 135.0f, 250.0f };
+			return 1;
+		case PI_MODEL_4B:     //ARM=1500MHz
+		case PI_MODEL_400:
+		case PI_MODEL_CM4:
+		case PI_MODEL_CM4S:
+			*expect = (struct BenchExpect){ 20.0f, 38.0f, 121.0f };
+			return 1;
+		default:
+			if (piRP1Model()) {
+				// So far expect all Pi5 / RP1 hardware has same performance
+				*expect = (struct BenchExpect){ 25.0f, 323.0f, 200.0f };
+				return 1;
+			}
+			return 0;
+	}
+}
+
+
+void CheckExpect(const char* op, float expect) {
+	char name[BENCH_NAME_LEN];
+	struct BenchResult* r;
+
+	BenchName(name, sizeof(name), "gpio", op);
+	r = BenchFind(name);
+	if (r != NULL) {
+		CheckSameFloat(name, r->median, expect, expect*0.2f);
+	}
+}
+
+
+void Usage(const char* prog) {
+	printf("Usage: %s [-c cpu] [-n samples] [-w warmup] [--csv file] [--json file] [--baseline file.csv] [--tolerance percent]\n"
+	       "          [--spi-speed Hz] [--spi-chunk bytes]\n", prog);
+}
+
+
+int main (int argc, char *argv[]) {
+	const char* csvFile = NULL;
+	const char* jsonFile = NULL;
+	const char* baselineFile = NULL;
+	double tolerance = 10.0;
+	int major, minor;
+
+	for (int i = 1; i < argc; i++) {
+		const char* arg = argv[i];
+		const char* val = (i+1 < argc) ? argv[i+1] : NULL;
+		if (val == NULL) {
+			Usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		if      (strcmp(arg, "-c") == 0)          { BenchCPU = atoi(val); }
+		else if (strcmp(arg, "-n") == 0)          { benchSamples = atoi(val); }
+		else if (strcmp(arg, "-w") == 0)          { benchWarmup = atoi(val); }
+		else if (strcmp(arg, "--csv") == 0)       { csvFile = val; }
+		else if (strcmp(arg, "--json") == 0)      { jsonFile = val; }
+		else if (strcmp(arg, "--baseline") == 0)  { baselineFile = val; }
+		else if (strcmp(arg, "--tolerance") == 0) { tolerance = atof(val); }
+		else if (strcmp(arg, "--spi-speed") == 0) { SpiSpeed = atoi(val); }
+		else if (strcmp(arg, "--spi-chunk") == 0) { SpiChunk = atoi(val); }
+		else {
+			Usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		i++;
+	}
+	if (benchSamples < 10) {
+		benchSamples = 10;
+	}
+	if (BenchCPU == -2) {
+		BenchCPU = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+	}
+
+	wiringPiVersion(&major, &minor);
+	printf("WiringPi GPIO benchmark (WiringPi %d.%d), %d samples, %d warmup", major, minor, benchSamples, benchWarmup);
+	if (BenchCPU >= 0) {
+		printf(", CPU %d", BenchCPU);
+	}
+	printf("\n");
+	BenchInit();
+	BenchPinCPU(BenchCPU);
 
 	int rev, mem, maker, overVolted;
 	piBoardId(&RaspberryPiModel, &rev, &mem, &maker, &overVolted);
 	CheckNotSame("Model: ", RaspberryPiModel, -1);
 	if (!piBoard40Pin()) {
-	  GPIO = 23;
+		GPIO = 23;
 		GPIOIN = 24;
 	}
+	printf("%s%s, using GPIO %d/%d\n\n", piModelNames[RaspberryPiModel], wiringPiSimActive() ? " (simulated)" : "", GPIO, GPIOIN);
 
-  switch(RaspberryPiModel) {
-    case PI_MODEL_A:
-    case PI_MODEL_B:     //ARM=800MHz
-    case PI_MODEL_BP:
-    case PI_MODEL_AP:
-    case PI_MODEL_CM:
-      fExpectTimedigitalWrite = 0.132; //us;
-      fExpectTimedigitalRead  = 0.171; //us
-      fExpectTimepinMode      = 0.334; //us
-      break;
-    case PI_MODEL_ZERO:
-    case PI_MODEL_ZERO_W: //ARM=1000MHz
-      fExpectTimedigitalWrite = 0.104; //us;
-      fExpectTimedigitalRead  = 0.135; //us
-      fExpectTimepinMode      = 0.250; //us
-      break;
-    case PI_MODEL_2:
-      ToggleValue /= 4;
-      break;
-    case PI_MODEL_3B:
-    case PI_MODEL_CM3:
-    case PI_MODEL_3BP:
-    case PI_MODEL_3AP:
-    case PI_MODEL_CM3P:
-    case PI_MODEL_ZERO_2W:
-      ToggleValue /= 2;
-      break;
-    case PI_MODEL_4B:     //ARM=1500MHz
-    case PI_MODEL_400:
-    case PI_MODEL_CM4:
-    case PI_MODEL_CM4S:
-      fExpectTimedigitalWrite = 0.020; //us
-      fExpectTimedigitalRead  = 0.038; //us
-      fExpectTimepinMode      = 0.121; //us
-      fWriteReadDelayFactor   = 1.86;
-      break;
-    default:
-      if (piRP1Model()) {
-        // So far expect all Pi5 / RP1 hardware has same performance
-        printf("Raspberry Pi with RP1 chip found\n");
-        fExpectTimedigitalWrite = 0.025; //us
-        fExpectTimedigitalRead  = 0.323; //us
-        fExpectTimepinMode      = 0.200; //us
-        fWriteReadDelayFactor   = 3.2;
-      } else {
-        printf("Unknown Raspberry Pi found, exit\n");
-        return(EXIT_FAILURE);
-      }
-      break;
-  }
-  fWriteReadFactor = fExpectTimedigitalRead/fExpectTimedigitalWrite;
-  ToggleValue /= (fExpectTimedigitalWrite/fPi4ExpectTimedigitalWrite);
-
-	printf("WiringPi GPIO operation time test program (using GPIO %d/%d)\n", GPIO, GPIOIN);
-	pinMode(GPIO, OUTPUT);
-
-	printf("\n% 3d million times digitalWrite ...\n", ToggleValue/1000000);
-	gettimeofday(&t1, NULL);
-	for (int loop=1; loop<ToggleValue; loop++) {
-		digitalWrite(GPIO, HIGH);
-    digitalWrite(GPIO, LOW);
-	}
-	gettimeofday(&t2, NULL);
-  double OpTimeWrite = ReportElapedTime("digitalWrite", 2, fExpectTimedigitalWrite, t1, t2);
-
-	digitalWrite(GPIO, LOW);
-	pinMode(GPIOIN, INPUT);
-
-  ToggleValue /=(fExpectTimedigitalRead/fExpectTimedigitalWrite);
-  printf("\n% 3d million times digitalRead ...\n", ToggleValue/1000000);
-	gettimeofday(&t1, NULL);
-	for (int loop=1; loop<ToggleValue; loop++) {
-		digitalRead(GPIOIN);
-    digitalRead(GPIOIN);
-	}
-	gettimeofday(&t2, NULL);
-  double OpTimeRead = ReportElapedTime("digitalRead", 2, fExpectTimedigitalRead, t1, t2);
-    
-  if (!piRP1Model()) {
-    ToggleValue /= 4;
-  } else {
-    ToggleValue *= 1.5;
-  }
-  printf("\n% 3d million times pinMode...\n", ToggleValue/1000000);
-  gettimeofday(&t1, NULL);
-	for (int loop=1; loop<ToggleValue; loop++) {
-		pinMode(GPIO, OUTPUT);
-    pinMode(GPIOIN, INPUT);
-	}
-	gettimeofday(&t2, NULL);
-  ReportElapedTime("pinMode", 2, fExpectTimepinMode, t1, t2);
-
-  printf("\nToggle % 3d million times pinMode and digitalWrite ..\n", ToggleValue/1000000);
-  gettimeofday(&t1, NULL);
-	for (int loop=1; loop<ToggleValue; loop++) {
-		pinMode(GPIO, OUTPUT);
-		digitalWrite(GPIO, LOW);
-		digitalWrite(GPIO, HIGH);
-		pinMode(GPIO, INPUT);
-	}
-	gettimeofday(&t2, NULL);
-  ReportElapedTime("pinMode and digitalWrite", 2, fExpectTimepinMode+fExpectTimedigitalWrite, t1, t2);
-
-  if (!piRP1Model()) {
-    ToggleValue *= 1.5;
-  } else {
-    ToggleValue /= 5;
-  }
-  pinMode(GPIO, OUTPUT);
-  printf("\nToggle % 3d million times digitalRead and digitalWrite ..\n", ToggleValue/1000000);
-  gettimeofday(&t1, NULL);
-	for (int loop=1; loop<ToggleValue; loop++) {
-		digitalWrite(GPIO, HIGH);
-		digitalRead(GPIOIN);
-  	digitalWrite(GPIO, LOW);
-		digitalRead(GPIOIN);  
-	}
-	gettimeofday(&t2, NULL);
-  double fTimePerOperation = ReportElapedTime("digitalRead and digitalWrite", 2, (fExpectTimedigitalWrite+fExpectTimedigitalRead)*fWriteReadDelayFactor, t1, t2);
-
-  printf("\n");
-  CheckSameFloat("digitalWrite vs. digitalRead factor", OpTimeRead/OpTimeWrite, fWriteReadFactor, 0.3);
-  CheckSameFloat("digitalWrite and digitalRead alternating factor", fTimePerOperation/(fExpectTimedigitalWrite+fExpectTimedigitalRead), fWriteReadDelayFactor, 0.2);
-  if (piRP1Model()) {
-    printf("\nRasperry Pi with RP1 chip:\n");
-    printf("  * digitalRead has very slow speed, much slower then digitalWrite, factor %.1f (typical Pi4 ~1.9)\n", fWriteReadFactor);
-    printf("  * Alternating read/write operation has slow speed, factor %.2f (typical Pi4 ~1.86) to single operation time\n", fWriteReadDelayFactor);
-  }
-
-	digitalWrite(GPIO, LOW);
-	pinMode(GPIO, INPUT);
+	BenchPrintHeader();
+	BenchSetupMode("wpi",         WPI_MODE_PINS);
+	BenchSetupMode("gpio",        WPI_MODE_GPIO);
+	BenchSetupMode("phys",        WPI_MODE_PHYS);
+	BenchSetupMode("device_bcm",  WPI_MODE_GPIO_DEVICE_BCM);
+	BenchSetupMode("device_wpi",  WPI_MODE_GPIO_DEVICE_WPI);
+	BenchSetupMode("device_phys", WPI_MODE_GPIO_DEVICE_PHYS);
+	CheckNotSame("Operations measured", benchResults->count, 0);
 
-	return(EXIT_SUCCESS);
-}
+	if (csvFile) {
+		BenchWriteCSV(csvFile);
+	}
+	if (jsonFile) {
+		BenchWriteJSON(jsonFile, piModelNames[RaspberryPiModel]);
+	}
+
+	if (baselineFile) {
+		BenchCompareBaseline(baselineFile, tolerance);
+	} else if (!wiringPiSimActive()) {
+		struct BenchExpect expect;
+		if (GetExpect(&expect)) {
+			printf("\nExpected median in wiringPiSetupGpio mode (no baseline file given):\n");
+			CheckExpect("digitalWrite", expect.digitalWrite);
+			CheckExpect("digitalRead",  expect.digitalRead);
+			CheckExpect("pinMode",      expect.pinMode);
+		}
+	}
 
+	return UnitTestState();
+}
@@ -0,0 +1,225 @@
+// WiringPi benchmark helper: per operation time distribution, CSV/JSON output
+// and comparison against a saved baseline. Include after wpi_test.h, needs _GNU_SOURCE.
+
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define BENCH_MAX_RESULTS  64
+#define BENCH_NAME_LEN     48
+
+struct BenchResult {
+	char   name[BENCH_NAME_LEN];
+	int    samples;   // number of timed batches
+	int    batch;     // operations per batch
+	double min, median, p99, max, mean;   // ns per operation
+};
+
+struct BenchResults {
+	int count;
+	struct BenchResult result[BENCH_MAX_RESULTS];
+};
+
+// Shared with child processes, wiringPi can only be set up once per process
+struct BenchResults* benchResults = NULL;
+int benchWarmup  = 100;
+int benchSamples = 1000;
+
+
+void BenchInit(void) {
+	benchResults = mmap(NULL, sizeof(struct BenchResults), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (benchResults == MAP_FAILED) {
+		FailAndExitWithErrno("BenchInit: mmap", -1);
+	}
+	benchResults->count = 0;
+}
+
+
+// Pin to one CPU, less noise from migration and frequency changes of other cores
+int BenchPinCPU(int cpu) {
+	cpu_set_t set;
+
+	if (cpu < 0) {
+		return 0;
+	}
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		printf("Unable to pin to CPU %d (%s)\n", cpu, strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+
+static inline long long BenchNow(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return ts.tv_sec*1000000000LL + ts.tv_nsec;
+}
+
+
+static int BenchCompare(const void* a, const void* b) {
+	double da = *(const double*)a, db = *(const double*)b;
+	return (da > db) - (da < db);
+}
+
+
+// Time op(ctx) batch times per sample. Fast operations need batches, the
+// clock itself costs more than a register access; slow ones (ioctl) use 1.
+struct BenchResult* BenchRun(const char* name, void (*op)(void* ctx), void* ctx, int batch) {
+	double* perOp;
+	struct BenchResult* r;
+	double sum = 0.0;
+	int s, b;
+
+	if (benchResults == NULL || benchResults->count >= BENCH_MAX_RESULTS) {
+		return NULL;
+	}
+	if (batch < 1) {
+		batch = 1;
+	}
+	perOp = malloc(benchSamples * sizeof(double));
+	if (perOp == NULL) {
+		return NULL;
+	}
+	for (s = 0; s < benchWarmup; s++) {
+		for (b = 0; b < batch; b++) {
+			op(ctx);
+		}
+	}
+	for (s = 0; s < benchSamples; s++) {
+		long long t1 = BenchNow();
+		for (b = 0; b < batch; b++) {
+			op(ctx);
+		}
+		long long t2 = BenchNow();
+		perOp[s] = (double)(t2 - t1) / batch;
+		sum += perOp[s];
+	}
+	qsort(perOp, benchSamples, sizeof(double), BenchCompare);
+
+	r = &benchResults->result[benchResults->count++];
+	snprintf(r->name, sizeof(r->name), "%s", name);
+	r->samples = benchSamples;
+	r->batch   = batch;
+	r->min     = perOp[0];
+	r->median  = perOp[benchSamples/2];
+	r->p99     = perOp[(benchSamples*99)/100 < benchSamples ? (benchSamples*99)/100 : benchSamples-1];
+	r->max     = perOp[benchSamples-1];
+	r->mean    = sum / benchSamples;
+	free(perOp);
+
+	printf("  %-36s %10.1f %10.1f %10.1f %10.1f ns\n", r->name, r->min, r->median, r->p99, r->max);
+	fflush(stdout);
+	return r;
+}
+
+
+void BenchPrintHeader(void) {
+	printf("  %-36s %10s %10s %10s %10s\n", "operation", "min", "median", "p99", "max");
+}
+
+
+struct BenchResult* BenchFind(const char* name) {
+	for (int i = 0; benchResults && i < benchResults->count; i++) {
+		if (strcmp(benchResults->result[i].name, name) == 0) {
+			return &benchResults->result[i];
+		}
+	}
+	return NULL;
+}
+
+
+static FILE* BenchOpen(const char* filename) {
+	if (strcmp(filename, "-") == 0) {
+		return stdout;
+	}
+	FILE* f = fopen(filename, "w");
+	if (f == NULL) {
+		printf("Unable to write %s (%s)\n", filename, strerror(errno));
+	}
+	return f;
+}
+
+
+static void BenchClose(FILE* f) {
+	if (f != stdout) {
+		fclose(f);
+	}
+}
+
+
+int BenchWriteCSV(const char* filename) {
+	FILE* f = BenchOpen(filename);
+
+	if (f == NULL) {
+		return -1;
+	}
+	fprintf(f, "name,samples,batch,min_ns,median_ns,p99_ns,max_ns,mean_ns\n");
+	for (int i = 0; i < benchResults->count; i++) {
+		struct BenchResult* r = &benchResults->result[i];
+		fprintf(f, "%s,%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f\n", r->name, r->samples, r->batch, r->min, r->median, r->p99, r->max, r->mean);
+	}
+	BenchClose(f);
+	return 0;
+}
+
+
+int BenchWriteJSON(const char* filename, const char* model) {
+	FILE* f = BenchOpen(filename);
+
+	if (f == NULL) {
+		return -1;
+	}
+	fprintf(f, "{\n  \"model\": \"%s\",\n  \"results\": [\n", model);
+	for (int i = 0; i < benchResults->count; i++) {
+		struct BenchResult* r = &benchResults->result[i];
+		fprintf(f, "    { \"name\": \"%s\", \"samples\": %d, \"batch\": %d, \"min_ns\": %.2f, \"median_ns\": %.2f, \"p99_ns\": %.2f, \"max_ns\": %.2f, \"mean_ns\": %.2f }%s\n",
+		  r->name, r->samples, r->batch, r->min, r->median, r->p99, r->max, r->mean, i+1 < benchResults->count ? "," : "");
+	}
+	fprintf(f, "  ]\n}\n");
+	BenchClose(f);
+	return 0;
+}
+
+
+// Compare the medians with a CSV file written by BenchWriteCSV,
+// slower by more than tolerance (percent) fails.
+int BenchCompareBaseline(const char* filename, double tolerance) {
+	char line[256], name[BENCH_NAME_LEN];
+	double median;
+	int compared = 0, regressions = 0;
+	FILE* f = fopen(filename, "r");
+
+	if (f == NULL) {
+		printf("Unable to read baseline %s (%s)\n", filename, strerror(errno));
+		globalError = 1;
+		return -1;
+	}
+	printf("\nComparison with baseline %s (median, tolerance %.1f%%):\n", filename, tolerance);
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%47[^,],%*d,%*d,%*f,%lf", name, &median) != 2) {
+			continue;  // header
+		}
+		struct BenchResult* r = BenchFind(name);
+		if (r == NULL) {
+			printf("  %-36s %10.1f ns -> not measured\n", name, median);
+			continue;
+		}
+		double diff = (median > 0.0) ? (r->median - median)*100.0/median : 0.0;
+		int regression = diff > tolerance;
+		printf("  %-36s %10.1f -> %10.1f ns %+7.1f%%  -> %s%s%s\n", name, median, r->median, diff,
+		  regression ? COLORRED : COLORGRN, regression ? "slower" : (diff < -tolerance ? "faster" : "same"), COLORDEF);
+		regressions += regression;
+		compared++;
+	}
+	fclose(f);
+	if (regressions) {
+		globalError = 1;
+	}
+	printf("  %d operations compared, %d regressions\n", compared, regressions);
+	return regressions;
+}
@@ -56,6 +56,7 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <ctype.h>
 #include <poll.h>
 #include <unistd.h>
@@ -69,11 +70,16 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <asm/ioctl.h>
 #include <byteswap.h>
 #include <sys/utsname.h>
 #include <linux/gpio.h>
 #include <dirent.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
 
 #include "softPwm.h"
 #include "softTone.h"
@@ -81,12 +87,17 @@
 #include "wiringPi.h"
 #include "../version.h"
 #include "wiringPiLegacy.h"
+#include "wiringPiRegmap.h"
 
 // Environment Variables
 
 #define	ENV_DEBUG	"WIRINGPI_DEBUG"
 #define	ENV_CODES	"WIRINGPI_CODES"
+#define	ENV_SIM		"WIRINGPI_SIM"
+#define	ENV_SIM_FILE	"WIRINGPI_SIM_FILE"
+#define	ENV_SIM_LOG	"WIRINGPI_SIM_LOG"
 #define	ENV_GPIOMEM	"WIRINGPI_GPIOMEM"
+#define	ENV_KERNELTIME	"WIRINGPI_KERNELTIME"
 
 
 // Extend wiringPi with other pin-based devices and keep track of
@@ -94,6 +105,16 @@
 
 struct wiringPiNodeStruct *wiringPiNodes = NULL ;
 
+// ... and index them in a page table keyed by pin number, so finding the
+//	node of a pin doesn't depend on the number of nodes.
+
+#define	NODE_PAGE_BITS	8
+#define	NODE_PAGE_SIZE	(1 << NODE_PAGE_BITS)
+#define	NODE_PAGE_MASK	(NODE_PAGE_SIZE - 1)
+
+static struct wiringPiNodeStruct ***nodePages = NULL ;
+static int                          nodePageCount = 0 ;
+
 // BCM Magic
 
 #define	BCM_PASSWORD		0x5A000000
@@ -253,6 +274,16 @@ static volatile unsigned int GPIO_RIO ;
 static unsigned int usingGpioMem    = FALSE ;
 static          int wiringPiSetuped = FALSE ;
 
+// Simulation:
+//	Revision code of the simulated Pi, 0 for real hardware.
+//	See wiringPiSimSetup
+
+static unsigned int simRevision  = 0 ;
+static char        *simImageFile = NULL ;
+
+static void simCheckEnv (void) ;
+static void simUpdate   (void) ;
+
 // PWM
 //	Word offsets into the PWM control region
 
@@ -435,11 +466,30 @@ const int piMemorySize [8] =
 
 static uint64_t epochMilli, epochMicro ;
 
+// Fast time source: the architectural counter (CNTVCT_EL0 on aarch64, the
+//	invariant TSC on x86_64), calibrated against CLOCK_MONOTONIC_RAW in
+//	initialiseEpoch and scaled with multiply and shift instead of a divide.
+//	Not available on 32 bit, the kernel clock is used there.
+
+#if defined(__aarch64__) || defined(__x86_64__)
+#define	TICKS_COUNTER
+#endif
+
+// Each unit has its own shift, 1000 times coarser units get 10 more bits,
+//	so the multipliers of ms and us are as precise as the one of ns
+
+#define	TICKS_SHIFT_NS		32
+#define	TICKS_SHIFT_US		42
+#define	TICKS_SHIFT_MS		52
+#define	TICKS_CALIBRATE_NS	10000000
+
+static int      ticksFast = FALSE ;
+static uint64_t ticksFreq, epochTicks ;
+static uint64_t ticksMultNs, ticksMultUs, ticksMultMs ;
+
 // Misc
 
 static int wiringPiMode = WPI_MODE_UNINITIALISED ;
-static volatile int    pinPass = -1 ;
-static pthread_mutex_t pinMutex ;
 
 static int RaspberryPiModel  = -1;
 static int RaspberryPiLayout = -1;
@@ -453,15 +503,27 @@ int wiringPiReturnCodes = FALSE ;
 
 int wiringPiTryGpioMem  = FALSE ;
 
-static unsigned int lineFlags [64] =
-{
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-} ;
+// gpiochip device, GPIO character device v2 ABI:
+//	Lines set up together (digitalWriteMask) share one line request, so
+//	they are set or read with one ioctl, a line set up on its own gets a
+//	request of its own. A request once made is never closed and reopened
+//	to add lines, the lines it holds keep driving. A released line stays
+//	in its request as input until all lines of the request are released.
+//	Interrupt lines have a request of their own (isrFds).
+//	Masks are indexed by the BCM_GPIO pin.
+
+static uint64_t lineFlags [64] ;			// GPIO_V2_LINE_FLAG_*, kept while not requested
+static int      lineReq   [64] = { [0 ... 63] = -1 } ;	// Request holding the line
+static int      lineIndex [64] = { [0 ... 63] = -1 } ;	// Bit of the line in its request
+static int      lineReqFds   [64] = { [0 ... 63] = -1 } ;
+static uint64_t lineReqLines [64] ;			// Lines held by a request
+static uint64_t lineRequested  = 0 ;			// Lines in use
+static uint64_t lineValues     = 0 ;			// Output values
+
+#define	LINE_FLAGS_DIRECTION	(GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_OUTPUT)
+#define	LINE_FLAGS_BIAS		(GPIO_V2_LINE_FLAG_BIAS_DISABLED | GPIO_V2_LINE_FLAG_BIAS_PULL_UP | GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN)
 
-static int lineFds [64] =
+static int isrFds [64] =
 {
   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
@@ -469,19 +531,63 @@ static int lineFds [64] =
   -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 } ;
 
-static int isrFds [64] =
+// Pin descriptors:
+//	Everything digitalRead/digitalWrite need for an on-board pin, resolved
+//	at setup time for the selected pin numbering, so the calls are a
+//	single indexed jump without any mode switch or pin translation.
+
+struct wpiPinDescStruct
 {
-  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-  -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+  volatile unsigned int *set ;	// Set register (RP1: RIO set alias)
+  volatile unsigned int *clr ;	// Clear register (RP1: RIO clear alias)
+  volatile unsigned int *lev ;	// Level register (RP1: GPIO status)
+  unsigned int mask ;		// Bit in set/clr/lev
+  int          gpio ;		// BCM_GPIO pin, -1 if not connected
+
+  int  (*read)  (const struct wpiPinDescStruct *desc) ;
+  void (*write) (const struct wpiPinDescStruct *desc, int value) ;
+} ;
+
+static          int digitalReadNoMode  (UNU const struct wpiPinDescStruct *desc) ;
+static         void digitalWriteNoMode (UNU const struct wpiPinDescStruct *desc, UNU int value) ;
+
+static struct wpiPinDescStruct pinDesc [64] =
+{
+  [0 ... 63] = { NULL, NULL, NULL, 0, -1, digitalReadNoMode, digitalWriteNoMode }
+} ;
+
+// Edge capture ring:
+//	Single producer (the interrupt dispatcher) / single consumer ring of
+//	edge events. head is only written by the producer, tail only by the
+//	consumer, so neither side takes a lock.
+
+struct wpiEdgeRingStruct
+{
+  struct WPIEdgeEvent *events ;
+  unsigned int size ;		// Power of 2
+  unsigned int head ;		// Next entry to write
+  unsigned int tail ;		// Next entry to read
+  unsigned int overflow ;	// Edges lost, ring full or kernel buffer overrun
+  unsigned int lastSeqno ;	// Kernel line_seqno of the last edge
+  int          eventFd ;	// Signalled after every batch
+  int          users ;		// isrRings entry plus running wiringPiEdgeRead, under isrMutex
 } ;
 
 // ISR Data
 static int chipFd = -1;
 static void (*isrFunctions [64])(void) ;
-static pthread_t isrThreads[64];
+static void (*isrFunctions2 [64])(struct WPIWfiStatus wfiStatus, void *userdata) ;
+static void *isrUserdata [64] ;
 static int isrMode[64];
+static unsigned long isrDebounce [64] ;		// Debounce period in us, see wiringPiSetDebounce
+static uint64_t isrSoftDebounce [64] ;		// Software filter in ns if the kernel has none
+static uint64_t isrLastEdge [64] ;		// Timestamp of the last edge passing the filter
+static struct wpiEdgeRingStruct *isrRings [64] ;	// Edge capture, see wiringPiEdgeCapture
+static int isrEpollFd = -1 ;			// All line event fds, served by isrThread
+static pthread_t isrThread ;
+static pthread_mutex_t isrMutex = PTHREAD_MUTEX_INITIALIZER ;
+static pthread_cond_t  isrIdle  = PTHREAD_COND_INITIALIZER ;	// Signalled when isrBusy is cleared
+static int isrBusy = -1 ;			// Pin whose function the dispatcher is calling
 
 // Doing it the Arduino way with lookup tables...
 //	Yes, it's probably more innefficient than all the bit-twidling, but it
@@ -1012,6 +1118,13 @@ const char* GetPiRevision(char* line, int linelength, unsigned int* revision) {
   uint32_t Revision = 0;
   _Static_assert(sizeof(Revision)==4, "should be unsigend integer with 4 byte size");
 
+  simCheckEnv();
+  if (simRevision) {
+    snprintf(line, linelength, "Revision\t: %04x", simRevision);
+    *revision = simRevision;
+    return &line[11];
+  }
+
 	FILE* fp = fopen(revfile,"rb");
 	if (!fp) {
     if (wiringPiDebug)
@@ -1604,15 +1717,50 @@ void gpioClockSet (int pin, int freq)
 
 struct wiringPiNodeStruct *wiringPiFindNode (int pin)
 {
-  struct wiringPiNodeStruct *node = wiringPiNodes ;
+  struct wiringPiNodeStruct **page ;
 
-  while (node != NULL)
-    if ((pin >= node->pinBase) && (pin <= node->pinMax))
-      return node ;
-    else
-      node = node->next ;
+  if ((pin < 0) || ((pin >> NODE_PAGE_BITS) >= nodePageCount))
+    return NULL ;
 
-  return NULL ;
+  page = nodePages [pin >> NODE_PAGE_BITS] ;
+
+  return (page == NULL) ? NULL : page [pin & NODE_PAGE_MASK] ;
+}
+
+
+/*
+ * nodeIndexAdd:
+ *	Enter all pins of a node into the page table
+ *********************************************************************************
+ */
+
+static void nodeIndexAdd (struct wiringPiNodeStruct *node)
+{
+  int pin, index ;
+  int pages = (node->pinMax >> NODE_PAGE_BITS) + 1 ;
+
+  if (pages > nodePageCount)
+  {
+    struct wiringPiNodeStruct ***newPages = realloc (nodePages, pages * sizeof (*nodePages)) ;
+    if (newPages == NULL)
+      (void)wiringPiFailure (WPI_FATAL, "wiringPiNewNode: Unable to allocate memory: %s\n", strerror (errno)) ;
+    for (index = nodePageCount ; index < pages ; ++index)
+      newPages [index] = NULL ;
+    nodePages     = newPages ;
+    nodePageCount = pages ;
+  }
+
+  for (pin = node->pinBase ; pin <= node->pinMax ; ++pin)
+  {
+    index = pin >> NODE_PAGE_BITS ;
+    if (nodePages [index] == NULL)
+    {
+      nodePages [index] = (struct wiringPiNodeStruct **)calloc (NODE_PAGE_SIZE, sizeof (struct wiringPiNodeStruct *)) ;
+      if (nodePages [index] == NULL)
+        (void)wiringPiFailure (WPI_FATAL, "wiringPiNewNode: Unable to allocate memory: %s\n", strerror (errno)) ;
+    }
+    nodePages [index][pin & NODE_PAGE_MASK] = node ;
+  }
 }
 
 
@@ -1624,8 +1772,6 @@ struct wiringPiNodeStruct *wiringPiFindNode (int pin)
 
 static         void pinModeDummy             (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int mode)  { return ; }
 static         void pullUpDnControlDummy     (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int pud)   { return ; }
-//static unsigned int digitalRead8Dummy        (UNU struct wiringPiNodeStruct *node, UNU int UNU pin)            { return 0 ; }
-//static         void digitalWrite8Dummy       (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
 static          int digitalReadDummy         (UNU struct wiringPiNodeStruct *node, UNU int UNU pin)            { return LOW ; }
 static         void digitalWriteDummy        (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
 static         void pwmWriteDummy            (UNU struct wiringPiNodeStruct *node, UNU int pin, UNU int value) { return ; }
@@ -1642,6 +1788,9 @@ struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
   if (pinBase < 64)
     (void)wiringPiFailure (WPI_FATAL, "wiringPiNewNode: pinBase of %d is < 64\n", pinBase) ;
 
+  if ((numPins < 0) || (numPins > (INT_MAX - pinBase)))
+    (void)wiringPiFailure (WPI_FATAL, "wiringPiNewNode: Invalid number of pins %d\n", numPins) ;
+
 // Check all pins in-case there is overlap:
 
   for (pin = pinBase ; pin < (pinBase + numPins) ; ++pin)
@@ -1657,19 +1806,88 @@ struct wiringPiNodeStruct *wiringPiNewNode (int pinBase, int numPins)
   node->pinMode          = pinModeDummy ;
   node->pullUpDnControl  = pullUpDnControlDummy ;
   node->digitalRead      = digitalReadDummy ;
-//node->digitalRead8     = digitalRead8Dummy ;
   node->digitalWrite     = digitalWriteDummy ;
-//node->digitalWrite8    = digitalWrite8Dummy ;
   node->pwmWrite         = pwmWriteDummy ;
   node->analogRead       = analogReadDummy ;
   node->analogWrite      = analogWriteDummy ;
   node->next             = wiringPiNodes ;
   wiringPiNodes          = node ;
 
+  nodeIndexAdd (node) ;
+
   return node ;
 }
 
 
+/*
+ * wiringPiNodeBegin: wiringPiNodeCommit:
+ *	Write combining for the device nodes. After begin the output writes
+ *	only change the shadow registers of the nodes (with a register cache
+ *	modes and pull-ups as well), commit writes each changed node once,
+ *	e.g. both MCP23017 ports in one I2C transaction. Calls nest, the outer
+ *	commit writes. On-board pins are not delayed.
+ *	A node can drive the pins of another one (a 74x595 on MCP23017 pins),
+ *	so all nodes leave the batch before the first one is written, and
+ *	the flush functions run oldest node first.
+ *********************************************************************************
+ */
+
+static pthread_mutex_t nodeBatchLock = PTHREAD_MUTEX_INITIALIZER ;
+static int             nodeBatchDepth = 0 ;
+
+void wiringPiNodeBegin (void)
+{
+  struct wiringPiNodeStruct *node ;
+
+  pthread_mutex_lock (&nodeBatchLock) ;
+  if (nodeBatchDepth++ == 0)
+    for (node = wiringPiNodes ; node != NULL ; node = node->next)
+    {
+      node->batch = TRUE ;
+      if (node->regmap != NULL)
+        wiringPiRegmapDefer (node->regmap, TRUE) ;
+    }
+  pthread_mutex_unlock (&nodeBatchLock) ;
+}
+
+static int nodeFlush (struct wiringPiNodeStruct *node)	// the list is newest first
+{
+  int ret, err ;
+
+  if (node == NULL)
+    return 0 ;
+  ret = nodeFlush (node->next) ;
+  if ((node->regmap == NULL) && (node->flush != NULL) && (node->dirty != 0))
+    if ((err = node->flush (node)) < 0)
+      ret = err ;
+  return ret ;
+}
+
+int wiringPiNodeCommit (void)
+{
+  struct wiringPiNodeStruct *node ;
+  int ret = 0, err ;
+
+  pthread_mutex_lock (&nodeBatchLock) ;
+  if ((nodeBatchDepth > 0) && (--nodeBatchDepth == 0))
+  {
+    for (node = wiringPiNodes ; node != NULL ; node = node->next)
+    {
+      if (!node->batch)
+        continue ;
+      node->batch = FALSE ;
+      if ((node->regmap != NULL) && ((err = wiringPiRegmapDefer (node->regmap, FALSE)) < 0))
+        ret = err ;
+    }
+    if ((err = nodeFlush (wiringPiNodes)) < 0)
+      ret = err ;
+  }
+  pthread_mutex_unlock (&nodeBatchLock) ;
+
+  return ret ;
+}
+
+
 #ifdef notYetReady
 /*
  * pinED01:
@@ -1746,179 +1964,735 @@ int wiringPiGpioDeviceGetFd() {
   return chipFd;
 }
 
-void releaseLine(int pin) {
+/*
+ * lineMaskToRequest:
+ * lineMaskFromRequest:
+ *	Translate a BCM_GPIO mask into the bits of a line request and back.
+ *********************************************************************************
+ */
 
-  if (wiringPiDebug)
-    printf ("releaseLine: pin:%d\n", pin) ;
-  lineFlags[pin] = 0;
-  close(lineFds[pin]);
-  lineFds[pin] = -1;
+static uint64_t lineMaskToRequest (int r, uint64_t mask)
+{
+  uint64_t bits = 0 ;
+
+  mask &= lineReqLines [r] ;
+  while (mask) {
+    bits |= 1ULL << lineIndex [__builtin_ctzll (mask)] ;
+    mask &= mask - 1 ;
+  }
+  return bits ;
+}
+
+static uint64_t lineMaskFromRequest (int r, uint64_t bits, uint64_t mask)
+{
+  uint64_t result = 0 ;
+
+  mask &= lineReqLines [r] ;
+  while (mask) {
+    int pin = __builtin_ctzll (mask) ;
+    if (bits & (1ULL << lineIndex [pin]))
+      result |= 1ULL << pin ;
+    mask &= mask - 1 ;
+  }
+  return result ;
 }
 
-int requestLine(int pin, unsigned int lineRequestFlags) {
-  struct gpiohandle_request rq;
 
-   if (lineFds[pin]>=0) {
-    if (lineRequestFlags == lineFlags[pin]) {
-      //already requested
-      return lineFds[pin];
-    } else {
-      //different request -> rerequest
-      releaseLine(pin);
+/*
+ * lineConfigFlags:
+ *	Flags of a line in its request, a released line is held as input.
+ *********************************************************************************
+ */
+
+static uint64_t lineConfigFlags (int pin)
+{
+  if (lineRequested & (1ULL << pin))
+    return lineFlags [pin] ;
+  return (lineFlags [pin] & ~LINE_FLAGS_DIRECTION) | GPIO_V2_LINE_FLAG_INPUT ;
+}
+
+
+/*
+ * lineConfigBuild:
+ *	Line configuration of a request: the flags of the first line are the
+ *	default, every other set of flags and the output values are attributes.
+ *	Returns -1 if there are more sets of flags than attributes.
+ *********************************************************************************
+ */
+
+static int lineConfigBuild (int r, struct gpio_v2_line_config *config)
+{
+  uint64_t todo = lineReqLines [r] ;
+  uint64_t outputs = 0 ;
+  unsigned int attr = 0, maxAttr = GPIO_V2_LINE_NUM_ATTRS_MAX ;
+  int pin ;
+
+  ZeroMemory(config, sizeof(*config));
+  if (todo == 0)
+    return 0 ;
+
+  for (pin = 0 ; pin < 64 ; ++pin) {
+    if ((todo & lineRequested & (1ULL << pin)) && (lineFlags [pin] & GPIO_V2_LINE_FLAG_OUTPUT))
+      outputs |= 1ULL << pin ;
+  }
+  if (outputs)
+    --maxAttr ;
+
+  config->flags = lineConfigFlags (__builtin_ctzll (todo)) ;
+  while (todo) {
+    uint64_t flags = lineConfigFlags (__builtin_ctzll (todo)) ;
+    uint64_t same  = 0 ;
+    for (pin = 0 ; pin < 64 ; ++pin) {
+      if ((todo & (1ULL << pin)) && lineConfigFlags (pin) == flags)
+        same |= 1ULL << pin ;
     }
+    todo &= ~same ;
+    if (flags == config->flags)
+      continue ;
+    if (attr >= maxAttr)
+      return -1 ;
+    config->attrs [attr].attr.id    = GPIO_V2_LINE_ATTR_ID_FLAGS ;
+    config->attrs [attr].attr.flags = flags ;
+    config->attrs [attr].mask       = lineMaskToRequest (r, same) ;
+    ++attr ;
+  }
+  if (outputs) {
+    config->attrs [attr].attr.id     = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES ;
+    config->attrs [attr].attr.values = lineMaskToRequest (r, lineValues & outputs) ;
+    config->attrs [attr].mask        = lineMaskToRequest (r, outputs) ;
+    ++attr ;
+  }
+  config->num_attrs = attr ;
+  return 0 ;
+}
+
+
+/*
+ * lineRequestClose:
+ *	Close a request, its lines go back to the kernel.
+ *********************************************************************************
+ */
+
+static void lineRequestClose (int r)
+{
+  uint64_t lines = lineReqLines [r] ;
+
+  if (lineReqFds [r] >= 0)
+    close (lineReqFds [r]) ;
+  lineReqFds   [r] = -1 ;
+  lineReqLines [r] = 0 ;
+  lineRequested &= ~lines ;
+  while (lines) {
+    int pin = __builtin_ctzll (lines) ;
+    lineReq   [pin] = -1 ;
+    lineIndex [pin] = -1 ;
+    lines &= lines - 1 ;
   }
+}
+
+
+/*
+ * lineRequestNew:
+ *	Request lines not held so far with a request of their own, the
+ *	requests already made are not touched.
+ *********************************************************************************
+ */
+
+static int lineRequestNew (uint64_t lines)
+{
+  struct gpio_v2_line_request req ;
+  unsigned int num = 0 ;
+  int pin, r, ret ;
 
-  //requested line
   if (wiringPiGpioDeviceGetFd()<0) {
+    lineRequested &= ~lines ;
     return -1;  // error
   }
-  rq.lineoffsets[0] = pin;
-  rq.lines = 1;
-  rq.flags = lineRequestFlags;
-  int ret = ioctl(chipFd, GPIO_GET_LINEHANDLE_IOCTL, &rq);
-  if (ret || rq.fd<0) {
-    ReportDeviceError("get line handle", pin, "RequestLine", ret);
+
+  // the requests hold disjoint lines, so there is a free one
+  for (r = 0 ; lineReqLines [r] != 0 ; ++r)
+    ;
+
+  ZeroMemory(&req, sizeof(req));
+  for (pin = 0 ; pin < 64 ; ++pin) {
+    if (lines & (1ULL << pin)) {
+      req.offsets [num] = pin ;
+      lineReq   [pin] = r ;
+      lineIndex [pin] = num++ ;
+    }
+  }
+  lineReqLines [r] = lines ;
+  lineRequested   |= lines ;
+
+  if (lineConfigBuild (r, &req.config) < 0) {
+    // more sets of flags than attributes: one request per line
+    lineRequestClose (r) ;
+    ret = 0 ;
+    for (pin = 0 ; pin < 64 ; ++pin) {
+      if ((lines & (1ULL << pin)) && lineRequestNew (1ULL << pin) < 0)
+        ret = -1 ;
+    }
+    return ret ;
+  }
+  strncpy(req.consumer, "wiringpi_gpio", sizeof(req.consumer) - 1);
+  req.num_lines = num ;
+  ret = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+  if (ret || req.fd<0) {
+    ReportDeviceError("get line", __builtin_ctzll (lines), "lineRequest", ret);
+    lineRequestClose (r) ;
     return -1;  // error
   }
-
-  lineFlags[pin] = lineRequestFlags;
-  lineFds[pin] = rq.fd;
+  lineReqFds [r] = req.fd ;
   if (wiringPiDebug)
-    printf ("requestLine succeeded: pin:%d, flags: %u, fd :%d\n", pin, lineRequestFlags, lineFds[pin]) ;
-  return lineFds[pin];
+    printf ("lineRequestNew succeeded: lines: 0x%016llX, fd: %d\n", (unsigned long long)lines, req.fd) ;
+  return 0 ;
 }
 
-/*
- *********************************************************************************
- * Core Functions
- *********************************************************************************
- */
 
 /*
- * pinModeAlt:
- *	This is an un-documented special to let you set any pin to any mode
+ * lineRequestConfig:
+ *	Reconfigure a request in place.
  *********************************************************************************
  */
 
-void pinModeAlt (int pin, int mode)
+static int lineRequestConfig (int r)
 {
-  setupCheck ("pinModeAlt") ;
+  struct gpio_v2_line_config config ;
+  int pin = __builtin_ctzll (lineReqLines [r]) ;
 
-  if ((pin & PI_GPIO_MASK) == 0)		// On-board pin
-  {
-    /**/ if (wiringPiMode == WPI_MODE_PINS)
-      pin = pinToGpio [pin] ;
-    else if (wiringPiMode == WPI_MODE_PHYS)
-      pin = physToGpio [pin] ;
-    else if (wiringPiMode != WPI_MODE_GPIO)
-      return ;
+  if (lineConfigBuild (r, &config) < 0) {
+    fprintf (stderr, "wiringPi: GPIO %d: too many different line settings in one line request\n", pin) ;
+    return -1 ;
+  }
+  int ret = ioctl(lineReqFds [r], GPIO_V2_LINE_SET_CONFIG_IOCTL, &config);
+  if (ret) {
+    ReportDeviceError("set config", pin, "lineRequestConfig", ret);
+    return -1;
+  }
+  return 0 ;
+}
 
-    if (piRP1Model()) {
-      //confusion! diffrent to to BCM!  this is taking directly the value for the register
-      int modeRP1;
-      switch(mode) {
-        case FSEL_ALT0:
-          modeRP1 = 0;
-          break;
-        case FSEL_ALT1:
-          modeRP1 = 1;
-          break;
-        case FSEL_ALT2:
-          modeRP1 = 2;
-          break;
-        case FSEL_ALT3:
-          modeRP1 = 3;
-          break;
-        case FSEL_ALT4:
-          modeRP1 = 4;
-          break;
-        case FSEL_ALT5:
-          modeRP1 = 5;
-          break;
-        case FSEL_ALT6:
-          modeRP1 = 6;
-          break;
-        case FSEL_ALT7:
-          modeRP1 = 7;
-          break;
-        case FSEL_ALT8:
-          modeRP1 = 8;
-          break;
-        case FSEL_OUTP:
-        case FSEL_INPT:
-          modeRP1 = RP1_FSEL_GPIO;
-          break;
-        default:
-          fprintf(stderr, "pinModeAlt: invalid mode %d\n", mode);
-          return;
-      }
-      //printf("pinModeAlt: Pi5 alt pin %d to %d\n", pin, modeRP1);
-      gpio[2*pin+1] = (modeRP1 & RP1_FSEL_NONE_HW) | RP1_DEBOUNCE_DEFAULT; //0-4  function, 5-11 debounce time
-    } else {
-      int fSel  = gpioToGPFSEL [pin] ;
-      int shift = gpioToShift  [pin] ;
 
-      *(gpio + fSel) = (*(gpio + fSel) & ~(7 << shift)) | ((mode & 0x7) << shift) ;
+/*
+ * lineSetFlags:
+ *	Change the flags of some lines, lines not held so far get a new
+ *	request, the requests of the others are reconfigured in place.
+ *********************************************************************************
+ */
+
+static int lineSetFlags (uint64_t lines, uint64_t clearFlags, uint64_t setFlags)
+{
+  uint64_t added = 0, changed = 0 ;
+  int pin, r, ret = 0 ;
+
+  for (pin = 0 ; pin < 64 ; ++pin) {
+    if (lines & (1ULL << pin)) {
+      uint64_t flags = (lineFlags [pin] & ~clearFlags) | setFlags ;
+      if (lineReq [pin] < 0)
+        added |= 1ULL << pin ;
+      else if ((flags != lineFlags [pin]) || (lineRequested & (1ULL << pin)) == 0)
+        changed |= 1ULL << pin ;
+      lineFlags [pin] = flags ;
     }
+  }
+  lineRequested |= lines & ~added ;
 
+  for (r = 0 ; changed != 0 ; ++r) {
+    if (changed & lineReqLines [r]) {
+      changed &= ~lineReqLines [r] ;
+      if (lineRequestConfig (r) < 0)
+        ret = -1 ;
+    }
   }
+  if (added && lineRequestNew (added) < 0)
+    ret = -1 ;
+  return ret ;
 }
 
 
 /*
- * pinMode:
- *	Sets the mode of a pin to be input, output or PWM output
+ * lineRelease:
+ *	Give a line back to the kernel. While other lines of its request are
+ *	in use the line stays held as input, -1 is returned then.
  *********************************************************************************
  */
 
-//Default: rp1_set_pad(pin, 0, 1, 0, 1, 1, 1, 0);
-void rp1_set_pad(int pin, int slewfast, int schmitt, int pulldown, int pullup, int drive, int inputenable, int outputdisable) {
-
-  pads[1+pin] = (slewfast != 0) | ((schmitt != 0) << 1) | ((pulldown != 0) << 2) | ((pullup != 0) << 3) | ((drive & 0x3) << 4) | ((inputenable != 0) << 6) | ((outputdisable != 0) << 7);
-}
+static int lineRelease (int pin)
+{
+  int r = lineReq [pin] ;
 
-void pinModeFlagsDevice (int pin, int mode, unsigned int flags) {
-  unsigned int lflag = flags;
   if (wiringPiDebug)
-      printf ("pinModeFlagsDevice: pin:%d mode:%d, flags: %u\n", pin, mode, flags) ;
+    printf ("lineRelease: pin:%d\n", pin) ;
 
-  lflag &= ~(GPIOHANDLE_REQUEST_INPUT | GPIOHANDLE_REQUEST_OUTPUT);
-  switch(mode) {
-    default:
-      fprintf(stderr, "pinMode: invalid mode request (only input und output supported)\n");
-      return;
-    case INPUT:
-      lflag |= GPIOHANDLE_REQUEST_INPUT;
-      break;
-    case OUTPUT:
-      lflag |= GPIOHANDLE_REQUEST_OUTPUT;
-      break;
-    case PM_OFF:
-      pinModeFlagsDevice(pin, INPUT, 0);
-      releaseLine(pin);
-      return;
+  if (r < 0)
+    return 0 ;
+  if ((lineReqLines [r] & lineRequested & ~(1ULL << pin)) == 0) {
+    lineRequestClose (r) ;
+    return 0 ;
   }
-
-  requestLine(pin, lflag);
+  if (lineRequested & (1ULL << pin)) {
+    lineRequested &= ~(1ULL << pin) ;
+    lineRequestConfig (r) ;
+  }
+  return -1 ;
 }
 
-void pinModeDevice (int pin, int mode) {
-  pinModeFlagsDevice(pin, mode, lineFlags[pin]);
-}
+/*
+ * Simulation:
+ *	The registers live in an anonymous or file-backed memory image with
+ *	the layout of the real peripherals (gpio, pwm, clk, pads, timer and
+ *	on RP1 rio), so wiringPi runs the same code paths without a Pi.
+ *	Plain registers behave like memory, the write-1-to-set/clear
+ *	registers are folded into the output latch and the level registers
+ *	by simUpdate after every function that writes them.
+ *********************************************************************************
+ */
 
-void pinMode (int pin, int mode)
+#define	SIM_REVISION_DEFAULT	0x00C03111	// Pi 4B 4GB
+#define	SIM_BCM_IMAGE_SIZE	0x0020D000	// Peripherals up to the end of the PWM block
+
+static pthread_mutex_t     simMutex = PTHREAD_MUTEX_INITIALIZER ;
+static unsigned int        simLatch [2] ;	// BCM output latch, RP1 uses RIO_OUT
+static unsigned int        simInput [2] ;	// Level of the pins not driven by us
+static struct WPISimWrite *simLog ;
+static int                 simLogSize, simLogHead, simLogCount ;
+
+static void simCheckEnv (void)
 {
-  int    fSel, shift, alt ;
-  struct wiringPiNodeStruct *node = wiringPiNodes ;
-  int origPin = pin ;
+  static int checked = FALSE ;
+  const char *env ;
 
-  if (wiringPiDebug)
-    printf ("pinMode: pin:%d mode:%d\n", pin, mode) ;
+  if (checked)
+    return ;
+  checked = TRUE ;
 
-  setupCheck ("pinMode") ;
+  if (simRevision == 0 && (env = getenv (ENV_SIM)) != NULL) {
+    const char *log = getenv (ENV_SIM_LOG) ;
+    wiringPiSimSetup ((unsigned int)strtoul (env, NULL, 16), getenv (ENV_SIM_FILE), log ? atoi (log) : 0) ;
+  }
+}
+
+static int simImageOpen (void)
+{
+  off_t size = ISRP1MODEL ? pciemem_RP1_Size : SIM_BCM_IMAGE_SIZE ;
+  struct stat st ;
+  int fd ;
+
+  if (simImageFile)
+    fd = open (simImageFile, O_RDWR | O_CREAT | O_CLOEXEC, 0644) ;
+  else
+    fd = memfd_create ("wiringPi-sim", MFD_CLOEXEC) ;
+  if (fd < 0)
+    return -1 ;
+
+  if (fstat (fd, &st) < 0 || (st.st_size < size && ftruncate (fd, size) < 0)) {
+    close (fd) ;
+    return -1 ;
+  }
+  return fd ;
+}
+
+static void simLogWrite (unsigned int bank, unsigned int level, unsigned int changed)
+{
+  struct WPISimWrite *entry ;
+  struct timespec ts ;
+
+  if (simLogSize == 0)
+    return ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  entry = &simLog [(simLogHead + simLogCount) % simLogSize] ;
+  if (simLogCount < simLogSize)
+    ++simLogCount ;
+  else
+    simLogHead = (simLogHead + 1) % simLogSize ;	// full, drop the oldest
+
+  entry->timeStamp_ns = (long long int)ts.tv_sec * 1000000000LL + ts.tv_nsec ;
+  entry->bank         = bank ;
+  entry->level        = level ;
+  entry->changed      = changed ;
+}
+
+static void simUpdate (void)
+{
+  unsigned int out, old, oe, level ;
+  int bank, pin ;
+
+  if (gpio == NULL)
+    return ;
+
+  pthread_mutex_lock (&simMutex) ;
+  if (ISRP1MODEL) {
+    old = rio [RP1_RIO_OUT] ;
+    out = (old & ~rio [RP1_RIO_OUT + RP1_CLR_OFFSET]) | rio [RP1_RIO_OUT + RP1_SET_OFFSET] ;
+    oe  = (rio [RP1_RIO_OE] & ~rio [RP1_RIO_OE + RP1_CLR_OFFSET]) | rio [RP1_RIO_OE + RP1_SET_OFFSET] ;
+    rio [RP1_RIO_OUT + RP1_CLR_OFFSET] = rio [RP1_RIO_OUT + RP1_SET_OFFSET] = 0 ;
+    rio [RP1_RIO_OE  + RP1_CLR_OFFSET] = rio [RP1_RIO_OE  + RP1_SET_OFFSET] = 0 ;
+    rio [RP1_RIO_OUT] = out ;
+    rio [RP1_RIO_OE]  = oe ;
+    if (out != old)
+      simLogWrite (0, out, out ^ old) ;
+
+    level = (out & oe) | (simInput [0] & ~oe) ;
+    rio [RP1_RIO_IN] = level ;
+    for (pin = 0 ; pin < 28 ; ++pin)
+      gpio [2*pin] = (gpio [2*pin] & ~RP1_STATUS_LEVEL_MASK) | ((level & (1u << pin)) ? RP1_STATUS_LEVEL_HIGH : RP1_STATUS_LEVEL_LOW) ;
+  } else {
+    unsigned int outputs [2] = { 0, 0 } ;
+
+    for (pin = 0 ; pin < 58 ; ++pin) {
+      if (((*(gpio + gpioToGPFSEL [pin]) >> gpioToShift [pin]) & 7) == 1)	// FSEL output
+        outputs [pin >> 5] |= 1u << (pin & 31) ;
+    }
+    for (bank = 0 ; bank < 2 ; ++bank) {
+      old = simLatch [bank] ;
+      out = (old & ~*(gpio + gpioToGPCLR [bank*32])) | *(gpio + gpioToGPSET [bank*32]) ;
+      *(gpio + gpioToGPCLR [bank*32]) = 0 ;
+      *(gpio + gpioToGPSET [bank*32]) = 0 ;
+      simLatch [bank] = out ;
+      if (out != old)
+        simLogWrite (bank, out, out ^ old) ;
+      *(gpio + gpioToGPLEV [bank*32]) = (out & outputs [bank]) | (simInput [bank] & ~outputs [bank]) ;
+    }
+  }
+  pthread_mutex_unlock (&simMutex) ;
+}
+
+
+/*
+ * wiringPiSimSetup:
+ *	Simulate a Pi with the given revision code (0: Pi 4B) instead of
+ *	using the hardware. Must be called before any wiringPiSetup function,
+ *	or set WIRINGPI_SIM=<revision code>, WIRINGPI_SIM_FILE=<image file>
+ *	and WIRINGPI_SIM_LOG=<log entries>.
+ *	imageFile: NULL for an anonymous image, else a file that is created
+ *	if needed, so another process can look at the registers.
+ *	logDepth: Number of output writes kept for wiringPiSimLog, 0 = off.
+ *********************************************************************************
+ */
+
+int wiringPiSimSetup (unsigned int revision, const char *imageFile, int logDepth)
+{
+  if (wiringPiSetuped || RaspberryPiModel >= 0)
+    return wiringPiFailure (WPI_ALMOST, "wiringPiSimSetup: must be called before wiringPiSetup\n") ;
+
+  simRevision  = revision ? revision : SIM_REVISION_DEFAULT ;
+  simImageFile = imageFile ? strdup (imageFile) : NULL ;
+  if (logDepth > 0 && (simLog = calloc (logDepth, sizeof (struct WPISimWrite))) != NULL)
+    simLogSize = logDepth ;
+
+  if (wiringPiDebug)
+    printf ("wiringPiSimSetup: revision %06X, image %s, log %d\n", simRevision, simImageFile ? simImageFile : "anonymous", simLogSize) ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiSimActive:
+ * wiringPiSimInput:
+ * wiringPiSimLog:
+ *	Is the simulation in use, drive a BCM_GPIO pin that is no output
+ *	from outside, take the oldest entries out of the write log.
+ *********************************************************************************
+ */
+
+int wiringPiSimActive (void)
+{
+  simCheckEnv () ;
+  return simRevision != 0 ;
+}
+
+void wiringPiSimInput (int bcmPin, int value)
+{
+  if (simRevision == 0 || bcmPin < 0 || bcmPin > 63)
+    return ;
+
+  pthread_mutex_lock (&simMutex) ;
+    if (value == LOW)
+      simInput [bcmPin >> 5] &= ~(1u << (bcmPin & 31)) ;
+    else
+      simInput [bcmPin >> 5] |=  (1u << (bcmPin & 31)) ;
+  pthread_mutex_unlock (&simMutex) ;
+  simUpdate () ;
+}
+
+int wiringPiSimLog (struct WPISimWrite *entries, int maxEntries)
+{
+  int count = 0 ;
+
+  pthread_mutex_lock (&simMutex) ;
+    while (count < maxEntries && simLogCount > 0) {
+      entries [count++] = simLog [simLogHead] ;
+      simLogHead = (simLogHead + 1) % simLogSize ;
+      --simLogCount ;
+    }
+  pthread_mutex_unlock (&simMutex) ;
+  return count ;
+}
+
+
+/*
+ * pinDesc backends:
+ *	The read and write functions a pin descriptor can point to.
+ *********************************************************************************
+ */
+
+int  digitalReadDevice  (int pin) ;
+void digitalWriteDevice (int pin, int value) ;
+
+static int digitalReadNoMode (UNU const struct wpiPinDescStruct *desc)
+{
+  fprintf(stderr, "digitalRead: invalid mode\n");
+  return LOW ;
+}
+
+static void digitalWriteNoMode (UNU const struct wpiPinDescStruct *desc, UNU int value)
+{
+  fprintf(stderr, "digitalWrite: invalid mode\n");
+}
+
+static          int digitalReadNoPin  (UNU const struct wpiPinDescStruct *desc)            { return LOW ; }
+static         void digitalWriteNoPin (UNU const struct wpiPinDescStruct *desc, UNU int value) { return ; }
+
+static int digitalReadBCM (const struct wpiPinDescStruct *desc)
+{
+  return ((*desc->lev & desc->mask) != 0) ? HIGH : LOW ;
+}
+
+static int digitalReadRP1 (const struct wpiPinDescStruct *desc)
+{
+  switch(*desc->lev & RP1_STATUS_LEVEL_MASK) {
+    default: // 11 or 00 not allowed, give LOW!
+    case RP1_STATUS_LEVEL_LOW:  return LOW ;
+    case RP1_STATUS_LEVEL_HIGH: return HIGH ;
+  }
+}
+
+static void digitalWriteMem (const struct wpiPinDescStruct *desc, int value)	// BCM and RP1
+{
+  if (value == LOW)
+    *desc->clr = desc->mask ;
+  else
+    *desc->set = desc->mask ;
+}
+
+static void digitalWriteSim (const struct wpiPinDescStruct *desc, int value)
+{
+  digitalWriteMem (desc, value) ;
+  simUpdate () ;
+}
+
+static int digitalReadDev (const struct wpiPinDescStruct *desc)
+{
+  return digitalReadDevice (desc->gpio) ;
+}
+
+static void digitalWriteDev (const struct wpiPinDescStruct *desc, int value)
+{
+  digitalWriteDevice (desc->gpio, value) ;
+}
+
+
+/*
+ * pinDescResolve:
+ *	(Re-)build the descriptor of one pin, or of all pins after the
+ *	pin numbering or access method changed.
+ *********************************************************************************
+ */
+
+static void pinDescResolve (int pin)
+{
+  struct wpiPinDescStruct *desc = &pinDesc [pin & 63] ;
+  int gpioPin = -1 ;
+
+  desc->set  = desc->clr = desc->lev = NULL ;
+  desc->mask = 0 ;
+
+  switch (wiringPiMode) {
+    default: //WPI_MODE_GPIO_SYS, WPI_MODE_UNINITIALISED
+      desc->gpio  = -1 ;
+      desc->read  = digitalReadNoMode ;
+      desc->write = digitalWriteNoMode ;
+      return ;
+    case WPI_MODE_PINS:
+    case WPI_MODE_GPIO_DEVICE_WPI:
+      gpioPin = pinToGpio [pin & 63] ;
+      break ;
+    case WPI_MODE_PHYS:
+    case WPI_MODE_GPIO_DEVICE_PHYS:
+      gpioPin = physToGpio [pin & 63] ;
+      break ;
+    case WPI_MODE_GPIO:
+    case WPI_MODE_GPIO_DEVICE_BCM:
+      gpioPin = pin & 63 ;
+      break ;
+  }
+
+  desc->gpio = gpioPin ;
+  if (gpioPin < 0) {
+    desc->read  = digitalReadNoPin ;
+    desc->write = digitalWriteNoPin ;
+    return ;
+  }
+
+  switch (wiringPiMode) {
+    case WPI_MODE_GPIO_DEVICE_BCM:
+    case WPI_MODE_GPIO_DEVICE_WPI:
+    case WPI_MODE_GPIO_DEVICE_PHYS:
+      desc->read  = digitalReadDev ;
+      desc->write = digitalWriteDev ;
+      return ;
+  }
+
+  if (ISRP1MODEL) {
+    desc->set   = &rio [RP1_RIO_OUT + RP1_SET_OFFSET] ;
+    desc->clr   = &rio [RP1_RIO_OUT + RP1_CLR_OFFSET] ;
+    desc->lev   = &gpio [2*gpioPin] ;
+    desc->mask  = 1u << gpioPin ;
+    desc->read  = digitalReadRP1 ;
+  } else {
+    desc->set   = gpio + gpioToGPSET [gpioPin] ;
+    desc->clr   = gpio + gpioToGPCLR [gpioPin] ;
+    desc->lev   = gpio + gpioToGPLEV [gpioPin] ;
+    desc->mask  = 1u << (gpioPin & 31) ;
+    desc->read  = digitalReadBCM ;
+  }
+  desc->write = simRevision ? digitalWriteSim : digitalWriteMem ;
+}
+
+static void pinDescResolveAll (void)
+{
+  int pin ;
+
+  for (pin = 0 ; pin < 64 ; ++pin)
+    pinDescResolve (pin) ;
+}
+
+
+/*
+ *********************************************************************************
+ * Core Functions
+ *********************************************************************************
+ */
+
+/*
+ * pinModeAlt:
+ *	This is an un-documented special to let you set any pin to any mode
+ *********************************************************************************
+ */
+
+void pinModeAlt (int pin, int mode)
+{
+  setupCheck ("pinModeAlt") ;
 
   if ((pin & PI_GPIO_MASK) == 0)		// On-board pin
   {
+    /**/ if (wiringPiMode == WPI_MODE_PINS)
+      pin = pinToGpio [pin] ;
+    else if (wiringPiMode == WPI_MODE_PHYS)
+      pin = physToGpio [pin] ;
+    else if (wiringPiMode != WPI_MODE_GPIO)
+      return ;
+
+    if (piRP1Model()) {
+      //confusion! diffrent to to BCM!  this is taking directly the value for the register
+      int modeRP1;
+      switch(mode) {
+        case FSEL_ALT0:
+          modeRP1 = 0;
+          break;
+        case FSEL_ALT1:
+          modeRP1 = 1;
+          break;
+        case FSEL_ALT2:
+          modeRP1 = 2;
+          break;
+        case FSEL_ALT3:
+          modeRP1 = 3;
+          break;
+        case FSEL_ALT4:
+          modeRP1 = 4;
+          break;
+        case FSEL_ALT5:
+          modeRP1 = 5;
+          break;
+        case FSEL_ALT6:
+          modeRP1 = 6;
+          break;
+        case FSEL_ALT7:
+          modeRP1 = 7;
+          break;
+        case FSEL_ALT8:
+          modeRP1 = 8;
+          break;
+        case FSEL_OUTP:
+        case FSEL_INPT:
+          modeRP1 = RP1_FSEL_GPIO;
+          break;
+        default:
+          fprintf(stderr, "pinModeAlt: invalid mode %d\n", mode);
+          return;
+      }
+      //printf("pinModeAlt: Pi5 alt pin %d to %d\n", pin, modeRP1);
+      gpio[2*pin+1] = (modeRP1 & RP1_FSEL_NONE_HW) | RP1_DEBOUNCE_DEFAULT; //0-4  function, 5-11 debounce time
+    } else {
+      int fSel  = gpioToGPFSEL [pin] ;
+      int shift = gpioToShift  [pin] ;
+
+      *(gpio + fSel) = (*(gpio + fSel) & ~(7 << shift)) | ((mode & 0x7) << shift) ;
+    }
+
+  }
+}
+
+
+/*
+ * pinMode:
+ *	Sets the mode of a pin to be input, output or PWM output
+ *********************************************************************************
+ */
+
+//Default: rp1_set_pad(pin, 0, 1, 0, 1, 1, 1, 0);
+void rp1_set_pad(int pin, int slewfast, int schmitt, int pulldown, int pullup, int drive, int inputenable, int outputdisable) {
+
+  pads[1+pin] = (slewfast != 0) | ((schmitt != 0) << 1) | ((pulldown != 0) << 2) | ((pullup != 0) << 3) | ((drive & 0x3) << 4) | ((inputenable != 0) << 6) | ((outputdisable != 0) << 7);
+}
+
+void pinModeDevice (int pin, int mode) {
+  if (wiringPiDebug)
+      printf ("pinModeDevice: pin:%d mode:%d, flags: 0x%llX\n", pin, mode, (unsigned long long)lineFlags[pin]) ;
+
+  switch(mode) {
+    default:
+      fprintf(stderr, "pinMode: invalid mode request (only input und output supported)\n");
+      return;
+    case INPUT:
+      lineSetFlags (1ULL << pin, LINE_FLAGS_DIRECTION, GPIO_V2_LINE_FLAG_INPUT) ;
+      break;
+    case OUTPUT:
+      lineSetFlags (1ULL << pin, LINE_FLAGS_DIRECTION, GPIO_V2_LINE_FLAG_OUTPUT) ;
+      break;
+    case PM_OFF:
+      lineRelease (pin) ;
+      lineFlags[pin] = (lineFlags[pin] & ~LINE_FLAGS_DIRECTION) ;
+      break;
+  }
+}
+
+void pinMode (int pin, int mode)
+{
+  int    fSel, shift, alt ;
+  struct wiringPiNodeStruct *node = wiringPiNodes ;
+  int origPin = pin ;
+
+  if (wiringPiDebug)
+    printf ("pinMode: pin:%d mode:%d\n", pin, mode) ;
+
+  setupCheck ("pinMode") ;
+
+  if ((pin & PI_GPIO_MASK) == 0)		// On-board pin
+  {
+    pinDescResolve (pin) ;
     switch(wiringPiMode) {
       default: //WPI_MODE_GPIO_SYS
         fprintf(stderr, "pinMode: invalid mode\n");
@@ -2040,6 +2814,8 @@ void pinMode (int pin, int mode)
       delayMicroseconds (110) ;
       gpioClockSet      (pin, 100000) ;
     }
+    if (simRevision)
+      simUpdate () ;
   }
   else
   {
@@ -2056,24 +2832,19 @@ void pinMode (int pin, int mode)
  *********************************************************************************
  */
 void pullUpDnControlDevice (int pin, int pud) {
-  unsigned int flag = lineFlags[pin];
-  unsigned int biasflags = GPIOHANDLE_REQUEST_BIAS_DISABLE | GPIOHANDLE_REQUEST_BIAS_PULL_UP | GPIOHANDLE_REQUEST_BIAS_PULL_DOWN;
+  uint64_t bias ;
 
-  flag &= ~biasflags;
   switch (pud){
-    case PUD_OFF:  flag |= GPIOHANDLE_REQUEST_BIAS_DISABLE;   break;
-    case PUD_UP:   flag |= GPIOHANDLE_REQUEST_BIAS_PULL_UP;   break;
-    case PUD_DOWN: flag |= GPIOHANDLE_REQUEST_BIAS_PULL_DOWN; break;
+    case PUD_OFF:  bias = GPIO_V2_LINE_FLAG_BIAS_DISABLED;  break;
+    case PUD_UP:   bias = GPIO_V2_LINE_FLAG_BIAS_PULL_UP;   break;
+    case PUD_DOWN: bias = GPIO_V2_LINE_FLAG_BIAS_PULL_DOWN; break;
     default: return ; /* An illegal value */
   }
 
-  // reset input/output
-  if (lineFlags[pin] & GPIOHANDLE_REQUEST_OUTPUT) {
-    pinModeFlagsDevice (pin, OUTPUT, flag);
-  } else if(lineFlags[pin] & GPIOHANDLE_REQUEST_INPUT) {
-    pinModeFlagsDevice (pin, INPUT, flag);
+  if (lineRequested & (1ULL << pin)) {
+    lineSetFlags (1ULL << pin, LINE_FLAGS_BIAS, bias) ;   // reconfigure in place
   } else {
-    lineFlags[pin] = flag; // only store for later
+    lineFlags[pin] = (lineFlags[pin] & ~LINE_FLAGS_BIAS) | bias ; // only store for later
   }
 }
 
@@ -2164,21 +2935,30 @@ void pullUpDnControl (int pin, int pud)
  */
 
 int digitalReadDevice (int pin) {   // INPUT and OUTPUT should work
-
-   if (lineFds[pin]<0) {
+  struct gpio_v2_line_values values;
+  int ret ;
+
+  if (isrFds[pin] >= 0) {
+    // line belongs to an interrupt request
+    values.mask = 1 ;
+    values.bits = 0 ;
+    ret = ioctl(isrFds[pin], GPIO_V2_LINE_GET_VALUES_IOCTL, &values);
+    return (ret == 0 && values.bits) ? HIGH : LOW ;
+  }
+  if ((lineRequested & (1ULL << pin)) == 0) {
     // line not requested - auto request on first read as input
     pinModeDevice(pin, INPUT);
-  }
-  if (lineFds[pin]>=0) {
-    struct gpiohandle_data data;
-    int ret = ioctl(lineFds[pin], GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data);
-    if (ret) {
-      ReportDeviceError("get line values", pin, "digitalRead", ret);
+    if ((lineRequested & (1ULL << pin)) == 0)
       return LOW;  // error
-    }
-    return data.values[0];
   }
-  return LOW;  // error , need to request line before
+  values.mask = 1ULL << lineIndex[pin] ;
+  values.bits = 0 ;
+  ret = ioctl(lineReqFds[lineReq[pin]], GPIO_V2_LINE_GET_VALUES_IOCTL, &values);
+  if (ret) {
+    ReportDeviceError("get line values", pin, "digitalRead", ret);
+    return LOW;  // error
+  }
+  return (values.bits & values.mask) ? HIGH : LOW ;
 }
 
 
@@ -2187,40 +2967,7 @@ int digitalRead (int pin)
   struct wiringPiNodeStruct *node = wiringPiNodes ;
 
   if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
-  {
-    switch(wiringPiMode) {
-      default: //WPI_MODE_GPIO_SYS
-        fprintf(stderr, "digitalRead: invalid mode\n");
-        return LOW;
-      case WPI_MODE_PINS:
-        pin = pinToGpio [pin];
-        break;
-      case WPI_MODE_PHYS:
-        pin = physToGpio [pin];
-        break;
-      case WPI_MODE_GPIO_DEVICE_BCM:
-        return digitalReadDevice(pin);
-      case WPI_MODE_GPIO_DEVICE_WPI:
-        return digitalReadDevice(pinToGpio[pin]);
-      case WPI_MODE_GPIO_DEVICE_PHYS:
-        return digitalReadDevice(physToGpio[pin]);
-      case WPI_MODE_GPIO:
-        break;
-    }
-
-    if (ISRP1MODEL) {
-      switch(gpio[2*pin] & RP1_STATUS_LEVEL_MASK) {
-        default: // 11 or 00 not allowed, give LOW!
-        case RP1_STATUS_LEVEL_LOW:  return LOW ;
-        case RP1_STATUS_LEVEL_HIGH: return HIGH ;
-      }
-    } else {
-      if ((*(gpio + gpioToGPLEV [pin]) & (1 << (pin & 31))) != 0)
-        return HIGH ;
-      else
-        return LOW ;
-    }
-  }
+    return pinDesc [pin].read (&pinDesc [pin]) ;
   else
   {
     if ((node = wiringPiFindNode (pin)) == NULL)
@@ -2231,25 +2978,47 @@ int digitalRead (int pin)
 
 
 /*
- * digitalRead8:
- *	Read 8-bits (a byte) from given start pin.
+ * digitalReadPort:
+ *	Read bits pins (1-32) from the given start pin on, bit n is pin + n.
+ *	A node with a port function reads them with one bus transfer, other
+ *	pins are read one by one.
  *********************************************************************************
+ */
 
-unsigned int digitalRead8 (int pin)
+unsigned int digitalReadPort (int pin, int bits)
 {
-  struct wiringPiNodeStruct *node = wiringPiNodes ;
+  struct wiringPiNodeStruct *node ;
+  unsigned int value = 0 ;
+  int n ;
 
-  if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
+  if (bits < 1 || bits > 32)
     return 0 ;
-  else
+
+  if ((pin & PI_GPIO_MASK) != 0)
   {
-    if ((node = wiringPiFindNode (pin)) == NULL)
-      return LOW ;
-    return node->digitalRead8 (node, pin) ;
+    node = wiringPiFindNode (pin) ;
+    if (node != NULL && node->digitalReadPort != NULL && (pin + bits - 1) <= node->pinMax)
+      return node->digitalReadPort (node, pin, bits) ;
   }
+
+  for (n = 0 ; n < bits ; ++n)
+    if (digitalRead (pin + n) != LOW)
+      value |= 1u << n ;
+  return value ;
 }
+
+
+/*
+ * digitalRead8:
+ *	Read 8-bits (a byte) from given start pin.
+ *********************************************************************************
  */
 
+unsigned int digitalRead8 (int pin)
+{
+  return digitalReadPort (pin, 8) ;
+}
+
 
 /*
  * digitalWrite:
@@ -2258,28 +3027,34 @@ unsigned int digitalRead8 (int pin)
  */
 
 void digitalWriteDevice (int pin, int value) {
+  struct gpio_v2_line_values values;
 
   if (wiringPiDebug)
     printf ("digitalWriteDevice: ioctl pin:%d value: %d\n", pin, value) ;
 
-  if (lineFds[pin]<0) {
-    // line not requested - auto request on first write as output
+  if (value == LOW)
+    lineValues &= ~(1ULL << pin) ;
+  else
+    lineValues |=  (1ULL << pin) ;
+
+  if ((lineRequested & (1ULL << pin)) == 0) {
+    // line not requested - auto request on first write as output, the value goes with the request
     pinModeDevice(pin, OUTPUT);
+    return;
   }
-  if (lineFds[pin]>=0 && (lineFlags[pin] & GPIOHANDLE_REQUEST_OUTPUT)>0) {
-    struct gpiohandle_data data;
-    data.values[0] = value;
+  if (lineFlags[pin] & GPIO_V2_LINE_FLAG_OUTPUT) {
+    values.mask = 1ULL << lineIndex[pin] ;
+    values.bits = (value == LOW) ? 0 : values.mask ;
     if (wiringPiDebug)
-      printf ("digitalWriteDevice: ioctl pin:%d cmd: GPIOHANDLE_SET_LINE_VALUES_IOCTL, value: %d\n", pin, value) ;
-    int ret = ioctl(lineFds[pin], GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+      printf ("digitalWriteDevice: ioctl pin:%d cmd: GPIO_V2_LINE_SET_VALUES_IOCTL, value: %d\n", pin, value) ;
+    int ret = ioctl(lineReqFds[lineReq[pin]], GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
     if (ret) {
       ReportDeviceError("set line values", pin, "digitalWrite", ret);
       return;  // error
     }
   } else {
-    fprintf(stderr, "digitalWrite: no output (%d)\n", lineFlags[pin]);
+    fprintf(stderr, "digitalWrite: no output (0x%llX)\n", (unsigned long long)lineFlags[pin]);
   }
-  return; // error
 }
 
 void digitalWrite (int pin, int value)
@@ -2287,45 +3062,7 @@ void digitalWrite (int pin, int value)
   struct wiringPiNodeStruct *node = wiringPiNodes ;
 
   if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
-  {
-    switch(wiringPiMode) {
-      default: //WPI_MODE_GPIO_SYS
-        fprintf(stderr, "digitalWrite: invalid mode\n");
-        return;
-      case WPI_MODE_PINS:
-        pin = pinToGpio [pin];
-        break;
-      case WPI_MODE_PHYS:
-        pin = physToGpio [pin];
-        break;
-      case WPI_MODE_GPIO_DEVICE_BCM:
-        digitalWriteDevice(pin, value);
-        return;
-      case WPI_MODE_GPIO_DEVICE_WPI:
-        digitalWriteDevice(pinToGpio[pin], value);
-        return;
-      case WPI_MODE_GPIO_DEVICE_PHYS:
-        digitalWriteDevice(physToGpio[pin], value);
-        return;
-      case WPI_MODE_GPIO:
-        break;
-    }
-
-    if (ISRP1MODEL) {
-      if (value == LOW) {
-        //printf("Set pin %d >>0x%08x<< to low\n", pin, 1<<pin);
-        rio[RP1_RIO_OUT + RP1_CLR_OFFSET] = 1<<pin;
-      } else {
-        //printf("Set pin %d >>0x%08x<< to high\n", pin, 1<<pin);
-        rio[RP1_RIO_OUT + RP1_SET_OFFSET] = 1<<pin;
-      }
-    } else {
-      if (value == LOW)
-        *(gpio + gpioToGPCLR [pin]) = 1 << (pin & 31) ;
-      else
-        *(gpio + gpioToGPSET [pin]) = 1 << (pin & 31) ;
-    }
-  }
+    pinDesc [pin].write (&pinDesc [pin], value) ;
   else
   {
     if ((node = wiringPiFindNode (pin)) != NULL)
@@ -2335,24 +3072,50 @@ void digitalWrite (int pin, int value)
 
 
 /*
- * digitalWrite8:
- *	Set an output 8-bit byte on the device from the given pin number
+ * digitalWritePort:
+ *	Write bits pins (1-32) from the given start pin on, bit n of value is
+ *	pin + n, only the pins set in mask change. A node with a port function
+ *	writes them with one bus transfer, other pins are written one by one.
  *********************************************************************************
+ */
 
-void digitalWrite8 (int pin, int value)
+void digitalWritePort (int pin, int bits, unsigned int value, unsigned int mask)
 {
-  struct wiringPiNodeStruct *node = wiringPiNodes ;
+  struct wiringPiNodeStruct *node ;
+  int n ;
 
-  if ((pin & PI_GPIO_MASK) == 0)		// On-Board Pin
+  if (bits < 1 || bits > 32)
     return ;
-  else
+  if (bits < 32)
+    mask &= (1u << bits) - 1 ;
+
+  if ((pin & PI_GPIO_MASK) != 0)
   {
-    if ((node = wiringPiFindNode (pin)) != NULL)
-      node->digitalWrite8 (node, pin, value) ;
+    node = wiringPiFindNode (pin) ;
+    if (node != NULL && node->digitalWritePort != NULL && (pin + bits - 1) <= node->pinMax)
+    {
+      node->digitalWritePort (node, pin, bits, value, mask) ;
+      return ;
+    }
   }
+
+  for (n = 0 ; n < bits ; ++n)
+    if (mask & (1u << n))
+      digitalWrite (pin + n, (value >> n) & 1) ;
 }
+
+
+/*
+ * digitalWrite8:
+ *	Set an output 8-bit byte on the device from the given pin number
+ *********************************************************************************
  */
 
+void digitalWrite8 (int pin, int value)
+{
+  digitalWritePort (pin, 8, value, 0xFF) ;
+}
+
 
 /*
  * pwmWrite:
@@ -2481,6 +3244,8 @@ void pwmToneWrite (int pin, int freq)
  *	These are wiringPi pin numbers 0..7, or BCM_GPIO pin numbers
  *	17, 18, 22, 23, 24, 24, 4 on a Pi v1 rev 0-3
  *	17, 18, 27, 23, 24, 24, 4 on a Pi v1 rev 3 onwards or B+, 2, 3, zero
+ *	Both go through digitalWriteMask/digitalReadBank, so they work on the
+ *	Pi 5 and with the gpiochip device too.
  *********************************************************************************
  */
 
@@ -2491,9 +3256,7 @@ void digitalWriteByte (const int value)
   int mask = 1 ;
   int pin ;
 
-  FailOnModel5("digitalWriteByte");
-
-  if (wiringPiMode == WPI_MODE_GPIO_SYS)
+  if (wiringPiMode == WPI_MODE_GPIO_SYS || wiringPiMode == WPI_MODE_UNINITIALISED)
   {
     return ;
   }
@@ -2509,8 +3272,7 @@ void digitalWriteByte (const int value)
       mask <<= 1 ;
     }
 
-    *(gpio + gpioToGPCLR [0]) = pinClr ;
-    *(gpio + gpioToGPSET [0]) = pinSet ;
+    digitalWriteMask (0, pinSet, pinClr) ;
   }
 }
 
@@ -2520,15 +3282,13 @@ unsigned int digitalReadByte (void)
   uint32_t raw ;
   uint32_t data = 0 ;
 
-  FailOnModel5("digitalReadByte");
-
-  if (wiringPiMode == WPI_MODE_GPIO_SYS)
+  if (wiringPiMode == WPI_MODE_GPIO_SYS || wiringPiMode == WPI_MODE_UNINITIALISED)
   {
     return 0;
   }
   else
   {
-    raw = *(gpio + gpioToGPLEV [0]) ; // First bank for these pins
+    raw = digitalReadBank (0) ; // First bank for these pins
     for (pin = 0 ; pin < 8 ; ++pin)
     {
       x = pinToGpio [pin] ;
@@ -2551,15 +3311,12 @@ unsigned int digitalReadByte (void)
 
 void digitalWriteByte2 (const int value)
 {
-  FailOnModel5("digitalWriteByte2");
-
-  if (wiringPiMode == WPI_MODE_GPIO_SYS)
+  if (wiringPiMode == WPI_MODE_GPIO_SYS || wiringPiMode == WPI_MODE_UNINITIALISED)
   {
   }
   else
   {
-    *(gpio + gpioToGPCLR [0]) = (~value & 0xFF) << 20 ; // 0x0FF00000; ILJ > CHANGE: Old causes glitch
-    *(gpio + gpioToGPSET [0]) = ( value & 0xFF) << 20 ;
+    digitalWriteMask (0, (value & 0xFF) << 20, (~value & 0xFF) << 20) ; // ILJ > CHANGE: Old 0x0FF00000 clear causes glitch
   }
 }
 
@@ -2567,18 +3324,232 @@ unsigned int digitalReadByte2 (void)
 {
   uint32_t data = 0 ;
 
-  FailOnModel5("digitalReadByte2");
-
-  if (wiringPiMode == WPI_MODE_GPIO_SYS)
+  if (wiringPiMode == WPI_MODE_GPIO_SYS || wiringPiMode == WPI_MODE_UNINITIALISED)
   {
   }
   else
-    data = ((*(gpio + gpioToGPLEV [0])) >> 20) & 0xFF ; // First bank for these pins
+    data = (digitalReadBank (0) >> 20) & 0xFF ; // First bank for these pins
 
   return data ;
 }
 
 
+/*
+ * pinToBcm:
+ *	Translate a pin in the current numbering scheme to the BCM_GPIO pin,
+ *	-1 if it's not an on-board pin.
+ *********************************************************************************
+ */
+
+static int pinToBcm (int pin)
+{
+  if ((pin & PI_GPIO_MASK) != 0)
+    return -1 ;
+
+  switch (wiringPiMode) {
+    case WPI_MODE_PINS:
+    case WPI_MODE_GPIO_DEVICE_WPI:
+      return pinToGpio [pin] ;
+    case WPI_MODE_PHYS:
+    case WPI_MODE_GPIO_DEVICE_PHYS:
+      return physToGpio [pin] ;
+    case WPI_MODE_GPIO:
+    case WPI_MODE_GPIO_DEVICE_BCM:
+      return pin ;
+    default:
+      return -1 ;
+  }
+}
+
+
+/*
+ * digitalPinToBank:
+ * digitalPinToBitMask:
+ *	Return the bank and the bit inside the bank for a pin, as used by
+ *	digitalWriteMask and digitalReadBank. A bank holds 32 BCM_GPIO pins.
+ *********************************************************************************
+ */
+
+int digitalPinToBank (int pin)
+{
+  int gpioPin = pinToBcm (pin) ;
+
+  return (gpioPin < 0) ? -1 : (gpioPin >> 5) ;
+}
+
+unsigned int digitalPinToBitMask (int pin)
+{
+  int gpioPin = pinToBcm (pin) ;
+
+  return (gpioPin < 0) ? 0 : (1u << (gpioPin & 31)) ;
+}
+
+
+/*
+ * digitalWriteMask:
+ * digitalReadBank:
+ *	Pi Specific
+ *	Set and clear any number of pins of one bank at once. Bit n of the masks
+ *	is BCM_GPIO bank*32+n, independent of the pin numbering mode in use.
+ *	A bit in both masks is set. On the memory mapped hardware this is one
+ *	store to the clear and one to the set register, with the gpiochip device
+ *	all lines go out in one ioctl.
+ *	The Pi 5 (RP1) has only bank 0 (GPIO 0..27) on the header.
+ *********************************************************************************
+ */
+
+void digitalWriteMaskDevice (int bank, unsigned int setMask, unsigned int clrMask) {
+  struct gpio_v2_line_values values;
+  uint64_t setLines, clrLines, lines, outputs = 0 ;
+  int pin, r ;
+
+  if (bank < 0 || bank > 1 || (setMask | clrMask) == 0)
+    return ;
+
+  setLines = (uint64_t)setMask << (bank*32) ;
+  clrLines = (uint64_t)clrMask << (bank*32) ;
+  lines    = setLines | clrLines ;
+  lineValues = (lineValues & ~clrLines) | setLines ;
+
+  for (pin = 0 ; pin < 64 ; ++pin) {
+    if ((lineRequested & (1ULL << pin)) && (lineFlags [pin] & GPIO_V2_LINE_FLAG_OUTPUT))
+      outputs |= 1ULL << pin ;
+  }
+  if (lines & ~outputs) {
+    // new outputs, the values go out with the request or configuration
+    lineSetFlags (lines & ~outputs, LINE_FLAGS_DIRECTION, GPIO_V2_LINE_FLAG_OUTPUT) ;
+    lines &= outputs ;
+  }
+
+  // one ioctl per request, lines set up together share one
+  for (r = 0 ; lines != 0 ; ++r) {
+    if ((lines & lineReqLines [r]) == 0)
+      continue ;
+    values.mask = lineMaskToRequest (r, lines) ;
+    values.bits = lineMaskToRequest (r, lineValues & lines) ;
+    lines &= ~lineReqLines [r] ;
+    int ret = ioctl(lineReqFds [r], GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+    if (ret) {
+      ReportDeviceError("set line values", bank, "digitalWriteMask", ret);
+    }
+  }
+}
+
+unsigned int digitalReadBankDevice (int bank) {
+  struct gpio_v2_line_values values;
+  uint64_t lines, result = 0 ;
+  int pin, r ;
+
+  if (bank < 0 || bank > 1)
+    return 0 ;
+
+  lines = lineRequested & (0xFFFFFFFFULL << (bank*32)) ;
+  for (r = 0 ; lines != 0 ; ++r) {
+    if ((lines & lineReqLines [r]) == 0)
+      continue ;
+    values.mask = lineMaskToRequest (r, lines) ;
+    values.bits = 0 ;
+    if (ioctl(lineReqFds [r], GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == 0)
+      result |= lineMaskFromRequest (r, values.bits, lines) ;
+    lines &= ~lineReqLines [r] ;
+  }
+  for (pin = bank*32 ; pin < bank*32 + 32 ; ++pin) {
+    if (isrFds[pin] >= 0 && digitalReadDevice (pin))
+      result |= 1ULL << pin ;
+  }
+  return (unsigned int)(result >> (bank*32)) ;
+}
+
+void digitalWriteMask (int bank, unsigned int setMask, unsigned int clrMask)
+{
+  clrMask &= ~setMask ;
+
+  switch (wiringPiMode) {
+    case WPI_MODE_PINS:
+    case WPI_MODE_PHYS:
+    case WPI_MODE_GPIO:
+      if (ISRP1MODEL) {
+        if (bank != 0)
+          return ;
+        if (clrMask)
+          rio[RP1_RIO_OUT + RP1_CLR_OFFSET] = clrMask ;
+        if (setMask)
+          rio[RP1_RIO_OUT + RP1_SET_OFFSET] = setMask ;
+      } else {
+        if (bank < 0 || bank > 1)
+          return ;
+        if (clrMask)
+          *(gpio + gpioToGPCLR [bank*32]) = clrMask ;
+        if (setMask)
+          *(gpio + gpioToGPSET [bank*32]) = setMask ;
+      }
+      if (simRevision)
+        simUpdate () ;
+      return ;
+    case WPI_MODE_GPIO_DEVICE_BCM:
+    case WPI_MODE_GPIO_DEVICE_WPI:
+    case WPI_MODE_GPIO_DEVICE_PHYS:
+      digitalWriteMaskDevice (bank, setMask, clrMask) ;
+      return ;
+    default:
+      return ;
+  }
+}
+
+unsigned int digitalReadBank (int bank)
+{
+  switch (wiringPiMode) {
+    case WPI_MODE_PINS:
+    case WPI_MODE_PHYS:
+    case WPI_MODE_GPIO:
+      if (ISRP1MODEL)
+        return (bank == 0) ? rio[RP1_RIO_IN] : 0 ;
+      if (bank < 0 || bank > 1)
+        return 0 ;
+      return *(gpio + gpioToGPLEV [bank*32]) ;
+    case WPI_MODE_GPIO_DEVICE_BCM:
+    case WPI_MODE_GPIO_DEVICE_WPI:
+    case WPI_MODE_GPIO_DEVICE_PHYS:
+      return digitalReadBankDevice (bank) ;
+    default:
+      return 0 ;
+  }
+}
+
+
+/*
+ * isrPinToGpio:
+ *	The interrupt data are indexed by the BCM_GPIO pin
+ *********************************************************************************
+ */
+
+static int isrPinToGpio (int pin)
+{
+  if (wiringPiMode == WPI_MODE_GPIO_SYS)
+    return ((pin & PI_GPIO_MASK) == 0) ? pin : -1 ;
+  return pinToBcm (pin) ;
+}
+
+
+/*
+ * isrDebounceAccept:
+ *	Software debounce for kernels without GPIO_V2_LINE_ATTR_ID_DEBOUNCE:
+ *	edges within the debounce period after an accepted edge are dropped.
+ *	Called by the interrupt dispatcher and waitForInterrupt.
+ *********************************************************************************
+ */
+
+static int isrDebounceAccept (int pin, uint64_t timeStamp)
+{
+  if (isrSoftDebounce [pin] == 0)
+    return TRUE ;
+  if (isrLastEdge [pin] != 0 && timeStamp - isrLastEdge [pin] < isrSoftDebounce [pin])
+    return FALSE ;
+  isrLastEdge [pin] = timeStamp ;
+  return TRUE ;
+}
+
+
 /*
  * waitForInterrupt:
  *	Pi Specific.
@@ -2586,6 +3557,7 @@ unsigned int digitalReadByte2 (void)
  *	This is actually done via the /dev/gpiochip interface regardless of
  *	the wiringPi access mode in-use. Maybe sometime it might get a better
  *	way for a bit more efficiency.
+ *	Edges dropped by the software debounce don't end the wait.
  *********************************************************************************
  */
 
@@ -2593,13 +3565,11 @@ int waitForInterrupt (int pin, int mS)
 {
   int fd, ret;
   struct pollfd polls ;
-  struct gpioevent_data evdata;
-  //struct gpio_v2_line_request req2;
+  struct gpio_v2_line_event evdata;
+  unsigned int deadline = millis () + mS ;
 
-  if (wiringPiMode == WPI_MODE_PINS)
-    pin = pinToGpio [pin] ;
-  else if (wiringPiMode == WPI_MODE_PHYS)
-    pin = physToGpio [pin] ;
+  if ((pin = isrPinToGpio (pin)) < 0)
+    return -2 ;
 
   if ((fd = isrFds [pin]) == -1)
     return -2 ;
@@ -2607,76 +3577,131 @@ int waitForInterrupt (int pin, int mS)
   // Setup poll structure
   polls.fd      = fd;
   polls.events  = POLLIN | POLLERR ;
-  polls.revents = 0;
 
-  // Wait for it ...
-  ret = poll(&polls, 1, mS);
-  if (ret <= 0) {
-    fprintf(stderr, "wiringPi: ERROR: poll returned=%d\n", ret);
-  } else {
+  for (;;) {
+    polls.revents = 0;
+
+    // Wait for it ...
+    ret = poll(&polls, 1, mS);
+    if (ret <= 0) {
+      fprintf(stderr, "wiringPi: ERROR: poll returned=%d\n", ret);
+      return ret;
+    }
     //if (polls.revents & POLLIN)
     if (wiringPiDebug) {
       printf ("wiringPi: IRQ line %d received %d, fd=%d\n", pin, ret, isrFds[pin]) ;
     }
     /* read event data */
     int readret = read(isrFds [pin], &evdata, sizeof(evdata));
-    if (readret == sizeof(evdata)) {
-      if (wiringPiDebug) {
-        printf ("wiringPi: IRQ data id: %d, timestamp: %lld\n", evdata.id, evdata.timestamp) ;
-      }
-      ret = evdata.id;
-    } else {
-      ret = 0;
+    if (readret != sizeof(evdata))
+      return 0;
+    if (wiringPiDebug) {
+      printf ("wiringPi: IRQ data id: %u, timestamp: %llu\n", evdata.id, (unsigned long long)evdata.timestamp_ns) ;
+    }
+    if (isrDebounceAccept (pin, evdata.timestamp_ns))
+      return evdata.id;
+
+    // a bounce, wait for the rest of the time
+    if (mS > 0) {
+      mS = (int)(deadline - millis ()) ;
+      if (mS <= 0)
+        mS = 0 ;
     }
   }
-  return ret;
 }
 
-int waitForInterruptInit (int pin, int mode)
-{
-  const char* strmode = "";
-
-  if (wiringPiMode == WPI_MODE_PINS) {
-    pin = pinToGpio [pin] ;
-  } else if (wiringPiMode == WPI_MODE_PHYS) {
-    pin = physToGpio [pin] ;
-  }
-
-  /* open gpio */
-  sleep(1);
-  if (wiringPiGpioDeviceGetFd()<0) {
-    return -1;
-  }
+/*
+ * isrLineConfig:
+ *	Line configuration of an interrupt pin, the debounce period goes to
+ *	the kernel, which uses the hardware filter of the GPIO controller
+ *	when it has one and its own debounce otherwise.
+ *********************************************************************************
+ */
 
-  struct gpioevent_request req;
-  req.lineoffset = pin;
-  req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+static int isrLineConfig (int pin, int mode, int kernelDebounce, struct gpio_v2_line_config *config)
+{
+  ZeroMemory(config, sizeof(*config));
+  config->flags = GPIO_V2_LINE_FLAG_INPUT | (lineFlags[pin] & LINE_FLAGS_BIAS);
   switch(mode) {
     default:
     case INT_EDGE_SETUP:
-      if (wiringPiDebug) {
-        printf ("wiringPi: waitForInterruptMode mode INT_EDGE_SETUP - exiting\n") ;
-      }
       return -1;
     case INT_EDGE_FALLING:
-      req.eventflags  = GPIOEVENT_REQUEST_FALLING_EDGE;
-      strmode = "falling";
+      config->flags |= GPIO_V2_LINE_FLAG_EDGE_FALLING;
       break;
     case INT_EDGE_RISING:
-      req.eventflags  = GPIOEVENT_REQUEST_RISING_EDGE;
-      strmode = "rising";
+      config->flags |= GPIO_V2_LINE_FLAG_EDGE_RISING;
       break;
     case INT_EDGE_BOTH:
-      req.eventflags  = GPIOEVENT_REQUEST_BOTH_EDGES;
-      strmode = "both";
+      config->flags |= GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
       break;
   }
-  strncpy(req.consumer_label, "wiringpi_gpio_irq", sizeof(req.consumer_label) - 1);
+  if (kernelDebounce && isrDebounce[pin] > 0) {
+    config->attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+    config->attrs[0].attr.debounce_period_us = isrDebounce[pin];
+    config->attrs[0].mask = 1;
+    config->num_attrs = 1;
+  }
+  return 0;
+}
 
-  //later implement GPIO_V2_GET_LINE_IOCTL req2
-  int ret = ioctl(chipFd, GPIO_GET_LINEEVENT_IOCTL, &req);
-  if (ret) {
+
+static int isrLineRequest (int pin, int mode, unsigned int eventBufferSize)
+{
+  const char* strmode = "";
+  uint64_t held ;
+  int ret;
+
+  if ((pin = isrPinToGpio (pin)) < 0)
+    return -1 ;
+
+  /* open gpio */
+  if (wiringPiGpioDeviceGetFd()<0) {
+    return -1;
+  }
+
+  struct gpio_v2_line_request req;
+  ZeroMemory(&req, sizeof(req));
+  req.offsets[0] = pin;
+  req.num_lines = 1;
+  req.event_buffer_size = eventBufferSize;
+  if (isrLineConfig (pin, mode, TRUE, &req.config) < 0) {
+    if (wiringPiDebug) {
+      printf ("wiringPi: waitForInterruptMode mode INT_EDGE_SETUP - exiting\n") ;
+    }
+    return -1;
+  }
+  switch(mode) {
+    case INT_EDGE_FALLING: strmode = "falling"; break;
+    case INT_EDGE_RISING:  strmode = "rising";  break;
+    case INT_EDGE_BOTH:    strmode = "both";    break;
+  }
+  strncpy(req.consumer, "wiringpi_gpio_irq", sizeof(req.consumer) - 1);
+
+  // the line can only be in one request, held again as before on failure
+  held = lineRequested & (1ULL << pin) ;
+  if (lineRelease(pin) < 0) {
+    fprintf (stderr, "wiringPi: GPIO %d shares a line request with lines in use, release them with pinMode PM_OFF first\n", pin) ;
+    if (held)
+      lineSetFlags (held, 0, 0) ;
+    return -1 ;
+  }
+
+  isrSoftDebounce [pin] = 0 ;
+  ret = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+  if ((ret || req.fd<0) && req.config.num_attrs > 0) {
+    // kernel without debounce support, filter the timestamps in the dispatcher
+    if (wiringPiDebug) {
+      printf ("wiringPi: GPIO line %d without kernel debounce, using software filter\n", pin) ;
+    }
+    req.config.num_attrs = 0;
+    isrSoftDebounce [pin] = (uint64_t)isrDebounce [pin] * 1000 ;
+    ret = ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+  }
+  if (ret || req.fd<0) {
     ReportDeviceError("get line event", pin , strmode, ret);
+    if (held)
+      lineSetFlags (held, 0, 0) ;
     return -1;
   }
   if (wiringPiDebug) {
@@ -2686,6 +3711,8 @@ int waitForInterruptInit (int pin, int mode)
   /* set event fd nonbloack read */
   int fd_line = req.fd;
   isrFds [pin] = fd_line;
+  isrMode [pin] = mode;
+  isrLastEdge [pin] = 0;
   int flags = fcntl(fd_line, F_GETFL);
   flags |= O_NONBLOCK;
   ret = fcntl(fd_line, F_SETFL, flags);
@@ -2694,28 +3721,71 @@ int waitForInterruptInit (int pin, int mode)
     return -1;
   }
 
-  return 0;
+  return 0;
+}
+
+int waitForInterruptInit (int pin, int mode)
+{
+  return isrLineRequest (pin, mode, 0) ;
+}
+
+
+/*
+ * waitForInterruptClose:
+ *	Release the line event fd of a pin, the ISR and the capture ring
+ *********************************************************************************
+ */
+
+static void edgeRingFree (struct wpiEdgeRingStruct *ring)
+{
+  if (ring) {
+    close (ring->eventFd) ;
+    free (ring->events) ;
+    free (ring) ;
+  }
+}
+
+// Drop a reference with isrMutex held, the last one frees the ring
+
+static void edgeRingPut (struct wpiEdgeRingStruct *ring)
+{
+  if (ring && --ring->users == 0)
+    edgeRingFree (ring) ;
 }
 
 
 int waitForInterruptClose (int pin) {
-  if (isrFds[pin]>0) {
-    if (wiringPiDebug) {
-      printf ("wiringPi: waitForInterruptClose close thread 0x%lX\n", (unsigned long)isrThreads[pin]) ;
-    }
-    if (pthread_cancel(isrThreads[pin]) == 0) {
-      if (wiringPiDebug) {
-        printf ("wiringPi: waitForInterruptClose thread canceled successfuly\n") ;
-      }
-    } else {
-     if (wiringPiDebug) {
-        fprintf (stderr, "wiringPi: waitForInterruptClose could not cancel thread\n");
-      }
+  if ((pin = isrPinToGpio (pin)) < 0)
+    return -1 ;
+
+  pthread_mutex_lock (&isrMutex) ;
+
+  // a running function may still use its userdata, wait for it to return,
+  //	unless the function stops its own pin
+  while ((isrBusy == pin) && !pthread_equal (pthread_self (), isrThread))
+    pthread_cond_wait (&isrIdle, &isrMutex) ;
+
+  if (isrFds[pin]>=0) {
+    if (isrEpollFd >= 0) {
+      epoll_ctl (isrEpollFd, EPOLL_CTL_DEL, isrFds[pin], NULL) ;
     }
     close(isrFds [pin]);
   }
   isrFds [pin] = -1;
   isrFunctions [pin] = NULL;
+  isrFunctions2 [pin] = NULL;
+  isrUserdata [pin] = NULL;
+  if (isrRings [pin]) {
+    uint64_t one = 1 ;
+
+    // wake a waiting wiringPiEdgeRead, it frees the ring if it is the last user
+    if (write (isrRings [pin]->eventFd, &one, sizeof (one)) < 0) {
+      // counter saturated, the reader is awake anyway
+    }
+    edgeRingPut (isrRings [pin]) ;
+    isrRings [pin] = NULL ;
+  }
+  pthread_mutex_unlock (&isrMutex) ;
 
   /* -not closing so far - other isr may be using it - only close if no other is using - will code later
   if (chipFd>0) {
@@ -2735,40 +3805,131 @@ int wiringPiISRStop (int pin) {
 }
 
 /*
- * interruptHandler:
- *	This is a thread and gets started to wait for the interrupt we're
- *	hoping to catch. It will call the user-function when the interrupt
- *	fires.
+ * edgeRingPush:
+ *	Producer side of the edge capture ring, one eventfd signal per batch
  *********************************************************************************
  */
 
-static void *interruptHandler (UNU void *arg)
+static void edgeRingPush (int pin, struct wpiEdgeRingStruct *ring, const struct gpio_v2_line_event *evdata, int count)
 {
-  int pin ;
+  unsigned int head = ring->head ;
+  unsigned int tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) ;
+  uint64_t one = 1 ;
+  int i ;
+
+  for (i = 0 ; i < count ; ++i) {
+    unsigned int seqno = evdata [i].line_seqno ;
+
+    if (ring->lastSeqno != 0 && seqno - ring->lastSeqno > 1)	// kernel buffer overrun
+      ring->overflow += seqno - ring->lastSeqno - 1 ;
+    ring->lastSeqno = seqno ;
+    if (!isrDebounceAccept (pin, evdata [i].timestamp_ns))
+      continue ;
+
+    if (head - tail >= ring->size) {
+      tail = __atomic_load_n (&ring->tail, __ATOMIC_ACQUIRE) ;
+      if (head - tail >= ring->size) {
+        ++ring->overflow ;
+        continue ;
+      }
+    }
+    struct WPIEdgeEvent *ev = &ring->events [head & (ring->size - 1)] ;
+    ev->timeStamp_ns = (long long int)evdata [i].timestamp_ns ;
+    ev->seqno        = seqno ;
+    ev->edge         = (evdata [i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? INT_EDGE_RISING : INT_EDGE_FALLING ;
+    ++head ;
+  }
+  if (head != ring->head) {
+    __atomic_store_n (&ring->head, head, __ATOMIC_RELEASE) ;
+    if (write (ring->eventFd, &one, sizeof (one)) < 0) {
+      // counter saturated, the consumer is awake anyway
+    }
+  }
+}
 
-  (void)piHiPri (55) ;	// Only effective if we run as root
 
-  pin   = pinPass ;
-  pinPass = -1 ;
+/*
+ * interruptDispatcher:
+ *	One thread for all interrupt pins. It waits on the epoll set of the
+ *	line event fds and calls the user-function of every pin that fired,
+ *	or puts the edges into the pin's capture ring.
+ *	All pending events of a pin are read at once, so a burst of edges costs
+ *	one wakeup.
+ *********************************************************************************
+ */
+
+#define	ISR_READ_BATCH	64
+
+static void *interruptDispatcher (UNU void *arg)
+{
+  struct epoll_event events [16] ;
+  static struct gpio_v2_line_event evdata [ISR_READ_BATCH] ;
+  int n, i, j ;
+
+  (void)piHiPri (55) ;	// Only effective if we run as root
 
   for (;;) {
-    int ret = waitForInterrupt(pin, -1);
-    if ( ret> 0) {
-      if (wiringPiDebug) {
-        printf ("wiringPi: call function\n") ;
+    n = epoll_wait (isrEpollFd, events, 16, -1) ;
+    if (n < 0) {
+      if (errno == EINTR)
+        continue ;
+      fprintf (stderr, "wiringPi: ERROR: epoll_wait returned=%d (%s)\n", n, strerror (errno)) ;
+      break ;
+    }
+    for (i = 0 ; i < n ; ++i) {
+      int pin = (int)events [i].data.u32 ;
+      void (*function)(void) ;
+      void (*function2)(struct WPIWfiStatus, void *) ;
+      void *userdata ;
+      int count = 0 ;
+
+      pthread_mutex_lock (&isrMutex) ;
+        if (isrFds [pin] >= 0) {
+          int readret = read (isrFds [pin], evdata, sizeof (evdata)) ;
+          if (readret > 0)
+            count = readret / sizeof (evdata [0]) ;
+        }
+        if (isrRings [pin]) {
+          edgeRingPush (pin, isrRings [pin], evdata, count) ;
+          count = 0 ;
+        }
+        function  = isrFunctions  [pin] ;
+        function2 = isrFunctions2 [pin] ;
+        userdata  = isrUserdata   [pin] ;
+        if (count > 0)
+          isrBusy = pin ;
+      pthread_mutex_unlock (&isrMutex) ;
+
+      for (j = 0 ; j < count ; ++j) {
+        if (isrFds [pin] < 0)		// stopped by the function itself
+          break ;
+        if (!isrDebounceAccept (pin, evdata [j].timestamp_ns))
+          continue ;
+        if (wiringPiDebug) {
+          printf ("wiringPi: IRQ line %d id: %u, timestamp: %llu\n", pin, evdata [j].id, (unsigned long long)evdata [j].timestamp_ns) ;
+        }
+        if (function2) {
+          struct WPIWfiStatus status ;
+          status.statusOK     = 1 ;
+          status.pinBCM       = pin ;
+          status.edge         = (evdata [j].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? INT_EDGE_RISING : INT_EDGE_FALLING ;
+          status.timeStamp_ns = (long long int)evdata [j].timestamp_ns ;
+          function2 (status, userdata) ;
+        } else if (function) {
+          function () ;
+        }
       }
-      if(isrFunctions [pin]) {
-        isrFunctions [pin] () ;
+      if (count > 0) {
+        pthread_mutex_lock (&isrMutex) ;
+          isrBusy = -1 ;
+          pthread_cond_broadcast (&isrIdle) ;
+        pthread_mutex_unlock (&isrMutex) ;
       }
-      // wait again - in the past forever - now can be stopped by  waitForInterruptClose
-    } else if( ret< 0) {
-      break; // stop thread!
     }
   }
 
-  waitForInterruptClose (pin);
   if (wiringPiDebug) {
-    printf ("wiringPi: interruptHandler finished\n") ;
+    printf ("wiringPi: interruptDispatcher finished\n") ;
   }
   return NULL ;
 }
@@ -2776,15 +3937,20 @@ static void *interruptHandler (UNU void *arg)
 
 /*
  * wiringPiISR:
+ * wiringPiISR2:
  *	Pi Specific.
- *	Take the details and create an interrupt handler that will do a call-
- *	back to the user supplied function.
+ *	Take the details and register an interrupt handler that will do a call-
+ *	back to the user supplied function. wiringPiISR2 hands the pin, edge
+ *	and kernel timestamp of the event plus a user pointer to the function.
+ *	A handler already active on the pin is stopped and replaced.
  *********************************************************************************
  */
 
-int wiringPiISR (int pin, int mode, void (*function)(void))
+static int isrRegister (int pin, int mode, void (*function)(void), void (*function2)(struct WPIWfiStatus, void *), void *userdata, struct wpiEdgeRingStruct *ring)
 {
   const int maxpin = GetMaxPin();
+  struct epoll_event ev ;
+  int gpio ;
 
   if (pin < 0 || pin > maxpin)
     return wiringPiFailure (WPI_FATAL, "wiringPiISR: pin must be 0-%d (%d)\n", maxpin, pin) ;
@@ -2793,42 +3959,60 @@ int wiringPiISR (int pin, int mode, void (*function)(void))
   if (wiringPiDebug) {
     printf ("wiringPi: wiringPiISR pin %d, mode %d\n", pin, mode) ;
   }
-  if (isrFunctions [pin]) {
-    printf ("wiringPi: ISR function alread active, ignoring \n") ;
+  if ((gpio = isrPinToGpio (pin)) < 0) {
+    edgeRingFree (ring) ;
+    return wiringPiFailure (WPI_ALMOST, "wiringPiISR: pin %d is not connected to a GPIO\n", pin) ;
+  }
+  if (isrFunctions [gpio] || isrFunctions2 [gpio] || isrRings [gpio]) {
+    fprintf (stderr, "wiringPi: ISR on pin %d already active, replacing it\n", pin) ;
+    waitForInterruptClose (pin) ;
   }
 
-  isrFunctions [pin] = function ;
-  isrMode[pin] = mode;
-  if(waitForInterruptInit (pin, mode)<0) {
+  if(isrLineRequest (pin, mode, ring ? ring->size : 0)<0) {
     if (wiringPiDebug) {
       fprintf (stderr, "wiringPi: waitForInterruptInit failed\n") ;
     }
-  };
-
-  if (wiringPiDebug) {
-    printf ("wiringPi: mutex in\n") ;
+    edgeRingFree (ring) ;
+    return -1 ;
   }
-  pthread_mutex_lock (&pinMutex) ;
-    pinPass = pin ;
-    if (wiringPiDebug) {
-      printf("wiringPi: pthread_create before 0x%lX\n", (unsigned long)isrThreads[pin]);
-    }
-    if (pthread_create (&isrThreads[pin], NULL, interruptHandler, NULL)==0) {
-      if (wiringPiDebug) {
-        printf("wiringPi: pthread_create successed, 0x%lX\n", (unsigned long)isrThreads[pin]);
+
+  pthread_mutex_lock (&isrMutex) ;
+    isrFunctions  [gpio] = function ;
+    isrFunctions2 [gpio] = function2 ;
+    isrUserdata   [gpio] = userdata ;
+    isrRings      [gpio] = ring ;
+
+    if (isrEpollFd < 0) {
+      if ((isrEpollFd = epoll_create1 (EPOLL_CLOEXEC)) < 0) {
+        pthread_mutex_unlock (&isrMutex) ;
+        fprintf (stderr, "wiringPi: ERROR: epoll_create1 failed (%s)\n", strerror (errno)) ;
+        waitForInterruptClose (pin) ;
+        return -1 ;
       }
-      while (pinPass != -1)
-        delay (1) ;
-    } else {
+      if (pthread_create (&isrThread, NULL, interruptDispatcher, NULL) != 0) {
+        close (isrEpollFd) ;
+        isrEpollFd = -1 ;
+        pthread_mutex_unlock (&isrMutex) ;
+        fprintf (stderr, "wiringPi: ERROR: pthread_create failed\n") ;
+        waitForInterruptClose (pin) ;
+        return -1 ;
+      }
+      pthread_detach (isrThread) ;
       if (wiringPiDebug) {
-        printf("wiringPi: pthread_create failed\n");
+        printf("wiringPi: interrupt dispatcher started, 0x%lX\n", (unsigned long)isrThread);
       }
     }
 
-    if (wiringPiDebug) {
-      printf ("wiringPi: mutex out\n") ;
+    ZeroMemory(&ev, sizeof(ev));
+    ev.events   = EPOLLIN ;
+    ev.data.u32 = gpio ;
+    if (epoll_ctl (isrEpollFd, EPOLL_CTL_ADD, isrFds [gpio], &ev) < 0) {
+      pthread_mutex_unlock (&isrMutex) ;
+      fprintf (stderr, "wiringPi: ERROR: epoll_ctl add pin %d failed (%s)\n", pin, strerror (errno)) ;
+      waitForInterruptClose (pin) ;
+      return -1 ;
     }
-  pthread_mutex_unlock (&pinMutex) ;
+  pthread_mutex_unlock (&isrMutex) ;
 
   if (wiringPiDebug) {
     printf ("wiringPi: wiringPiISR finished\n") ;
@@ -2836,6 +4020,296 @@ int wiringPiISR (int pin, int mode, void (*function)(void))
   return 0 ;
 }
 
+int wiringPiISR (int pin, int mode, void (*function)(void))
+{
+  return isrRegister (pin, mode, function, NULL, NULL, NULL) ;
+}
+
+int wiringPiISR2 (int pin, int mode, void (*function)(struct WPIWfiStatus wfiStatus, void *userdata), unsigned long debounce_period_us, void *userdata)
+{
+  int gpio ;
+
+  if ((gpio = isrPinToGpio (pin)) >= 0)
+    isrDebounce [gpio] = debounce_period_us ;
+  return isrRegister (pin, mode, NULL, function, userdata, NULL) ;
+}
+
+
+/*
+ * wiringPiSetDebounce:
+ *	Pi Specific.
+ *	Debounce period of the edges of a pin for wiringPiISR, wiringPiISR2,
+ *	wiringPiEdgeCapture and waitForInterruptInit, 0 turns it off. The
+ *	kernel filters the edges, so bounces never wake the program; kernels
+ *	without debounce support get a timestamp filter in the dispatcher.
+ *	An active interrupt line is reconfigured in place.
+ *********************************************************************************
+ */
+
+int wiringPiSetDebounce (int pin, unsigned long debounce_period_us)
+{
+  struct gpio_v2_line_config config ;
+  int gpio ;
+
+  if ((gpio = isrPinToGpio (pin)) < 0)
+    return -1 ;
+
+  isrDebounce [gpio] = debounce_period_us ;
+  if (isrFds [gpio] < 0)
+    return 0 ;		// used with the next request
+
+  if (isrLineConfig (gpio, isrMode [gpio], TRUE, &config) < 0)
+    return -1 ;
+  if (ioctl (isrFds [gpio], GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) == 0) {
+    isrSoftDebounce [gpio] = 0 ;
+  } else {
+    if (wiringPiDebug) {
+      printf ("wiringPi: GPIO line %d without kernel debounce, using software filter\n", gpio) ;
+    }
+    isrSoftDebounce [gpio] = (uint64_t)debounce_period_us * 1000 ;
+  }
+  return 0 ;
+}
+
+
+/*
+ * wiringPiEdgeCapture:
+ *	Pi Specific.
+ *	Capture the edges of a pin into a ring of (at least) depth entries
+ *	instead of calling a function. The edges are fetched in batches with
+ *	wiringPiEdgeRead, wiringPiISRStop ends the capture.
+ *********************************************************************************
+ */
+
+int wiringPiEdgeCapture (int pin, int mode, unsigned int depth)
+{
+  struct wpiEdgeRingStruct *ring ;
+  unsigned int size = 16 ;
+
+  if (depth > (1u << 20))
+    return wiringPiFailure (WPI_ALMOST, "wiringPiEdgeCapture: depth %u too large\n", depth) ;
+  while (size < depth)
+    size <<= 1 ;
+
+  if ((ring = calloc (1, sizeof (*ring))) == NULL)
+    return wiringPiFailure (WPI_ALMOST, "wiringPiEdgeCapture: out of memory\n") ;
+  ring->size   = size ;
+  ring->users  = 1 ;
+  ring->events = calloc (size, sizeof (struct WPIEdgeEvent)) ;
+  ring->eventFd = eventfd (0, EFD_CLOEXEC | EFD_NONBLOCK) ;
+  if (ring->events == NULL || ring->eventFd < 0) {
+    if (ring->eventFd < 0)
+      ring->eventFd = -1 ;
+    free (ring->events) ;
+    free (ring) ;
+    return wiringPiFailure (WPI_ALMOST, "wiringPiEdgeCapture: unable to allocate ring (%s)\n", strerror (errno)) ;
+  }
+
+  return isrRegister (pin, mode, NULL, NULL, NULL, ring) ;
+}
+
+
+/*
+ * wiringPiEdgeRead:
+ *	Take up to maxEvents edges out of the capture ring of a pin. If the
+ *	ring is empty wait up to mS milliseconds (-1 forever) for the next
+ *	batch. Returns the number of edges, 0 on timeout, -1 on error or
+ *	when wiringPiISRStop ends the capture while waiting.
+ *	Only one thread may read a pin.
+ *********************************************************************************
+ */
+
+int wiringPiEdgeRead (int pin, struct WPIEdgeEvent *events, int maxEvents, int mS)
+{
+  struct wpiEdgeRingStruct *ring ;
+  struct pollfd polls ;
+  uint64_t signals ;
+  unsigned int head, tail ;
+  unsigned int deadline = millis () + mS ;
+  int count = 0, stopped = FALSE, wait ;
+
+  if ((pin = isrPinToGpio (pin)) < 0 || maxEvents <= 0)
+    return -1 ;
+
+  pthread_mutex_lock (&isrMutex) ;
+    if ((ring = isrRings [pin]) != NULL)
+      ++ring->users ;
+  pthread_mutex_unlock (&isrMutex) ;
+  if (ring == NULL)
+    return -1 ;
+
+  polls.fd     = ring->eventFd ;
+  polls.events = POLLIN ;
+
+  // the eventfd may hold a signal of edges already taken, so wait until
+  //	the ring has edges, the time is up or the capture is stopped
+  tail = ring->tail ;
+  for (;;) {
+    head = __atomic_load_n (&ring->head, __ATOMIC_ACQUIRE) ;
+    if (head != tail || mS == 0)
+      break ;
+
+    pthread_mutex_lock (&isrMutex) ;
+      stopped = (isrRings [pin] != ring) ;
+    pthread_mutex_unlock (&isrMutex) ;
+    if (stopped)
+      break ;
+
+    wait = mS ;
+    if (mS > 0) {
+      wait = (int)(deadline - millis ()) ;
+      if (wait <= 0)
+        break ;
+    }
+    polls.revents = 0 ;
+    if (poll (&polls, 1, wait) < 0) {
+      if (errno == EINTR)
+        continue ;
+      count = -1 ;
+      break ;
+    }
+    if (read (ring->eventFd, &signals, sizeof (signals)) < 0) {
+      // nothing signalled, timeout
+    }
+  }
+
+  if (count == 0) {
+    for ( ; count < maxEvents && tail != head ; ++count, ++tail)
+      events [count] = ring->events [tail & (ring->size - 1)] ;
+    __atomic_store_n (&ring->tail, tail, __ATOMIC_RELEASE) ;
+  }
+
+  pthread_mutex_lock (&isrMutex) ;
+    stopped = (isrRings [pin] != ring) ;
+    edgeRingPut (ring) ;
+  pthread_mutex_unlock (&isrMutex) ;
+  return (stopped && count == 0) ? -1 : count ;
+}
+
+
+/*
+ * wiringPiEdgeOverflow:
+ *	Number of edges of a captured pin that were lost so far
+ *********************************************************************************
+ */
+
+unsigned int wiringPiEdgeOverflow (int pin)
+{
+  unsigned int overflow = 0 ;
+
+  if ((pin = isrPinToGpio (pin)) < 0)
+    return 0 ;
+  pthread_mutex_lock (&isrMutex) ;
+    if (isrRings [pin] != NULL)
+      overflow = __atomic_load_n (&isrRings [pin]->overflow, __ATOMIC_RELAXED) ;
+  pthread_mutex_unlock (&isrMutex) ;
+  return overflow ;
+}
+
+
+/*
+ * ticksRead:
+ * ticksCalibrate:
+ *	Read the architectural counter and measure its frequency against
+ *	CLOCK_MONOTONIC_RAW. Each sample brackets the clock read between two
+ *	counter reads, the tightest of a few is used.
+ *********************************************************************************
+ */
+
+#ifdef	TICKS_COUNTER
+static inline uint64_t ticksRead (void)
+{
+#if defined(__aarch64__)
+  uint64_t val ;
+
+  __asm__ __volatile__ ("isb; mrs %0, cntvct_el0" : "=r" (val) :: "memory") ;
+  return val ;
+#else
+  uint32_t lo, hi ;
+
+  __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi)) ;
+  return ((uint64_t)hi << 32) | lo ;
+#endif
+}
+
+static inline uint64_t ticksScale (uint64_t ticks, uint64_t mult, int shift)
+{
+  return (uint64_t)(((unsigned __int128)ticks * mult) >> shift) ;
+}
+
+static int ticksAvailable (void)
+{
+#if defined(__aarch64__)
+  return TRUE ;			// the kernel enables EL0 access to the virtual counter
+#else
+  unsigned int eax, ebx, ecx, edx ;
+
+  if (!__get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx))
+    return FALSE ;
+  return (edx & (1 << 8)) != 0 ;	// invariant TSC
+#endif
+}
+
+static void ticksSample (uint64_t *ticks, struct timespec *ts)
+{
+  struct timespec t ;
+  uint64_t c0, c1, best = UINT64_MAX ;
+  int i ;
+
+  for (i = 0 ; i < 5 ; ++i)
+  {
+    c0 = ticksRead () ;
+    clock_gettime (CLOCK_MONOTONIC_RAW, &t) ;
+    c1 = ticksRead () ;
+    if (c1 - c0 < best)
+    {
+      best   = c1 - c0 ;
+      *ticks = c0 + (c1 - c0) / 2 ;
+      *ts    = t ;
+    }
+  }
+}
+
+static void ticksCalibrate (uint64_t *ticks, struct timespec *ts)
+{
+  struct timespec ts1 ;
+  uint64_t ticks1, ns ;
+
+  ticksSample (ticks, ts) ;
+  if (!ticksAvailable () || (getenv (ENV_KERNELTIME) != NULL))
+    return ;
+
+  do
+  {
+    ticksSample (&ticks1, &ts1) ;
+    ns = (uint64_t)(ts1.tv_sec - ts->tv_sec) * 1000000000ULL + ts1.tv_nsec - ts->tv_nsec ;
+  } while (ns < TICKS_CALIBRATE_NS) ;
+
+  ticksFreq = (uint64_t)(((unsigned __int128)(ticks1 - *ticks) * 1000000000ULL) / ns) ;
+#if defined(__aarch64__)
+  {
+    uint64_t cntfrq ;
+
+    __asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (cntfrq)) ;
+    if ((cntfrq != 0) && (ticksFreq > cntfrq - cntfrq / 100) && (ticksFreq < cntfrq + cntfrq / 100))
+      ticksFreq = cntfrq ;		// nominal frequency is exact, the measurement is not
+  }
+#endif
+  if (ticksFreq == 0)
+    return ;
+
+  ticksMultNs = (uint64_t)(((unsigned __int128)1000000000ULL << TICKS_SHIFT_NS) / ticksFreq) ;
+  ticksMultUs = (uint64_t)(((unsigned __int128)1000000ULL    << TICKS_SHIFT_US) / ticksFreq) ;
+  ticksMultMs = (uint64_t)(((unsigned __int128)1000ULL       << TICKS_SHIFT_MS) / ticksFreq) ;
+  *ticks      = ticks1 ;
+  *ts         = ts1 ;
+  ticksFast   = TRUE ;
+
+  if (wiringPiDebug)
+    printf ("wiringPi: fast time source %llu Hz\n", (unsigned long long)ticksFreq) ;
+}
+#endif
+
 
 /*
  * initialiseEpoch:
@@ -2855,7 +4329,11 @@ static void initialiseEpoch (void)
 #else
   struct timespec ts ;
 
+#ifdef	TICKS_COUNTER
+  ticksCalibrate (&epochTicks, &ts) ;
+#else
   clock_gettime (CLOCK_MONOTONIC_RAW, &ts) ;
+#endif
   epochMilli = (uint64_t)ts.tv_sec * (uint64_t)1000    + (uint64_t)(ts.tv_nsec / 1000000L) ;
   epochMicro = (uint64_t)ts.tv_sec * (uint64_t)1000000 + (uint64_t)(ts.tv_nsec /    1000L) ;
 #endif
@@ -2886,46 +4364,123 @@ void delay (unsigned int howLong)
  *	obeying the standards (may take longer), it's not always what we
  *	want!
  *
- *	So what I'll do now is if the delay is less than 100uS we'll do it
- *	in a hard loop, watching a built-in counter on the ARM chip. This is
- *	somewhat sub-optimal in that it uses 100% CPU, something not an issue
- *	in a microcontroller, but under a multi-tasking, multi-user OS, it's
- *	wastefull, however we've no real choice )-:
- *
- *      Plan B: It seems all might not be well with that plan, so changing it
- *      to use gettimeofday () and poll on that instead...
+ *	So the delay sleeps to an absolute CLOCK_MONOTONIC deadline minus the
+ *	wake up latency of this machine and only spins the rest. The latency
+ *	is measured at setup (delayMicrosecondsCalibrate), delays shorter than
+ *	it are spun completely. Unlike gettimeofday the monotonic clock does
+ *	not jump with NTP.
  *********************************************************************************
  */
 
-void delayMicrosecondsHard (unsigned int howLong)
+#define	DELAY_CALIBRATE_LOOPS	16
+#define	DELAY_CALIBRATE_NS	50000
+#define	DELAY_SPIN_MIN_NS	2000
+#define	DELAY_SPIN_MAX_NS	200000
+
+static int            delaySpinNs = -1 ;	// not calibrated, read by other threads
+static pthread_once_t delayCalibrated = PTHREAD_ONCE_INIT ;
+
+static int64_t delayNowNs (void)
 {
-  struct timeval tNow, tLong, tEnd ;
+  struct timespec ts ;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts) ;
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec ;
+}
 
-  gettimeofday (&tNow, NULL) ;
-  tLong.tv_sec  = howLong / 1000000 ;
-  tLong.tv_usec = howLong % 1000000 ;
-  timeradd (&tNow, &tLong, &tEnd) ;
+static void delaySleepUntil (int64_t deadline)
+{
+  struct timespec ts ;
 
-  while (timercmp (&tNow, &tEnd, <))
-    gettimeofday (&tNow, NULL) ;
+  ts.tv_sec  = (time_t)(deadline / 1000000000LL) ;
+  ts.tv_nsec = (long)(deadline % 1000000000LL) ;
+  while (clock_nanosleep (CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    ;
 }
 
-void delayMicroseconds (unsigned int howLong)
+static void delaySpinUntil (int64_t deadline)
 {
-  struct timespec sleeper ;
-  unsigned int uSecs = howLong % 1000000 ;
-  unsigned int wSecs = howLong / 1000000 ;
+  while (delayNowNs () < deadline)
+    ;
+}
 
-  /**/ if (howLong ==   0)
-    return ;
-  else if (howLong  < 100)
-    delayMicrosecondsHard (howLong) ;
-  else
+/*
+ * delayMicrosecondsCalibrate:
+ * delayMicrosecondsSpin:
+ *	Measure the wake up latency, get the measured one. The first delay
+ *	before setup calibrates once, the soft engines take the value.
+ *********************************************************************************
+ */
+
+unsigned int delayMicrosecondsCalibrate (void)
+{
+  int64_t late [DELAY_CALIBRATE_LOOPS], deadline, tmp ;
+  int i, j ;
+
+  for (i = 0 ; i < DELAY_CALIBRATE_LOOPS ; ++i)
+  {
+    deadline = delayNowNs () + DELAY_CALIBRATE_NS ;
+    delaySleepUntil (deadline) ;
+    late [i] = delayNowNs () - deadline ;
+  }
+  for (i = 1 ; i < DELAY_CALIBRATE_LOOPS ; ++i)		// insertion sort, few values
+  {
+    tmp = late [i] ;
+    for (j = i ; (j > 0) && (late [j - 1] > tmp) ; --j)
+      late [j] = late [j - 1] ;
+    late [j] = tmp ;
+  }
+
+  tmp = late [DELAY_CALIBRATE_LOOPS - 2] ;		// worst but one, ignore a single outlier
+  if (tmp < DELAY_SPIN_MIN_NS)
+    tmp = DELAY_SPIN_MIN_NS ;
+  if (tmp > DELAY_SPIN_MAX_NS)
+    tmp = DELAY_SPIN_MAX_NS ;
+  __atomic_store_n (&delaySpinNs, (int)tmp, __ATOMIC_RELAXED) ;
+
+  if (wiringPiDebug)
+    printf ("wiringPi: delayMicroseconds wake up latency %lld ns (median %lld ns)\n",
+      (long long int)tmp, (long long int)late [DELAY_CALIBRATE_LOOPS / 2]) ;
+
+  return (unsigned int)tmp ;
+}
+
+static void delayCalibrateOnce (void)
+{
+  if (__atomic_load_n (&delaySpinNs, __ATOMIC_RELAXED) < 0)
+    delayMicrosecondsCalibrate () ;
+}
+
+unsigned int delayMicrosecondsSpin (void)
+{
+  int spin = __atomic_load_n (&delaySpinNs, __ATOMIC_RELAXED) ;
+
+  if (spin < 0)
   {
-    sleeper.tv_sec  = wSecs ;
-    sleeper.tv_nsec = (long)(uSecs * 1000L) ;
-    nanosleep (&sleeper, NULL) ;
+    pthread_once (&delayCalibrated, delayCalibrateOnce) ;
+    spin = __atomic_load_n (&delaySpinNs, __ATOMIC_RELAXED) ;
   }
+  return (unsigned int)spin ;
+}
+
+void delayMicrosecondsHard (unsigned int howLong)
+{
+  delaySpinUntil (delayNowNs () + (int64_t)howLong * 1000) ;
+}
+
+void delayMicroseconds (unsigned int howLong)
+{
+  int64_t deadline, spin ;
+
+  if (howLong == 0)
+    return ;
+
+  deadline = delayNowNs () + (int64_t)howLong * 1000 ;
+  spin     = delayMicrosecondsSpin () ;
+
+  if ((int64_t)howLong * 1000 > spin)
+    delaySleepUntil (deadline - spin) ;
+  delaySpinUntil (deadline) ;
 }
 
 
@@ -2940,6 +4495,11 @@ unsigned int millis (void)
 {
   uint64_t now ;
 
+#ifdef	TICKS_COUNTER
+  if (ticksFast)
+    return (uint32_t)ticksScale (ticksRead () - epochTicks, ticksMultMs, TICKS_SHIFT_MS) ;
+#endif
+
 #ifdef	OLD_WAY
   struct timeval tv ;
 
@@ -2967,6 +4527,12 @@ unsigned int millis (void)
 unsigned int micros (void)
 {
   uint64_t now ;
+
+#ifdef	TICKS_COUNTER
+  if (ticksFast)
+    return (uint32_t)ticksScale (ticksRead () - epochTicks, ticksMultUs, TICKS_SHIFT_US) ;
+#endif
+
 #ifdef	OLD_WAY
   struct timeval tv ;
 
@@ -2987,11 +4553,55 @@ unsigned int micros (void)
 unsigned long long piMicros64(void) {
   struct  timespec ts;
 
+#ifdef	TICKS_COUNTER
+  if (ticksFast)
+    return ticksScale (ticksRead () - epochTicks, ticksMultUs, TICKS_SHIFT_US) ;
+#endif
+
   clock_gettime (CLOCK_MONOTONIC_RAW, &ts) ;
   uint64_t now  = (uint64_t)ts.tv_sec * (uint64_t)1000000 + (uint64_t)(ts.tv_nsec / 1000) ;
   return (now - epochMicro) ;
 }
 
+
+/*
+ * piTicks:
+ * piTicksToNs:
+ * piTicksFrequency:
+ *	Raw time stamps for measuring differences at the lowest cost. With the
+ *	fast time source (after setup) these are counter ticks, otherwise
+ *	nanoseconds of CLOCK_MONOTONIC_RAW.
+ *********************************************************************************
+ */
+
+unsigned long long piTicks (void)
+{
+  struct timespec ts ;
+
+#ifdef	TICKS_COUNTER
+  if (ticksFast)
+    return ticksRead () ;
+#endif
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &ts) ;
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec ;
+}
+
+unsigned long long piTicksToNs (unsigned long long ticks)
+{
+#ifdef	TICKS_COUNTER
+  if (ticksFast)
+    return ticksScale (ticks, ticksMultNs, TICKS_SHIFT_NS) ;
+#endif
+
+  return ticks ;
+}
+
+unsigned long long piTicksFrequency (void)
+{
+  return ticksFast ? ticksFreq : 1000000000ULL ;
+}
+
 /*
  * wiringPiVersion:
  *	Return our current version number
@@ -3011,6 +4621,9 @@ int wiringPiUserLevelAccess(void)
   const char* gpiomemModule = gpiomem_BCM;
 
   piBoard();
+  if (simRevision) {
+    return 1;
+  }
   if (piRP1Model()) {
     gpiomemModule = gpiomem_RP1;
   }
@@ -3078,6 +4691,9 @@ int wiringPiGlobalMemoryAccess(void)
   unsigned int BaseAddr, PWMAddr;
 
   piBoard();
+  if (simRevision) {
+    return 2;    // GPIO & PWM in the simulation image
+  }
   if (piRP1Model()) {
     GetRP1Memory(pciemem_RP1, sizeof(pciemem_RP1));
     gpiomemGlobal = pciemem_RP1;
@@ -3188,7 +4804,8 @@ int wiringPiSetup (void)
   const char* gpiomemModule = gpiomem_BCM;
 
   if (piRP1Model()) {
-    GetRP1Memory();
+    if (!simRevision)
+      GetRP1Memory();
     gpiomemGlobal = pciemem_RP1;
     gpiomemModule = gpiomem_RP1;
 
@@ -3205,7 +4822,14 @@ int wiringPiSetup (void)
   }
 
   usingGpioMem = FALSE;
-  if (gpiomemGlobal==NULL || (fd = open (gpiomemGlobal, O_RDWR | O_SYNC | O_CLOEXEC)) < 0)
+  if (simRevision)
+  {
+    if ((fd = simImageOpen ()) < 0)
+      return wiringPiFailure (WPI_ALMOST, "wiringPiSetup: Unable to open the simulation image %s: %s\n",
+        simImageFile ? simImageFile : "(anonymous)", strerror (errno)) ;
+    gpiomemGlobal = simImageFile ? simImageFile : "(simulation)" ;
+  }
+  else if (gpiomemGlobal==NULL || (fd = open (gpiomemGlobal, O_RDWR | O_SYNC | O_CLOEXEC)) < 0)
   {
     if (wiringPiDebug) {
       printf ("wiringPi: no access to %s try %s\n", gpiomemGlobal, gpiomemModule) ;
@@ -3227,12 +4851,15 @@ int wiringPiSetup (void)
 //	GPIO:
  if (!piRP1Model()) {
    //Set the offsets into the memory interface.
+   //	The simulation image starts at the peripheral base.
 
-    GPIO_PADS 	= piGpioBase + 0x00100000 ;
-    GPIO_CLOCK_ADR = piGpioBase + 0x00101000 ;
-    GPIO_BASE	  = piGpioBase + 0x00200000 ;
-    GPIO_TIMER	= piGpioBase + 0x0000B000 ;
-    GPIO_PWM	  = piGpioBase + 0x0020C000 ;
+    unsigned int periBase = simRevision ? 0 : piGpioBase ;
+
+    GPIO_PADS 	= periBase + 0x00100000 ;
+    GPIO_CLOCK_ADR = periBase + 0x00101000 ;
+    GPIO_BASE	  = periBase + 0x00200000 ;
+    GPIO_TIMER	= periBase + 0x0000B000 ;
+    GPIO_PWM	  = periBase + 0x0020C000 ;
     GPIO_RIO    = 0x00 ;
 
 // Map the individual hardware components
@@ -3329,7 +4956,12 @@ int wiringPiSetup (void)
     printf ("wiringPi: memory map timer  0x%x %s\n", GPIO_TIMER    ,_wiringPiTimer ? "valid" : "invalid");
   }
 
+  if (simRevision)
+    simUpdate () ;
+
   initialiseEpoch () ;
+  delayMicrosecondsCalibrate () ;
+  pinDescResolveAll () ;
 
   return 0 ;
 }
@@ -3352,6 +4984,7 @@ int wiringPiSetupGpio (void)
     printf ("wiringPi: wiringPiSetupGpio called\n") ;
 
   wiringPiMode = WPI_MODE_GPIO ;
+  pinDescResolveAll () ;
 
   return 0 ;
 }
@@ -3374,6 +5007,7 @@ int wiringPiSetupPhys (void)
     printf ("wiringPi: wiringPiSetupPhys called\n") ;
 
   wiringPiMode = WPI_MODE_PHYS ;
+  pinDescResolveAll () ;
 
   return 0 ;
 }
@@ -3416,6 +5050,7 @@ int wiringPiSetupGpioDevice (enum WPIPinType pinType) {
   }
 
   initialiseEpoch () ;
+  delayMicrosecondsCalibrate () ;
 
   switch (pinType) {
     case WPI_PIN_BCM:
@@ -3431,6 +5066,7 @@ int wiringPiSetupGpioDevice (enum WPIPinType pinType) {
       wiringPiSetuped = FALSE;
       return -1;
   }
+  pinDescResolveAll () ;
 
   return 0 ;
 }
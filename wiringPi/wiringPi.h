@@ -159,10 +159,11 @@ extern const int   piMemorySize    [ 8] ;
 // wiringPiNodeStruct:
 //	This describes additional device nodes in the extended wiringPi
 //	2.0 scheme of things.
-//	It's a simple linked list for now, but will hopefully migrate to
-//	a binary tree for efficiency reasons - but then again, the chances
-//	of more than 1 or 2 devices being added are fairly slim, so who
-//	knows....
+//	It's a simple linked list, wiringPiFindNode uses a page table
+//	indexed by the pin number so the lookup time doesn't depend on
+//	the number of nodes.
+
+struct wiringPiRegmap ;
 
 struct wiringPiNodeStruct
 {
@@ -178,14 +179,27 @@ struct wiringPiNodeStruct
            void   (*pinMode)          (struct wiringPiNodeStruct *node, int pin, int mode) ;
            void   (*pullUpDnControl)  (struct wiringPiNodeStruct *node, int pin, int mode) ;
            int    (*digitalRead)      (struct wiringPiNodeStruct *node, int pin) ;
-//unsigned int    (*digitalRead8)     (struct wiringPiNodeStruct *node, int pin) ;
            void   (*digitalWrite)     (struct wiringPiNodeStruct *node, int pin, int value) ;
-//         void   (*digitalWrite8)    (struct wiringPiNodeStruct *node, int pin, int value) ;
            void   (*pwmWrite)         (struct wiringPiNodeStruct *node, int pin, int value) ;
            int    (*analogRead)       (struct wiringPiNodeStruct *node, int pin) ;
            void   (*analogWrite)      (struct wiringPiNodeStruct *node, int pin, int value) ;
 
   struct wiringPiNodeStruct *next ;
+
+  struct wiringPiRegmap     *regmap ;	// Register cache, wiringPiRegmap.h, Interface V3.15
+
+// Whole port: bits pins from pin on, bit n is pin + n. NULL: pin by pin, Interface V3.15
+
+  unsigned int (*digitalReadPort)  (struct wiringPiNodeStruct *node, int pin, int bits) ;
+          void (*digitalWritePort) (struct wiringPiNodeStruct *node, int pin, int bits, unsigned int value, unsigned int mask) ;
+
+// Write combining, wiringPiNodeBegin/Commit, Interface V3.15. While batch is set
+//	writes only change the shadow registers, flush writes the dirty ones.
+//	Nodes with a regmap are deferred there and need no flush.
+
+  int           batch ;
+  unsigned int  dirty ;		// Node specific
+           int (*flush) (struct wiringPiNodeStruct *node) ;
 } ;
 
 extern struct wiringPiNodeStruct *wiringPiNodes ;
@@ -198,6 +212,7 @@ extern volatile unsigned int *_wiringPiClk ;
 extern volatile unsigned int *_wiringPiPads ;
 extern volatile unsigned int *_wiringPiTimer ;
 extern volatile unsigned int *_wiringPiTimerIrqRaw ;
+extern volatile unsigned int *_wiringPiRio ;
 
 
 // Function prototypes
@@ -218,6 +233,8 @@ extern int wiringPiFailure (int fatal, const char *message, ...) ;
 
 extern struct wiringPiNodeStruct *wiringPiFindNode (int pin) ;
 extern struct wiringPiNodeStruct *wiringPiNewNode  (int pinBase, int numPins) ;
+extern void wiringPiNodeBegin  (void) ;	// Interface V3.15
+extern int  wiringPiNodeCommit (void) ;	// Interface V3.15
 
 enum WPIPinType {
   WPI_PIN_BCM = 1,
@@ -263,6 +280,8 @@ extern          int  digitalRead         (int pin) ;
 extern          void digitalWrite        (int pin, int value) ;
 extern unsigned int  digitalRead8        (int pin) ;
 extern          void digitalWrite8       (int pin, int value) ;
+extern unsigned int  digitalReadPort     (int pin, int bits) ;                                        // Interface V3.15
+extern          void digitalWritePort    (int pin, int bits, unsigned int value, unsigned int mask) ; // Interface V3.15
 extern          void pwmWrite            (int pin, int value) ;
 extern          int  analogRead          (int pin) ;
 extern          void analogWrite         (int pin, int value) ;
@@ -295,14 +314,55 @@ extern unsigned int  digitalReadByte2    (void) ;
 extern          void digitalWriteByte    (int value) ;
 extern          void digitalWriteByte2   (int value) ;
 
+// Bank (32 GPIO) access, masks use BCM GPIO numbers: bit n = GPIO bank*32+n
+
+extern          int  digitalPinToBank    (int pin) ;                // Interface V3.15
+extern unsigned int  digitalPinToBitMask (int pin) ;                // Interface V3.15
+extern          void digitalWriteMask    (int bank, unsigned int setMask, unsigned int clrMask) ; // Interface V3.15
+extern unsigned int  digitalReadBank     (int bank) ;               // Interface V3.15
+
 // Interrupts
 //	(Also Pi hardware specific)
 
+struct WPIWfiStatus {
+  int          statusOK ;	// -1: error, 0: timeout, 1: edge
+  unsigned int pinBCM ;		// BCM_GPIO pin of the event
+  int          edge ;		// INT_EDGE_FALLING or INT_EDGE_RISING
+  long long int timeStamp_ns ;	// Kernel timestamp, CLOCK_MONOTONIC
+} ;
+
+struct WPIEdgeEvent {
+  long long int timeStamp_ns ;	// Kernel timestamp, CLOCK_MONOTONIC
+  unsigned int  seqno ;		// Kernel sequence number of the edge on this pin
+  int           edge ;		// INT_EDGE_FALLING or INT_EDGE_RISING
+} ;
+
 extern int  waitForInterrupt    (int pin, int mS) ;
 extern int  wiringPiISR         (int pin, int mode, void (*function)(void)) ;
+extern int  wiringPiISR2        (int pin, int mode, void (*function)(struct WPIWfiStatus wfiStatus, void *userdata), unsigned long debounce_period_us, void *userdata) ; // Interface V3.15
+extern int  wiringPiSetDebounce (int pin, unsigned long debounce_period_us) ; // Interface V3.15
 extern int  wiringPiISRStop     (int pin) ;  //V3.2
+extern int  wiringPiEdgeCapture (int pin, int mode, unsigned int depth) ;                       // Interface V3.15
+extern int  wiringPiEdgeRead    (int pin, struct WPIEdgeEvent *events, int maxEvents, int mS) ; // Interface V3.15
+extern unsigned int wiringPiEdgeOverflow (int pin) ;                                            // Interface V3.15
 extern int  waitForInterruptClose(int pin) ; //V3.2
 
+// Simulation
+//	The registers live in a memory image instead of the hardware,
+//	so wiringPi runs without a Raspberry Pi (testing, benchmarks)
+
+struct WPISimWrite {
+  long long int timeStamp_ns ;	// CLOCK_MONOTONIC
+  unsigned int  bank ;		// GPIO bank (32 BCM_GPIO pins)
+  unsigned int  level ;		// Output latch of the bank after the write
+  unsigned int  changed ;	// Pins changed by the write
+} ;
+
+extern int  wiringPiSimSetup    (unsigned int revision, const char *imageFile, int logDepth) ; // Interface V3.15
+extern int  wiringPiSimActive   (void) ;                                    // Interface V3.15
+extern void wiringPiSimInput    (int bcmPin, int value) ;                   // Interface V3.15
+extern int  wiringPiSimLog      (struct WPISimWrite *entries, int maxEntries) ; // Interface V3.15
+
 // Threads
 
 extern int  piThreadCreate      (void *(*fn)(void *)) ;
@@ -317,10 +377,15 @@ extern int piHiPri (const int pri) ;
 
 extern void         delay             (unsigned int howLong) ;
 extern void         delayMicroseconds (unsigned int howLong) ;
+extern unsigned int delayMicrosecondsCalibrate (void) ;     // Interface V3.15
+extern unsigned int delayMicrosecondsSpin      (void) ;     // Interface V3.15
 extern unsigned int millis            (void) ;
 extern unsigned int micros            (void) ;
 
 extern unsigned long long piMicros64(void);   // Interface V3.7
+extern unsigned long long piTicks         (void) ;                    // Interface V3.15
+extern unsigned long long piTicksToNs     (unsigned long long ticks) ; // Interface V3.15
+extern unsigned long long piTicksFrequency (void) ;                   // Interface V3.15
 
 #ifdef __cplusplus
 }
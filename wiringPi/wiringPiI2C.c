@@ -60,6 +60,7 @@
 // I2C definitions
 
 #define I2C_SLAVE	0x0703
+#define I2C_RDWR	0x0707	/* Combined R/W transfer (one STOP only) */
 #define I2C_SMBUS	0x0720	/* SMBus-level access */
 
 #define I2C_SMBUS_READ	1
@@ -99,6 +100,33 @@ struct i2c_smbus_ioctl_data
   union i2c_smbus_data *data ;
 } ;
 
+// I2C_RDWR messages, each one starts with a (repeated) start
+
+#define I2C_M_RD	0x0001
+#define I2C_M_NOSTART	0x4000
+#define I2C_MSG_MAX	8192	/* bytes per message, i2c-dev limit */
+
+struct i2c_msg
+{
+  uint16_t addr ;
+  uint16_t flags ;
+  uint16_t len ;
+  uint8_t *buf ;
+} ;
+
+struct i2c_rdwr_ioctl_data
+{
+  struct i2c_msg *msgs ;
+  uint32_t nmsgs ;
+} ;
+
+// Slave address of the descriptors opened here, I2C_RDWR needs it in every
+//	message. 0: unknown, else address + 1
+
+#define	I2C_MAX_FDS	1024
+
+static uint16_t i2cAddress [I2C_MAX_FDS] ;
+
 static inline int i2c_smbus_access (int fd, char rw, uint8_t command, int size, union i2c_smbus_data *data)
 {
   struct i2c_smbus_ioctl_data args ;
@@ -226,6 +254,94 @@ int wiringPiI2CRawWrite (int fd, const uint8_t *values, uint8_t size)
   return(write(fd, values, size));
 }
 
+/*
+ * wiringPiI2CTransaction:
+ *	Send a number of messages, writes and reads, to one or more devices
+ *	with a single I2C_RDWR ioctl: repeated starts between them, one stop at
+ *	the end, nothing else on the bus in between. Messages with addr < 0 go
+ *	to the device of the fd. No SMBus block limit, up to 8192 bytes each.
+ *	Returns the number of messages transferred.
+ *********************************************************************************
+ */
+
+int wiringPiI2CTransaction (int fd, const struct wiringPiI2CMsg *msgs, int count)
+{
+  struct i2c_msg msg [WPI_I2C_MAX_MSGS] ;
+  struct i2c_rdwr_ioctl_data args ;
+  int i, addr ;
+
+  if (count < 1 || count > WPI_I2C_MAX_MSGS || msgs == NULL)
+  {
+    fprintf (stderr, "wiringPiI2C: Invalid number of messages (%d, valid range 1-%d)\n", count, WPI_I2C_MAX_MSGS) ;
+    return -EINVAL ;
+  }
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    addr = msgs [i].addr ;
+    if (addr < 0)
+    {
+      if (fd < 0 || fd >= I2C_MAX_FDS || i2cAddress [fd] == 0)
+      {
+        fprintf (stderr, "wiringPiI2C: No device address for fd %d, set addr\n", fd) ;
+        return -EINVAL ;
+      }
+      addr = i2cAddress [fd] - 1 ;
+    }
+    if (addr > 0x7F || msgs [i].len < 0 || msgs [i].len > I2C_MSG_MAX || (msgs [i].len > 0 && msgs [i].buf == NULL))
+    {
+      fprintf (stderr, "wiringPiI2C: Invalid message %d (address 0x%02X, %d bytes)\n", i, addr, msgs [i].len) ;
+      return -EINVAL ;
+    }
+    msg [i].addr  = addr ;
+    msg [i].flags = msgs [i].flags & (WPI_I2C_READ | WPI_I2C_NOSTART) ;
+    msg [i].len   = msgs [i].len ;
+    msg [i].buf   = msgs [i].buf ;
+  }
+
+  args.msgs  = msg ;
+  args.nmsgs = count ;
+  if (ioctl (fd, I2C_RDWR, &args) < 0)
+    return -errno ;
+  return count ;
+}
+
+
+/*
+ * wiringPiI2CWriteRead:
+ *	Write wrLen bytes (e.g. the register pointer), then a repeated start
+ *	and read rdLen bytes, in one transaction. Either part may be empty.
+ *	Returns rdLen.
+ *********************************************************************************
+ */
+
+int wiringPiI2CWriteRead (int fd, const uint8_t *wr, int wrLen, uint8_t *rd, int rdLen)
+{
+  struct wiringPiI2CMsg msgs [2] ;
+  int count = 0, ret ;
+
+  if (wrLen > 0)
+  {
+    msgs [count].addr  = -1 ;
+    msgs [count].flags = 0 ;
+    msgs [count].buf   = (uint8_t *)wr ;
+    msgs [count].len   = wrLen ;
+    ++count ;
+  }
+  if (rdLen > 0)
+  {
+    msgs [count].addr  = -1 ;
+    msgs [count].flags = WPI_I2C_READ ;
+    msgs [count].buf   = rd ;
+    msgs [count].len   = rdLen ;
+    ++count ;
+  }
+  if ((ret = wiringPiI2CTransaction (fd, msgs, count)) < 0)
+    return ret ;
+  return rdLen ;
+}
+
+
 /*
  * wiringPiI2CSetupInterface:
  *	Undocumented access to set the interface explicitly - might be used
@@ -243,6 +359,9 @@ int wiringPiI2CSetupInterface (const char *device, int devId)
   if (ioctl (fd, I2C_SLAVE, devId) < 0)
     return wiringPiFailure (WPI_ALMOST, "Unable to select I2C device: %s\n", strerror (errno)) ;
 
+  if (fd < I2C_MAX_FDS)
+    i2cAddress [fd] = (devId & 0x7F) + 1 ;
+
   return fd ;
 }
 
@@ -267,3 +386,18 @@ int wiringPiI2CSetup (const int devId)
 
   return wiringPiI2CSetupInterface (device, devId) ;
 }
+
+
+/*
+ * wiringPiI2CClose:
+ *	Close a file handle of wiringPiI2CSetup, its device address is
+ *	forgotten, so a descriptor reusing the number can't send to it.
+ *********************************************************************************
+ */
+
+int wiringPiI2CClose (int fd)
+{
+  if (fd >= 0 && fd < I2C_MAX_FDS)
+    i2cAddress [fd] = 0 ;
+  return close (fd) ;
+}
@@ -40,8 +40,26 @@ extern int wiringPiI2CWriteReg16     (int fd, int reg, int data) ;
 extern int wiringPiI2CWriteBlockData (int fd, int reg, const uint8_t *values, uint8_t size);  //Interface 3.3
 extern int wiringPiI2CRawWrite       (int fd, const uint8_t *values, uint8_t size);           //Interface 3.3
 
+// Combined transactions with I2C_RDWR, Interface 3.15
+
+#define WPI_I2C_READ      0x0001   // read into buf, else write buf
+#define WPI_I2C_NOSTART   0x4000   // no repeated start before the message (if the adapter can)
+#define WPI_I2C_MAX_MSGS  42       // messages per transaction
+
+struct wiringPiI2CMsg
+{
+  int       addr ;    // 7 bit address, -1: the device of the fd
+  int       flags ;
+  uint8_t  *buf ;
+  int       len ;     // bytes, at most 8192
+} ;
+
+extern int wiringPiI2CTransaction    (int fd, const struct wiringPiI2CMsg *msgs, int count) ;
+extern int wiringPiI2CWriteRead      (int fd, const uint8_t *wr, int wrLen, uint8_t *rd, int rdLen) ;
+
 extern int wiringPiI2CSetupInterface (const char *device, int devId) ;
 extern int wiringPiI2CSetup          (const int devId) ;
+extern int wiringPiI2CClose          (int fd) ;                                          //Interface 3.15
 
 #ifdef __cplusplus
 }
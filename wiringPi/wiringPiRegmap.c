@@ -0,0 +1,481 @@
+/*
+ * wiringPiRegmap.c:
+ *	Register cache for the device nodes of I2C and SPI chips. Settings
+ *	registers are read from the device once and then from memory, writes
+ *	of an unchanged value skip the bus, deferred writes go out together
+ *	with wiringPiRegmapSync. Volatile registers (inputs, flags) always go
+ *	to the device. 8 bit registers.
+ *	Copyright (c) 2012-2024 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "wiringPiRegmap.h"
+
+#define	REGMAP_MAX	256
+
+#define	REG_VALID	0x01
+#define	REG_DIRTY	0x02
+#define	REG_VOLATILE	0x04
+
+// A block is the group of registers the chip transfers in one go, e.g.
+//	the A/B pairs of the MCP23x17 in byte mode: block 2
+
+struct wiringPiRegmap
+{
+  int                    regs ;
+  int                    block ;
+  int                    defer ;
+  wiringPiRegmapReadFn   readFn ;
+  wiringPiRegmapWriteFn  writeFn ;
+  void                  *ctx ;
+  uint8_t                value [REGMAP_MAX] ;
+  uint8_t                state [REGMAP_MAX] ;
+  struct wiringPiRegmapStats stats ;
+  pthread_mutex_t        lock ;
+} ;
+
+
+/*
+ * wiringPiRegmapNew:
+ *	A map of regs registers, nothing cached yet. block: registers one bus
+ *	transaction can read or write (aligned), 1 if the chip has no
+ *	sequential access.
+ *********************************************************************************
+ */
+
+struct wiringPiRegmap *wiringPiRegmapNew (int regs, int block,
+                                          wiringPiRegmapReadFn readFn, wiringPiRegmapWriteFn writeFn, void *ctx)
+{
+  struct wiringPiRegmap *map ;
+
+  if (regs < 1 || regs > REGMAP_MAX || block < 1 || readFn == NULL || writeFn == NULL)
+  {
+    fprintf (stderr, "wiringPiRegmapNew: Invalid map (%d registers, block %d)\n", regs, block) ;
+    return NULL ;
+  }
+  if ((map = calloc (1, sizeof (struct wiringPiRegmap))) == NULL)
+    return NULL ;
+
+  map->regs    = regs ;
+  map->block   = block ;
+  map->readFn  = readFn ;
+  map->writeFn = writeFn ;
+  map->ctx     = ctx ;
+  pthread_mutex_init (&map->lock, NULL) ;
+
+  return map ;
+}
+
+void wiringPiRegmapFree (struct wiringPiRegmap *map)
+{
+  if (map == NULL)
+    return ;
+  pthread_mutex_destroy (&map->lock) ;
+  free (map) ;
+}
+
+
+/*
+ * wiringPiRegmapVolatile:
+ *	Registers that change on their own (inputs, interrupt flags and
+ *	captures) are never cached.
+ *********************************************************************************
+ */
+
+void wiringPiRegmapVolatile (struct wiringPiRegmap *map, int reg, int count)
+{
+  pthread_mutex_lock (&map->lock) ;
+  for ( ; count > 0 && reg < map->regs ; --count, ++reg)
+    if (reg >= 0)
+      map->state [reg] = REG_VOLATILE ;
+  pthread_mutex_unlock (&map->lock) ;
+}
+
+
+/*
+ * loadBlock:
+ *	Read the aligned block of reg into the cache, one transaction. A block
+ *	with volatile registers in it is not read as a whole, reading them may
+ *	clear flags.
+ *********************************************************************************
+ */
+
+static int loadBlock (struct wiringPiRegmap *map, int reg)
+{
+  uint8_t values [REGMAP_MAX] ;
+  int start, count, i, ret ;
+
+  start = reg - (reg % map->block) ;
+  count = map->block ;
+  if (start + count > map->regs)
+    count = map->regs - start ;
+  for (i = start ; i < start + count ; ++i)
+    if (map->state [i] & REG_VOLATILE)
+    {
+      start = reg ;
+      count = 1 ;
+      break ;
+    }
+
+  if ((ret = map->readFn (map->ctx, start, values, count)) < 0)
+    return ret ;
+  ++map->stats.busReads ;
+
+  for (i = 0 ; i < count ; ++i)
+  {
+    if (map->state [start + i] & (REG_VOLATILE | REG_DIRTY))	// keep what is not written yet
+      continue ;
+    map->value [start + i]  = values [i] ;
+    map->state [start + i] |= REG_VALID ;
+  }
+  return values [reg - start] ;
+}
+
+
+/*
+ * readReg: writeReg:
+ *	Call with the map locked
+ *********************************************************************************
+ */
+
+static int readReg (struct wiringPiRegmap *map, int reg)
+{
+  if ((map->state [reg] & REG_VALID) && !(map->state [reg] & REG_VOLATILE))
+  {
+    ++map->stats.cacheHits ;
+    return map->value [reg] ;
+  }
+  return loadBlock (map, reg) ;
+}
+
+static int writeReg (struct wiringPiRegmap *map, int reg, int value)
+{
+  uint8_t byte = value ;
+  int ret ;
+
+  if (map->state [reg] & REG_VOLATILE)
+  {
+    if ((ret = map->writeFn (map->ctx, reg, &byte, 1)) < 0)
+      return ret ;
+    ++map->stats.busWrites ;
+    return 0 ;
+  }
+
+  if ((map->state [reg] & REG_VALID) && map->value [reg] == byte)
+  {
+    ++map->stats.skipped ;
+    return 0 ;
+  }
+
+  map->value [reg]  = byte ;
+  map->state [reg] |= REG_VALID ;
+  if (map->defer)
+  {
+    map->state [reg] |= REG_DIRTY ;
+    return 0 ;
+  }
+
+  if ((ret = map->writeFn (map->ctx, reg, &byte, 1)) < 0)
+  {
+    map->state [reg] &= ~REG_VALID ;	// the device may not have it
+    return ret ;
+  }
+  ++map->stats.busWrites ;
+  map->state [reg] &= ~REG_DIRTY ;
+  return 0 ;
+}
+
+
+/*
+ * wiringPiRegmapLoad:
+ *	Read registers from the device into the cache, a block per transaction,
+ *	e.g. at setup or after the chip was reset.
+ *********************************************************************************
+ */
+
+int wiringPiRegmapLoad (struct wiringPiRegmap *map, int reg, int count)
+{
+  int ret = 0 ;
+
+  if (reg < 0 || count < 0 || reg + count > map->regs)
+    return -EINVAL ;
+
+  pthread_mutex_lock (&map->lock) ;
+  while (count > 0 && ret >= 0)
+  {
+    int next = reg - (reg % map->block) + map->block ;
+
+    if (!(map->state [reg] & REG_VOLATILE))
+      ret = loadBlock (map, reg) ;
+    count -= next - reg ;
+    reg    = next ;
+  }
+  pthread_mutex_unlock (&map->lock) ;
+
+  return (ret < 0) ? ret : 0 ;
+}
+
+
+/*
+ * wiringPiRegmapRead: wiringPiRegmapWrite: wiringPiRegmapUpdate:
+ *	Read a register (from the cache if it can), write it (not if it has
+ *	the value already), change the bits in mask. Return the value or 0,
+ *	<0 on error.
+ *********************************************************************************
+ */
+
+int wiringPiRegmapRead (struct wiringPiRegmap *map, int reg)
+{
+  int ret ;
+
+  if (reg < 0 || reg >= map->regs)
+    return -EINVAL ;
+
+  pthread_mutex_lock (&map->lock) ;
+  ret = readReg (map, reg) ;
+  pthread_mutex_unlock (&map->lock) ;
+
+  return ret ;
+}
+
+int wiringPiRegmapWrite (struct wiringPiRegmap *map, int reg, int value)
+{
+  int ret ;
+
+  if (reg < 0 || reg >= map->regs)
+    return -EINVAL ;
+
+  pthread_mutex_lock (&map->lock) ;
+  ret = writeReg (map, reg, value) ;
+  pthread_mutex_unlock (&map->lock) ;
+
+  return ret ;
+}
+
+int wiringPiRegmapUpdate (struct wiringPiRegmap *map, int reg, int mask, int value)
+{
+  int ret ;
+
+  if (reg < 0 || reg >= map->regs)
+    return -EINVAL ;
+
+  pthread_mutex_lock (&map->lock) ;
+  if ((ret = readReg (map, reg)) >= 0)
+    ret = writeReg (map, reg, (ret & ~mask) | (value & mask)) ;
+  pthread_mutex_unlock (&map->lock) ;
+
+  return ret ;
+}
+
+
+/*
+ * wiringPiRegmapSync:
+ *	Write the registers changed while deferred, the ones in a block
+ *	together in one transaction.
+ *********************************************************************************
+ */
+
+static int syncRegs (struct wiringPiRegmap *map)
+{
+  int reg, end, i, ret ;
+
+  for (reg = 0 ; reg < map->regs ; )
+  {
+    if (!(map->state [reg] & REG_DIRTY))
+    {
+      ++reg ;
+      continue ;
+    }
+    end = reg + 1 ;
+    while (end < map->regs && (end % map->block) != 0 && (map->state [end] & REG_DIRTY))
+      ++end ;
+
+    if ((ret = map->writeFn (map->ctx, reg, &map->value [reg], end - reg)) < 0)
+      return ret ;
+    ++map->stats.busWrites ;
+    map->stats.coalesced += end - reg - 1 ;
+    for (i = reg ; i < end ; ++i)
+      map->state [i] &= ~REG_DIRTY ;
+    reg = end ;
+  }
+  return 0 ;
+}
+
+int wiringPiRegmapSync (struct wiringPiRegmap *map)
+{
+  int ret ;
+
+  pthread_mutex_lock (&map->lock) ;
+  ret = syncRegs (map) ;
+  pthread_mutex_unlock (&map->lock) ;
+
+  return ret ;
+}
+
+
+/*
+ * wiringPiRegmapReadBlock: wiringPiRegmapUpdateBlock:
+ *	Read count registers, or change the bits in mask of them, with one bus
+ *	transaction per block (volatile ones included), e.g. both ports of a
+ *	chip. Registers the cache has and unchanged values do not go to the
+ *	bus.
+ *********************************************************************************
+ */
+
+int wiringPiRegmapReadBlock (struct wiringPiRegmap *map, int reg, uint8_t *values, int count)
+{
+  int start, end, i, need, ret = 0 ;
+
+  if (reg < 0 || count < 1 || reg + count > map->regs || values == NULL)
+    return -EINVAL ;
+
+  pthread_mutex_lock (&map->lock) ;
+  for (start = reg ; start < reg + count && ret >= 0 ; start = end)
+  {
+    end = start - (start % map->block) + map->block ;
+    if (end > reg + count)
+      end = reg + count ;
+
+    need = 0 ;
+    for (i = start ; i < end ; ++i)
+      if ((map->state [i] & REG_VOLATILE) || !(map->state [i] & REG_VALID))
+        need = 1 ;
+
+    if (!need)
+    {
+      map->stats.cacheHits += end - start ;
+      memcpy (&values [start - reg], &map->value [start], end - start) ;
+      continue ;
+    }
+    if ((ret = map->readFn (map->ctx, start, &values [start - reg], end - start)) < 0)
+      break ;
+    ++map->stats.busReads ;
+    for (i = start ; i < end ; ++i)
+    {
+      if (map->state [i] & (REG_VOLATILE | REG_DIRTY))
+      {
+        if (map->state [i] & REG_DIRTY)		// not written yet, the cache is right
+          values [i - reg] = map->value [i] ;
+        continue ;
+      }
+      map->value [i]  = values [i - reg] ;
+      map->state [i] |= REG_VALID ;
+    }
+  }
+  pthread_mutex_unlock (&map->lock) ;
+
+  return (ret < 0) ? ret : 0 ;
+}
+
+int wiringPiRegmapUpdateBlock (struct wiringPiRegmap *map, int reg, const uint8_t *mask, const uint8_t *values, int count)
+{
+  int i, old, ret = 0 ;
+  uint8_t byte ;
+
+  if (reg < 0 || count < 1 || reg + count > map->regs || mask == NULL || values == NULL)
+    return -EINVAL ;
+
+  pthread_mutex_lock (&map->lock) ;
+  for (i = 0 ; i < count ; ++i)
+  {
+    if (mask [i] == 0)
+      continue ;
+    if ((old = readReg (map, reg + i)) < 0)
+    {
+      ret = old ;
+      break ;
+    }
+    byte = (old & ~mask [i]) | (values [i] & mask [i]) ;
+    if ((map->state [reg + i] & REG_VALID) && !(map->state [reg + i] & REG_VOLATILE) && byte == old)
+    {
+      ++map->stats.skipped ;
+      continue ;
+    }
+    map->value [reg + i]  = byte ;
+    map->state [reg + i] |= REG_DIRTY ;
+    if (!(map->state [reg + i] & REG_VOLATILE))
+      map->state [reg + i] |= REG_VALID ;
+  }
+  if (ret >= 0 && !map->defer)
+    ret = syncRegs (map) ;
+  pthread_mutex_unlock (&map->lock) ;
+
+  return (ret < 0) ? ret : 0 ;
+}
+
+
+/*
+ * wiringPiRegmapDefer:
+ *	While deferred, writes only go to the cache. Ending it syncs.
+ *********************************************************************************
+ */
+
+int wiringPiRegmapDefer (struct wiringPiRegmap *map, int defer)
+{
+  int ret = 0 ;
+
+  pthread_mutex_lock (&map->lock) ;
+  map->defer = defer ;
+  if (!defer)
+    ret = syncRegs (map) ;
+  pthread_mutex_unlock (&map->lock) ;
+
+  return ret ;
+}
+
+
+/*
+ * wiringPiRegmapInvalidate:
+ *	Forget the cache, e.g. after the chip was reset. Deferred writes are
+ *	dropped.
+ *********************************************************************************
+ */
+
+void wiringPiRegmapInvalidate (struct wiringPiRegmap *map)
+{
+  int reg ;
+
+  pthread_mutex_lock (&map->lock) ;
+  for (reg = 0 ; reg < map->regs ; ++reg)
+    map->state [reg] &= REG_VOLATILE ;
+  pthread_mutex_unlock (&map->lock) ;
+}
+
+
+/*
+ * wiringPiRegmapGetStats:
+ *********************************************************************************
+ */
+
+void wiringPiRegmapGetStats (struct wiringPiRegmap *map, struct wiringPiRegmapStats *stats, int reset)
+{
+  pthread_mutex_lock (&map->lock) ;
+  *stats = map->stats ;
+  if (reset)
+    memset (&map->stats, 0, sizeof (map->stats)) ;
+  pthread_mutex_unlock (&map->lock) ;
+}
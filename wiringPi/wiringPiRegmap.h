@@ -0,0 +1,67 @@
+/*
+ * wiringPiRegmap.h:
+ *	Register cache for the device nodes of I2C and SPI chips
+ *	Copyright (c) 2012-2024 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bus transactions of a map and what the cache saved
+
+struct wiringPiRegmapStats
+{
+  unsigned long long busReads ;		// read transactions
+  unsigned long long busWrites ;	// write transactions
+  unsigned long long cacheHits ;	// reads served from the cache
+  unsigned long long skipped ;		// writes of the value already in the register
+  unsigned long long coalesced ;	// register writes merged into another transaction
+} ;
+
+struct wiringPiRegmap ;
+
+// The bus functions read or write count registers from reg on in one
+//	transaction (count is at most the block size of the map), <0 on error
+
+typedef int (*wiringPiRegmapReadFn)  (void *ctx, int reg, uint8_t *values, int count) ;
+typedef int (*wiringPiRegmapWriteFn) (void *ctx, int reg, const uint8_t *values, int count) ;
+
+extern struct wiringPiRegmap *wiringPiRegmapNew (int regs, int block,
+                                                 wiringPiRegmapReadFn readFn, wiringPiRegmapWriteFn writeFn, void *ctx) ; // Interface V3.15
+extern void wiringPiRegmapFree       (struct wiringPiRegmap *map) ;                          // Interface V3.15
+extern void wiringPiRegmapVolatile   (struct wiringPiRegmap *map, int reg, int count) ;      // Interface V3.15
+extern int  wiringPiRegmapLoad       (struct wiringPiRegmap *map, int reg, int count) ;      // Interface V3.15
+extern int  wiringPiRegmapRead       (struct wiringPiRegmap *map, int reg) ;                 // Interface V3.15
+extern int  wiringPiRegmapWrite      (struct wiringPiRegmap *map, int reg, int value) ;      // Interface V3.15
+extern int  wiringPiRegmapUpdate     (struct wiringPiRegmap *map, int reg, int mask, int value) ; // Interface V3.15
+extern int  wiringPiRegmapReadBlock  (struct wiringPiRegmap *map, int reg, uint8_t *values, int count) ; // Interface V3.15
+extern int  wiringPiRegmapUpdateBlock (struct wiringPiRegmap *map, int reg, const uint8_t *mask, const uint8_t *values, int count) ; // Interface V3.15
+extern int  wiringPiRegmapDefer      (struct wiringPiRegmap *map, int defer) ;               // Interface V3.15
+extern int  wiringPiRegmapSync       (struct wiringPiRegmap *map) ;                          // Interface V3.15
+extern void wiringPiRegmapInvalidate (struct wiringPiRegmap *map) ;                          // Interface V3.15
+extern void wiringPiRegmapGetStats   (struct wiringPiRegmap *map, struct wiringPiRegmapStats *stats, int reset) ; // Interface V3.15
+
+#ifdef __cplusplus
+}
+#endif
@@ -30,11 +30,13 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
 #include <asm/ioctl.h>
 #include <linux/spi/spidev.h>
 #include "wiringPi.h"
 #include "wiringPiSPI.h"
+#include "softSpi.h"
 
 
 // The SPI bus parameters
@@ -71,6 +73,53 @@ static int         spiFds [7][3] =
  {-1, -1, -1},
 };
 
+// Mode set with SPI_IOC_WR_MODE in the spidev device (shared by all file
+//	descriptors of it) and the mode wiringPiSPIxSetupMode asked for
+
+static int         spiModes [7][3] =
+{
+ {-1, -1, -1},
+ {-1, -1, -1},
+ {-1, -1, -1},
+ {-1, -1, -1},
+ {-1, -1, -1},
+ {-1, -1, -1},
+ {-1, -1, -1},
+};
+
+static int         spiChannelModes [7][3] ;
+
+// One lock per bus, spidev and software buses, recursive so a thread
+//	holding it with wiringPiSPIxLockBus can still transfer
+
+#define	SPI_BUSES	(SOFT_SPI_LAST + 1)
+
+static pthread_mutex_t spiBusLocks [SPI_BUSES] ;
+static pthread_once_t  spiBusLocksOnce = PTHREAD_ONCE_INIT ;
+
+// Devices opened with wiringPiSPIxOpenDevice, the handle is the index
+
+struct spiDevice
+{
+  int          used ;
+  int          number, channel ;
+  int          fd ;			// own descriptor, -1 on software buses
+  int          mode ;
+  unsigned int speed ;
+  int          bitsPerWord ;
+  int          delay_us ;
+} ;
+
+static struct spiDevice spiDevices [WPI_SPI_MAX_DEVICES] ;
+static pthread_mutex_t  spiDeviceLock = PTHREAD_MUTEX_INITIALIZER ;
+
+// spidev takes at most bufsiz bytes per message (module parameter), longer
+//	transfers are cut into chunks, as many as fit go out in one message
+
+static const char *spiBufSizeFile = "/sys/module/spidev/parameters/bufsiz" ;
+static int         spiBufSize     = 0 ;		// 0: not read yet
+static int         spiChunkSize   = 0 ;		// 0: bufsiz
+
 
 int SPICheckLimits(const int number, const int channel) {
   if (channel<0 || channel>=WPI_MaxSPIChannels) {
@@ -88,6 +137,54 @@ int SPICheckLimits(const int number, const int channel) {
 
 #define RETURN_ON_LIMIT_FAIL int ret = SPICheckLimits(number, channel); if(ret!=0) { return ret; };
 
+// The single bus functions take wiringPiSPIChannel(number, channel), so
+//	0 and 1 are the channels of bus 0 as before
+
+#define SPI_NUMBER(c)  ((c) >= 0 ? (c) >> 4 : 0)
+#define SPI_CHANNEL(c) ((c) >= 0 ? (c) & 15 : (c))
+
+
+/*
+ * wiringPiSPIxLockBus:
+ * wiringPiSPIxUnlockBus:
+ *	Every transaction runs with the lock of its bus held, so threads using
+ *	different devices on one bus do not mix their transfers or settings.
+ *	Take it to run several transactions without other threads in between,
+ *	the calls nest.
+ *********************************************************************************
+ */
+
+static void spiBusLocksInit (void)
+{
+  pthread_mutexattr_t attr ;
+  int i ;
+
+  pthread_mutexattr_init    (&attr) ;
+  pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE) ;
+  for (i = 0 ; i < SPI_BUSES ; ++i)
+    pthread_mutex_init (&spiBusLocks [i], &attr) ;
+  pthread_mutexattr_destroy (&attr) ;
+}
+
+int wiringPiSPIxLockBus (const int number)
+{
+  if (number < 0 || number >= SPI_BUSES)
+  {
+    fprintf (stderr, "wiringPiSPI: Invalid SPI number  (%d, valid range 0-%d)", number, SPI_BUSES-1) ;
+    return -EINVAL ;
+  }
+  pthread_once (&spiBusLocksOnce, spiBusLocksInit) ;
+  return -pthread_mutex_lock (&spiBusLocks [number]) ;
+}
+
+int wiringPiSPIxUnlockBus (const int number)
+{
+  if (number < 0 || number >= SPI_BUSES)
+    return -EINVAL ;
+  pthread_once (&spiBusLocksOnce, spiBusLocksInit) ;
+  return -pthread_mutex_unlock (&spiBusLocks [number]) ;
+}
+
 /*
  * wiringPiSPIGetFd:
  *	Return the file-descriptor for the given channel
@@ -96,6 +193,9 @@ int SPICheckLimits(const int number, const int channel) {
 
 int wiringPiSPIxGetFd(const int number, int channel)
 {
+  if (softSpiIsBus(number)) {
+    return -1;   // no file descriptor
+  }
   if (SPICheckLimits(number, channel)!=0) {
     return -1;
   }
@@ -103,7 +203,7 @@ int wiringPiSPIxGetFd(const int number, int channel)
 }
 
 int wiringPiSPIGetFd(int channel) {
-  return wiringPiSPIxGetFd(0, channel);
+  return wiringPiSPIxGetFd(SPI_NUMBER(channel), SPI_CHANNEL(channel));
 }
 
 
@@ -118,6 +218,14 @@ int wiringPiSPIGetFd(int channel) {
 
 int wiringPiSPIxDataRW (const int number, const int channel, unsigned char *data, const int len)
 {
+  if (softSpiIsBus(number)) {
+    int ret ;
+    if ((ret = wiringPiSPIxLockBus (number)) < 0)
+      return ret ;
+    ret = softSpiTransfer(number, channel, data, data, len, 8);
+    wiringPiSPIxUnlockBus (number) ;
+    return ret ;
+  }
 
   RETURN_ON_LIMIT_FAIL
   if (-1==spiFds[number][channel]) {
@@ -125,23 +233,216 @@ int wiringPiSPIxDataRW (const int number, const int channel, unsigned char *data
     return -EBADF;
   }
 
-  struct spi_ioc_transfer spi ;
-// Mentioned in spidev.h but not used in the original kernel documentation
-//	test program )-:
-  memset (&spi, 0, sizeof (spi)) ;
+  struct wiringPiSPISegment seg ;
+  memset (&seg, 0, sizeof (seg)) ;
 
-  spi.tx_buf        = (unsigned long)data ;
-  spi.rx_buf        = (unsigned long)data ;
-  spi.len           = len ;
-  spi.delay_usecs   = spiDelay ;
-  spi.speed_hz      = spiSpeeds [number][channel] ;
-  spi.bits_per_word = spiBPW ;
+  seg.tx          = data ;
+  seg.rx          = data ;
+  seg.len         = len ;
+  seg.delay_us    = spiDelay ;
+  seg.bitsPerWord = spiBPW ;
 
-  return ioctl (spiFds[number][channel], SPI_IOC_MESSAGE(1), &spi) ;
+  return wiringPiSPIxTransaction (number, channel, &seg, 1) ;
 }
 
 int wiringPiSPIDataRW (int channel, unsigned char *data, int len) {
-  return wiringPiSPIxDataRW(0, channel, data, len);
+  return wiringPiSPIxDataRW(SPI_NUMBER(channel), SPI_CHANNEL(channel), data, len);
+}
+
+
+/*
+ * wiringPiSPIxTransfer:
+ *	Write and Read a block of data with separate buffers, in words of
+ *	8, 16 or 32 bits (native byte order). tx NULL sends zeros, rx NULL
+ *	drops the data read.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxTransfer (const int number, const int channel, const void *tx, void *rx, const int len, const int bitsPerWord)
+{
+  if (softSpiIsBus(number)) {
+    int ret ;
+    if ((ret = wiringPiSPIxLockBus (number)) < 0)
+      return ret ;
+    ret = softSpiTransfer(number, channel, tx, rx, len, bitsPerWord);
+    wiringPiSPIxUnlockBus (number) ;
+    return ret ;
+  }
+
+  struct wiringPiSPISegment seg ;
+  memset (&seg, 0, sizeof (seg)) ;
+
+  seg.tx          = tx ;
+  seg.rx          = rx ;
+  seg.len         = len ;
+  seg.bitsPerWord = bitsPerWord ;
+
+  return wiringPiSPIxTransaction (number, channel, &seg, 1) ;
+}
+
+
+/*
+ * wiringPiSPIGetBufSize:
+ * wiringPiSPISetChunkSize:
+ * wiringPiSPIGetChunkSize:
+ *	The spidev limit of bytes per message, read once from the module
+ *	parameter (4096 if not available), and the size of the chunks longer
+ *	transfers are cut into: at most bufsiz, a multiple of 4 so 16 and 32
+ *	bit words are not cut, 0 = bufsiz.
+ *********************************************************************************
+ */
+
+int wiringPiSPIGetBufSize (void)
+{
+  FILE *f ;
+
+  if (spiBufSize <= 0) {
+    spiBufSize = 4096 ;
+    if ((f = fopen (spiBufSizeFile, "r")) != NULL) {
+      if (fscanf (f, "%d", &spiBufSize) != 1 || spiBufSize < 4)
+        spiBufSize = 4096 ;
+      fclose (f) ;
+    }
+  }
+  return spiBufSize ;
+}
+
+int wiringPiSPISetChunkSize (const int bytes)
+{
+  spiChunkSize = (bytes > 0) ? (bytes & ~3) : 0 ;
+  return wiringPiSPIGetChunkSize () ;
+}
+
+int wiringPiSPIGetChunkSize (void)
+{
+  int bufSize = wiringPiSPIGetBufSize () ;
+
+  if (spiChunkSize <= 0 || spiChunkSize > bufSize)
+    return bufSize & ~3 ;
+  return (spiChunkSize < 4) ? 4 : spiChunkSize ;
+}
+
+
+/*
+ * spiMessages:
+ *	Send the segments over a spidev descriptor, cut into chunks and packed
+ *	into as few SPI_IOC_MESSAGE(n) ioctls as bufsiz allows. Speed, word size
+ *	and delay go into every transfer, segments with 0 take the defaults.
+ *	Call with the bus locked.
+ *********************************************************************************
+ */
+
+static int spiMessages (int fd, unsigned int speed, int bitsPerWord, int delay_us, const struct wiringPiSPISegment *segs, int count)
+{
+  struct spi_ioc_transfer spi [WPI_SPI_MAX_SEGMENTS] ;
+  int chunkSize = wiringPiSPIGetChunkSize () ;
+  int n = 0, msgBytes = 0, total = 0, ret ;
+
+  for (int i = 0 ; i < count ; ++i) {
+    unsigned int offset = 0 ;
+    do {
+      unsigned int chunk = segs [i].len - offset ;
+      if (chunk > (unsigned int)chunkSize)
+        chunk = chunkSize ;
+
+      if (n == WPI_SPI_MAX_SEGMENTS || msgBytes + chunk > (unsigned int)spiBufSize) {
+        // cs_change on the last transfer of a message keeps the chip selected
+        spi [n-1].cs_change = !spi [n-1].cs_change ;
+        if ((ret = ioctl (fd, SPI_IOC_MESSAGE(n), spi)) < 0)
+          return ret ;
+        total += ret ;
+        n = msgBytes = 0 ;
+      }
+
+      memset (&spi [n], 0, sizeof (spi [0])) ;
+      spi [n].tx_buf        = segs [i].tx ? (unsigned long)((const uint8_t *)segs [i].tx + offset) : 0 ;
+      spi [n].rx_buf        = segs [i].rx ? (unsigned long)((uint8_t *)segs [i].rx + offset) : 0 ;
+      spi [n].len           = chunk ;
+      spi [n].speed_hz      = segs [i].speed ? segs [i].speed : speed ;
+      spi [n].bits_per_word = segs [i].bitsPerWord ? segs [i].bitsPerWord : bitsPerWord ;
+      msgBytes += chunk ;
+      offset   += chunk ;
+      ++n ;
+    } while (offset < segs [i].len) ;
+
+    spi [n-1].delay_usecs = segs [i].delay_us ? segs [i].delay_us : delay_us ;
+    spi [n-1].cs_change   = segs [i].csChange && (i < count-1) ;
+  }
+
+  if ((ret = ioctl (fd, SPI_IOC_MESSAGE(n), spi)) < 0)
+    return ret ;
+  return total + ret ;
+}
+
+
+/*
+ * spiTransaction:
+ *	Lock the bus, put the spidev device into the mode if another user left
+ *	it in a different one (the mode is no field of spi_ioc_transfer), and
+ *	send the segments.
+ *********************************************************************************
+ */
+
+static int spiTransaction (int number, int channel, int fd, int mode, unsigned int speed, int bitsPerWord, int delay_us,
+                           const struct wiringPiSPISegment *segs, int count)
+{
+  int ret ;
+
+  if ((ret = wiringPiSPIxLockBus (number)) < 0)
+    return ret ;
+
+  if (spiModes [number][channel] != mode) {
+    uint8_t spiMode = mode ;
+    if (ioctl (fd, SPI_IOC_WR_MODE, &spiMode) < 0) {
+      ret = -errno ;
+      fprintf (stderr, "wiringPiSPI: SPI mode change failure: %s\n", strerror (errno)) ;
+      wiringPiSPIxUnlockBus (number) ;
+      return ret ;
+    }
+    spiModes [number][channel] = mode ;
+  }
+  ret = spiMessages (fd, speed, bitsPerWord, delay_us, segs, count) ;
+
+  wiringPiSPIxUnlockBus (number) ;
+  return ret ;
+}
+
+
+/*
+ * wiringPiSPIxTransaction:
+ *	Run a number of segments, each with its own buffers, speed, word size,
+ *	delay and chip select change, with one SPI_IOC_MESSAGE(n) ioctl. The
+ *	chip select stays active between the segments unless csChange is set.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxTransaction (const int number, const int channel, const struct wiringPiSPISegment *segs, const int count)
+{
+  if (softSpiIsBus(number)) {
+    int ret ;
+    if ((ret = wiringPiSPIxLockBus (number)) < 0)
+      return ret ;
+    ret = softSpiTransaction(number, channel, segs, count);
+    wiringPiSPIxUnlockBus (number) ;
+    return ret ;
+  }
+
+  RETURN_ON_LIMIT_FAIL
+  if (-1==spiFds[number][channel]) {
+    fprintf (stderr, "wiringPiSPI: Invalid SPI number/channel (need wiringPiSPIxSetupMode before read/write)");
+    return -EBADF;
+  }
+  if (count<1 || count>WPI_SPI_MAX_SEGMENTS || segs==NULL) {
+    fprintf (stderr, "wiringPiSPI: Invalid number of segments (%d, valid range 1-%d)", count, WPI_SPI_MAX_SEGMENTS);
+    return -EINVAL;
+  }
+
+  return spiTransaction (number, channel, spiFds [number][channel], spiChannelModes [number][channel],
+                         spiSpeeds [number][channel], spiBPW, spiDelay, segs, count) ;
+}
+
+int wiringPiSPITransaction (int channel, const struct wiringPiSPISegment *segs, int count) {
+  return wiringPiSPIxTransaction(SPI_NUMBER(channel), SPI_CHANNEL(channel), segs, count);
 }
 
 /*
@@ -156,6 +457,10 @@ int wiringPiSPIxSetupMode(const int number, const int channel, const int speed,
   int fd ;
   char spiDev [32] ;
 
+  if (softSpiIsBus(number)) {
+    return softSpiSetupMode(number, channel, speed, mode);
+  }
+
   RETURN_ON_LIMIT_FAIL
   if (mode<0 || mode>3) { // Mode is 0, 1, 2 or 3 original
     fprintf (stderr, "wiringPiSPI: Invalid mode (%d, valid range 0-%d)", mode, 3);
@@ -168,11 +473,19 @@ int wiringPiSPIxSetupMode(const int number, const int channel, const int speed,
   }
   spiSpeeds [number][channel] = speed ;
   spiFds    [number][channel] = fd ;
+  spiChannelModes [number][channel] = mode ;
+  wiringPiSPIGetBufSize () ;
 
 // Set SPI parameters.
 
-  if (ioctl (fd, SPI_IOC_WR_MODE, &mode)            < 0)
+  wiringPiSPIxLockBus (number) ;
+  spiModes [number][channel] = -1 ;
+  if (ioctl (fd, SPI_IOC_WR_MODE, &mode)            < 0) {
+    wiringPiSPIxUnlockBus (number) ;
     return wiringPiFailure (WPI_ALMOST, "SPI mode change failure: %s\n", strerror (errno)) ;
+  }
+  spiModes [number][channel] = mode ;
+  wiringPiSPIxUnlockBus (number) ;
   
   if (ioctl (fd, SPI_IOC_WR_BITS_PER_WORD, &spiBPW) < 0)
     return wiringPiFailure (WPI_ALMOST, "SPI BPW change failure: %s\n", strerror (errno)) ;
@@ -185,7 +498,7 @@ int wiringPiSPIxSetupMode(const int number, const int channel, const int speed,
 
 
 int wiringPiSPISetupMode (int channel, int speed, int mode) {
- return wiringPiSPIxSetupMode (0, channel, speed, mode);
+ return wiringPiSPIxSetupMode (SPI_NUMBER(channel), SPI_CHANNEL(channel), speed, mode);
 }
 
 
@@ -196,22 +509,223 @@ int wiringPiSPISetupMode (int channel, int speed, int mode) {
  */
 
 int wiringPiSPISetup (int channel, int speed) {
-  return wiringPiSPIxSetupMode(0, channel, speed, 0) ;
+  return wiringPiSPIxSetupMode(SPI_NUMBER(channel), SPI_CHANNEL(channel), speed, 0) ;
 }
 
 
 int wiringPiSPIxClose (const int number, const int channel) {
 
+  if (softSpiIsBus(number)) {
+    return softSpiClose(number, channel);
+  }
+
   RETURN_ON_LIMIT_FAIL
   if (spiFds[number][channel]>0) {
     ret = close(spiFds[number][channel]);
   }
   spiSpeeds [number][channel] = 0 ;
   spiFds    [number][channel] = -1 ;
+  spiChannelModes [number][channel] = 0 ;
   return ret;
 }
 
 int wiringPiSPIClose (const int channel) {
-  return wiringPiSPIxClose (0, channel);
+  return wiringPiSPIxClose (SPI_NUMBER(channel), SPI_CHANNEL(channel));
+}
+
+
+
+/*
+ * wiringPiSPIxOpenDevice:
+ *	A device on a chip select with its own mode, speed, word size and delay.
+ *	They go with every transaction of the device, so devices with different
+ *	settings share a bus without setting it up again in between. Returns
+ *	a handle >= 0.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxOpenDevice (const int number, const int channel, const int speed, const int mode)
+{
+  struct spiDevice *dev ;
+  char spiDev [32] ;
+  int handle, fd = -1 ;
+
+  if (mode < 0 || mode > 3) {
+    fprintf (stderr, "wiringPiSPI: Invalid mode (%d, valid range 0-%d)", mode, 3) ;
+    return -EINVAL ;
+  }
+  if (speed <= 0) {
+    fprintf (stderr, "wiringPiSPI: Invalid speed (%d)", speed) ;
+    return -EINVAL ;
+  }
+  if (!softSpiIsBus (number)) {
+    RETURN_ON_LIMIT_FAIL
+    snprintf (spiDev, 31, "/dev/spidev%d.%d", number, channel) ;
+    if ((fd = open (spiDev, O_RDWR)) < 0) {
+      ret = -errno ;
+      fprintf (stderr, "wiringPiSPI: Unable to open SPI device %s: %s\n", spiDev, strerror (errno)) ;
+      return ret ;
+    }
+    wiringPiSPIGetBufSize () ;
+  } else if (channel < 0 || channel >= SOFT_SPI_CHANNELS) {
+    fprintf (stderr, "wiringPiSPI: Invalid SPI channel (%d, valid range 0-%d)", channel, SOFT_SPI_CHANNELS-1) ;
+    return -EINVAL ;
+  }
+
+  pthread_mutex_lock (&spiDeviceLock) ;
+  for (handle = 0 ; handle < WPI_SPI_MAX_DEVICES ; ++handle)
+    if (!spiDevices [handle].used)
+      break ;
+  if (handle == WPI_SPI_MAX_DEVICES) {
+    pthread_mutex_unlock (&spiDeviceLock) ;
+    if (fd >= 0)
+      close (fd) ;
+    fprintf (stderr, "wiringPiSPI: No free SPI device (max %d)", WPI_SPI_MAX_DEVICES) ;
+    return -ENOMEM ;
+  }
+  dev = &spiDevices [handle] ;
+  dev->used        = 1 ;
+  dev->number      = number ;
+  dev->channel     = channel ;
+  dev->fd          = fd ;
+  dev->mode        = mode ;
+  dev->speed       = speed ;
+  dev->bitsPerWord = spiBPW ;
+  dev->delay_us    = spiDelay ;
+  pthread_mutex_unlock (&spiDeviceLock) ;
+
+  return handle ;
 }
 
+
+/*
+ * getDevice:
+ *	Copy of the settings of an open device, they may change while it is used
+ *********************************************************************************
+ */
+
+static int getDevice (int handle, struct spiDevice *dev)
+{
+  if (handle < 0 || handle >= WPI_SPI_MAX_DEVICES)
+    return -EBADF ;
+
+  pthread_mutex_lock (&spiDeviceLock) ;
+  *dev = spiDevices [handle] ;
+  pthread_mutex_unlock (&spiDeviceLock) ;
+
+  return dev->used ? 0 : -EBADF ;
+}
+
+
+/*
+ * wiringPiSPIDeviceConfig:
+ *	Change the settings of a device: speed in Hz, mode 0..3, 8, 16 or 32
+ *	bits per word and the delay after each segment in us.
+ *********************************************************************************
+ */
+
+int wiringPiSPIDeviceConfig (const int handle, const int speed, const int mode, const int bitsPerWord, const int delay_us)
+{
+  if (mode < 0 || mode > 3 || speed <= 0 || delay_us < 0 || delay_us > 0xFFFF ||
+      (bitsPerWord != 8 && bitsPerWord != 16 && bitsPerWord != 32)) {
+    fprintf (stderr, "wiringPiSPI: Invalid device settings (speed %d, mode %d, bits %d, delay %d)", speed, mode, bitsPerWord, delay_us) ;
+    return -EINVAL ;
+  }
+  if (handle < 0 || handle >= WPI_SPI_MAX_DEVICES)
+    return -EBADF ;
+
+  pthread_mutex_lock (&spiDeviceLock) ;
+  if (!spiDevices [handle].used) {
+    pthread_mutex_unlock (&spiDeviceLock) ;
+    return -EBADF ;
+  }
+  spiDevices [handle].speed       = speed ;
+  spiDevices [handle].mode        = mode ;
+  spiDevices [handle].bitsPerWord = bitsPerWord ;
+  spiDevices [handle].delay_us    = delay_us ;
+  pthread_mutex_unlock (&spiDeviceLock) ;
+
+  return 0 ;
+}
+
+
+/*
+ * wiringPiSPIDeviceTransaction:
+ * wiringPiSPIDeviceDataRW:
+ *	As wiringPiSPIxTransaction and wiringPiSPIxDataRW with the settings of
+ *	the device, segments with speed, bitsPerWord or delay_us 0 take them.
+ *********************************************************************************
+ */
+
+int wiringPiSPIDeviceTransaction (const int handle, const struct wiringPiSPISegment *segs, const int count)
+{
+  struct wiringPiSPISegment own [WPI_SPI_MAX_SEGMENTS] ;
+  struct spiDevice dev ;
+  int i, ret ;
+
+  if ((ret = getDevice (handle, &dev)) < 0)
+    return ret ;
+  if (count < 1 || count > WPI_SPI_MAX_SEGMENTS || segs == NULL) {
+    fprintf (stderr, "wiringPiSPI: Invalid number of segments (%d, valid range 1-%d)", count, WPI_SPI_MAX_SEGMENTS) ;
+    return -EINVAL ;
+  }
+
+  if (dev.fd >= 0)
+    return spiTransaction (dev.number, dev.channel, dev.fd, dev.mode, dev.speed, dev.bitsPerWord, dev.delay_us, segs, count) ;
+
+  // Software bus: the channel keeps its own settings for wiringPiSPIxTransaction
+
+  for (i = 0 ; i < count ; ++i) {
+    own [i] = segs [i] ;
+    if (!own [i].speed)
+      own [i].speed = dev.speed ;
+    if (!own [i].bitsPerWord)
+      own [i].bitsPerWord = dev.bitsPerWord ;
+    if (!own [i].delay_us)
+      own [i].delay_us = dev.delay_us ;
+  }
+  if ((ret = wiringPiSPIxLockBus (dev.number)) < 0)
+    return ret ;
+  ret = softSpiTransactionMode (dev.number, dev.channel, dev.mode, own, count) ;
+  wiringPiSPIxUnlockBus (dev.number) ;
+
+  return ret ;
+}
+
+int wiringPiSPIDeviceDataRW (const int handle, unsigned char *data, const int len)
+{
+  struct wiringPiSPISegment seg ;
+
+  memset (&seg, 0, sizeof (seg)) ;
+  seg.tx  = data ;
+  seg.rx  = data ;
+  seg.len = len ;
+
+  return wiringPiSPIDeviceTransaction (handle, &seg, 1) ;
+}
+
+
+/*
+ * wiringPiSPICloseDevice:
+ *	Close the descriptor of the device and free the handle.
+ *********************************************************************************
+ */
+
+int wiringPiSPICloseDevice (const int handle)
+{
+  int fd ;
+
+  if (handle < 0 || handle >= WPI_SPI_MAX_DEVICES)
+    return -EBADF ;
+
+  pthread_mutex_lock (&spiDeviceLock) ;
+  if (!spiDevices [handle].used) {
+    pthread_mutex_unlock (&spiDeviceLock) ;
+    return -EBADF ;
+  }
+  fd = spiDevices [handle].fd ;
+  memset (&spiDevices [handle], 0, sizeof (spiDevices [0])) ;
+  pthread_mutex_unlock (&spiDeviceLock) ;
+
+  return (fd >= 0) ? close (fd) : 0 ;
+}
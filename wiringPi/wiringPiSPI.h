@@ -41,6 +41,74 @@ int wiringPiSPIxSetupMode (const int number, const int channel, const int speed,
 int wiringPiSPIxSetup     (const int number, const int channel, const int speed) ;
 int wiringPiSPIxClose     (const int number, const int channel);
 
+//Interface 3.15
+//	The single bus functions reach the channels of other buses, e.g. the
+//	software buses of softSpi.h, with wiringPiSPIChannel(number, channel)
+#define wiringPiSPIChannel(number, channel) (((number) << 4) | (channel))
+int wiringPiSPIxTransfer  (const int number, const int channel, const void *tx, void *rx, const int len, const int bitsPerWord) ;
+
+// One segment of a transaction, all segments go out with one ioctl
+
+#define WPI_SPI_MAX_SEGMENTS 64
+
+struct wiringPiSPISegment
+{
+  const void     *tx ;          // NULL: send zeros
+  void           *rx ;          // NULL: drop the data read
+  unsigned int    len ;         // bytes
+  unsigned int    speed ;       // Hz, 0: speed of the channel
+  unsigned short  delay_us ;    // after the segment
+  unsigned char   bitsPerWord ; // 0: 8
+  unsigned char   csChange ;    // chip select inactive before the next segment
+} ;
+
+int wiringPiSPIxTransaction (const int number, const int channel, const struct wiringPiSPISegment *segs, const int count) ;
+int wiringPiSPITransaction  (int channel, const struct wiringPiSPISegment *segs, int count) ;
+
+// Longer transfers than the spidev buffer are cut into chunks
+
+int wiringPiSPIGetBufSize   (void) ;
+int wiringPiSPISetChunkSize (const int bytes) ;
+int wiringPiSPIGetChunkSize (void) ;
+
+// Asynchronous transactions, a worker thread per bus
+
+#define WPI_SPI_ASYNC_DEPTH    64   // requests queued per bus
+#define WPI_SPI_ASYNC_SEGMENTS 8    // segments per request
+
+struct wiringPiSPICompletion
+{
+  unsigned int    ticket ;
+  int             result ;      // bytes transferred, <0 error
+  void           *userData ;
+} ;
+
+struct wiringPiSPIAsyncStats
+{
+  unsigned long long submitted ;
+  unsigned long long completed ;
+  unsigned long long messages ; // transactions the requests were merged into
+  unsigned long long lost ;     // completions dropped, ring not polled
+} ;
+
+int  wiringPiSPIxSubmit         (const int number, const int channel, const struct wiringPiSPISegment *segs, const int count,
+                                 void (*done)(void *userData, unsigned int ticket, int result), void *userData) ;
+int  wiringPiSPIxFence          (const int number) ;
+int  wiringPiSPIxPollCompletion (const int number, struct wiringPiSPICompletion *completion) ;
+void wiringPiSPIxAsyncStats     (const int number, struct wiringPiSPIAsyncStats *stats, const int reset) ;
+
+// Devices with their own settings, one lock per bus
+
+#define WPI_SPI_MAX_DEVICES 32
+
+int wiringPiSPIxLockBus          (const int number) ;
+int wiringPiSPIxUnlockBus        (const int number) ;
+int wiringPiSPIxOpenDevice       (const int number, const int channel, const int speed, const int mode) ;
+int wiringPiSPIDeviceConfig      (const int handle, const int speed, const int mode, const int bitsPerWord, const int delay_us) ;
+int wiringPiSPIDeviceTransaction (const int handle, const struct wiringPiSPISegment *segs, const int count) ;
+int wiringPiSPIDeviceDataRW      (const int handle, unsigned char *data, const int len) ;
+int wiringPiSPICloseDevice       (const int handle) ;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,310 @@
+/*
+ * wiringPiSPIAsync.c:
+ *	Queue SPI transactions to a worker thread per bus, so the caller
+ *	keeps running while they are transferred.
+ *	Copyright (c) 2012-2024 Gordon Henderson and contributors
+ ***********************************************************************
+ * This file is part of wiringPi:
+ *	https://github.com/WiringPi/WiringPi/
+ *
+ *    wiringPi is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU Lesser General Public License as
+ *    published by the Free Software Foundation, either version 3 of the
+ *    License, or (at your option) any later version.
+ *
+ *    wiringPi is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Lesser General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Lesser General Public
+ *    License along with wiringPi.
+ *    If not, see <http://www.gnu.org/licenses/>.
+ ***********************************************************************
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "wiringPi.h"
+#include "wiringPiSPI.h"
+#include "softSpi.h"
+
+// Bus numbers 0..6 spidev, 7..15 the software buses
+
+#define	ASYNC_BUSSES	(SOFT_SPI_LAST + 1)
+
+struct asyncRequest
+{
+  unsigned int              ticket ;
+  int                       channel ;
+  int                       count ;
+  struct wiringPiSPISegment segs [WPI_SPI_ASYNC_SEGMENTS] ;
+  void                    (*done) (void *userData, unsigned int ticket, int result) ;
+  void                     *userData ;
+} ;
+
+struct asyncBus
+{
+  int                          running ;
+  pthread_t                    thread ;		// the worker
+  pthread_cond_t               work ;		// requests queued
+  pthread_cond_t               idle ;		// requests completed
+  struct asyncRequest          ring [WPI_SPI_ASYNC_DEPTH] ;
+  unsigned int                 head, tail ;	// queued, taken by the worker
+  unsigned int                 completed ;
+  struct wiringPiSPICompletion comp [WPI_SPI_ASYNC_DEPTH] ;
+  unsigned int                 compHead, compTail ;
+  struct wiringPiSPIAsyncStats stats ;
+} ;
+
+static struct asyncBus  busses [ASYNC_BUSSES] ;
+static pthread_mutex_t  asyncMutex = PTHREAD_MUTEX_INITIALIZER ;
+
+
+/*
+ * asyncWorker:
+ *	Take all queued requests for the same channel, up to the segments of
+ *	one SPI_IOC_MESSAGE, and transfer them as one transaction, the chip
+ *	select is released between the requests. Then report the results.
+ *********************************************************************************
+ */
+
+static void *asyncWorker (void *arg)
+{
+  struct asyncBus *bus = arg ;
+  int number = bus - busses ;
+  struct asyncRequest       batch [WPI_SPI_MAX_SEGMENTS] ;
+  struct wiringPiSPISegment segs  [WPI_SPI_MAX_SEGMENTS] ;
+  int n, i, j, k, ret, result ;
+
+  pthread_mutex_lock (&asyncMutex) ;
+  for (;;)
+  {
+    while (bus->tail == bus->head)
+      pthread_cond_wait (&bus->work, &asyncMutex) ;
+
+    n = k = 0 ;
+    while (bus->tail != bus->head)
+    {
+      struct asyncRequest *r = &bus->ring [bus->tail % WPI_SPI_ASYNC_DEPTH] ;
+      if ((n > 0) && ((r->channel != batch [0].channel) || (k + r->count > WPI_SPI_MAX_SEGMENTS)))
+        break ;
+      batch [n++] = *r ;
+      k += r->count ;
+      bus->tail++ ;
+    }
+    pthread_mutex_unlock (&asyncMutex) ;
+
+    for (i = k = 0 ; i < n ; ++i)
+    {
+      for (j = 0 ; j < batch [i].count ; ++j)
+        segs [k++] = batch [i].segs [j] ;
+      segs [k-1].csChange = (i < n - 1) ;
+    }
+    ret = wiringPiSPIxTransaction (number, batch [0].channel, segs, k) ;
+
+    for (i = 0 ; i < n ; ++i)
+    {
+      result = ret ;
+      if (ret >= 0)
+        for (j = 0, result = 0 ; j < batch [i].count ; ++j)
+          result += batch [i].segs [j].len ;
+
+      if (batch [i].done != NULL)
+        batch [i].done (batch [i].userData, batch [i].ticket, result) ;
+      else
+      {
+        pthread_mutex_lock (&asyncMutex) ;
+        if (bus->compHead - bus->compTail == WPI_SPI_ASYNC_DEPTH)	// nobody polls, drop the oldest
+        {
+          bus->compTail++ ;
+          bus->stats.lost++ ;
+        }
+        bus->comp [bus->compHead % WPI_SPI_ASYNC_DEPTH] = (struct wiringPiSPICompletion){ batch [i].ticket, result, batch [i].userData } ;
+        bus->compHead++ ;
+        pthread_mutex_unlock (&asyncMutex) ;
+      }
+    }
+
+    pthread_mutex_lock (&asyncMutex) ;
+    bus->completed       += n ;
+    bus->stats.completed += n ;
+    bus->stats.messages++ ;
+    pthread_cond_broadcast (&bus->idle) ;
+  }
+  return NULL ;
+}
+
+
+/*
+ * getBus:
+ *	The queue of a bus number, the worker is started with the first request
+ *	Called with asyncMutex held.
+ *********************************************************************************
+ */
+
+static struct asyncBus *getBus (int number, int start)
+{
+  struct asyncBus *bus ;
+
+  if (number < 0 || number >= ASYNC_BUSSES)
+  {
+    fprintf (stderr, "wiringPiSPI: Invalid SPI number (%d, valid range 0-%d)\n", number, ASYNC_BUSSES - 1) ;
+    return NULL ;
+  }
+  bus = &busses [number] ;
+  if (!bus->running && start)
+  {
+    pthread_cond_init (&bus->work, NULL) ;
+    pthread_cond_init (&bus->idle, NULL) ;
+    if (pthread_create (&bus->thread, NULL, asyncWorker, bus) != 0)
+    {
+      fprintf (stderr, "wiringPiSPI: Unable to start the SPI worker: %s\n", strerror (errno)) ;
+      return NULL ;
+    }
+    pthread_detach (bus->thread) ;
+    bus->running = TRUE ;
+  }
+  return bus ;
+}
+
+
+/*
+ * wiringPiSPIxSubmit:
+ *	Queue a transaction of up to WPI_SPI_ASYNC_SEGMENTS segments and return
+ *	at once. The segments are copied, the buffers they point to must stay
+ *	valid until the transaction is completed. When done, done() is called
+ *	from the worker thread with the bytes transferred or an error, without
+ *	a callback the result goes to the completion ring
+ *	(wiringPiSPIxPollCompletion).
+ *	Returns the ticket (> 0) of the request, -EAGAIN if the queue is full.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxSubmit (const int number, const int channel, const struct wiringPiSPISegment *segs, const int count,
+  void (*done)(void *userData, unsigned int ticket, int result), void *userData)
+{
+  struct asyncBus *bus ;
+  struct asyncRequest *r ;
+  unsigned int ticket ;
+
+  if (count < 1 || count > WPI_SPI_ASYNC_SEGMENTS || segs == NULL)
+  {
+    fprintf (stderr, "wiringPiSPI: Invalid number of segments (%d, valid range 1-%d)\n", count, WPI_SPI_ASYNC_SEGMENTS) ;
+    return -EINVAL ;
+  }
+
+  pthread_mutex_lock (&asyncMutex) ;
+  if ((bus = getBus (number, TRUE)) == NULL)
+  {
+    pthread_mutex_unlock (&asyncMutex) ;
+    return -EINVAL ;
+  }
+  if (bus->head - bus->tail == WPI_SPI_ASYNC_DEPTH)
+  {
+    pthread_mutex_unlock (&asyncMutex) ;
+    return -EAGAIN ;
+  }
+
+  ticket      = (bus->head & 0x7FFFFFFF) + 1 ;
+  r           = &bus->ring [bus->head % WPI_SPI_ASYNC_DEPTH] ;
+  r->ticket   = ticket ;
+  r->channel  = channel ;
+  r->count    = count ;
+  r->done     = done ;
+  r->userData = userData ;
+  memcpy (r->segs, segs, count * sizeof (segs [0])) ;
+  bus->head++ ;
+  bus->stats.submitted++ ;
+
+  pthread_cond_signal (&bus->work) ;
+  pthread_mutex_unlock (&asyncMutex) ;
+
+  return (int)ticket ;
+}
+
+
+/*
+ * wiringPiSPIxFence:
+ *	Wait until all transactions queued for the bus so far are completed,
+ *	their callbacks have returned. A callback of the bus can't wait for
+ *	itself, -EDEADLK is returned then.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxFence (const int number)
+{
+  struct asyncBus *bus ;
+  unsigned int target ;
+
+  pthread_mutex_lock (&asyncMutex) ;
+  if ((bus = getBus (number, FALSE)) == NULL)
+  {
+    pthread_mutex_unlock (&asyncMutex) ;
+    return -EINVAL ;
+  }
+  if (bus->running && pthread_equal (pthread_self (), bus->thread))
+  {
+    pthread_mutex_unlock (&asyncMutex) ;
+    fprintf (stderr, "wiringPiSPI: wiringPiSPIxFence called from a callback of SPI bus %d\n", number) ;
+    return -EDEADLK ;
+  }
+  target = bus->head ;
+  while (bus->running && (int)(target - bus->completed) > 0)
+    pthread_cond_wait (&bus->idle, &asyncMutex) ;
+  pthread_mutex_unlock (&asyncMutex) ;
+
+  return 0 ;
+}
+
+
+/*
+ * wiringPiSPIxPollCompletion:
+ *	Take the oldest result of the transactions queued without a callback.
+ *	Returns 1 if there was one, else 0.
+ *********************************************************************************
+ */
+
+int wiringPiSPIxPollCompletion (const int number, struct wiringPiSPICompletion *completion)
+{
+  struct asyncBus *bus ;
+  int ret = 0 ;
+
+  pthread_mutex_lock (&asyncMutex) ;
+  if (((bus = getBus (number, FALSE)) != NULL) && (bus->compTail != bus->compHead))
+  {
+    *completion = bus->comp [bus->compTail % WPI_SPI_ASYNC_DEPTH] ;
+    bus->compTail++ ;
+    ret = 1 ;
+  }
+  pthread_mutex_unlock (&asyncMutex) ;
+
+  return ret ;
+}
+
+
+/*
+ * wiringPiSPIxAsyncStats:
+ *	Counters of the queue, messages is the number of transactions the
+ *	requests were merged into.
+ *********************************************************************************
+ */
+
+void wiringPiSPIxAsyncStats (const int number, struct wiringPiSPIAsyncStats *stats, const int reset)
+{
+  struct asyncBus *bus ;
+
+  pthread_mutex_lock (&asyncMutex) ;
+  if ((bus = getBus (number, FALSE)) != NULL)
+  {
+    *stats = bus->stats ;
+    if (reset)
+      memset (&bus->stats, 0, sizeof (bus->stats)) ;
+  }
+  else
+    memset (stats, 0, sizeof (*stats)) ;
+  pthread_mutex_unlock (&asyncMutex) ;
+}
@@ -27,33 +27,239 @@
 #include "wiringPi.h"
 #include "wiringShift.h"
 
+// Minimum clock period of the buffer functions in nS, 0 = as fast as the
+//	GPIO goes. It is converted to ticks when shifting: the tick rate of
+//	the wiringPi time source changes with the setup.
+
+static unsigned int clockPeriodNs = 0 ;
+
+
 /*
- * shiftIn:
- *	Shift data in from a clocked source
+ * shiftSetClockPeriod:
+ *	Set the minimum clock period in nS for all the shift functions, so
+ *	slow shift registers or long wires still work. 0 (the default) clocks
+ *	as fast as the GPIO can be written.
  *********************************************************************************
  */
 
-uint8_t shiftIn (uint8_t dPin, uint8_t cPin, uint8_t order)
+void shiftSetClockPeriod (unsigned int ns)
+{
+  clockPeriodNs = ns ;
+}
+
+
+/*
+ * shiftHalfPeriod:
+ *	Half the clock period in ticks of the time source in use now
+ *********************************************************************************
+ */
+
+static unsigned long long shiftHalfPeriod (void)
+{
+  return ((unsigned long long)clockPeriodNs * piTicksFrequency () / 2 + 999999999ULL) / 1000000000ULL ;
+}
+
+
+/*
+ * shiftWait:
+ *	Make sure half a clock period has gone since the last edge, and
+ *	remember when the next one is made.
+ *********************************************************************************
+ */
+
+static inline void shiftWait (unsigned long long *edge, unsigned long long halfPeriodTicks)
 {
-  uint8_t value = 0 ;
-  int8_t  i ;
- 
-  if (order == MSBFIRST)
-    for (i = 7 ; i >= 0 ; --i)
+  unsigned long long now ;
+
+  if (halfPeriodTicks == 0)
+    return ;
+
+  while (((now = piTicks ()) - *edge) < halfPeriodTicks)
+    ;
+  *edge = now ;
+}
+
+
+/*
+ * shiftResolve:
+ *	Resolve the data and clock pins to one GPIO bank and masks. Returns
+ *	the bank, or -1 if the pins are not all on-board pins in the same bank
+ *	and the slow path with digitalWrite/digitalRead has to be taken.
+ *********************************************************************************
+ */
+
+static int shiftResolve (const int *dPins, int lines, int cPin, unsigned int *dMasks, unsigned int *cMask)
+{
+  int bank, line ;
+
+  if (lines > 32 || (bank = digitalPinToBank (cPin)) < 0)
+    return -1 ;
+
+  *cMask = digitalPinToBitMask (cPin) ;
+  for (line = 0 ; line < lines ; ++line)
+  {
+    if (digitalPinToBank (dPins [line]) != bank)
+      return -1 ;
+    dMasks [line] = digitalPinToBitMask (dPins [line]) ;
+  }
+  return bank ;
+}
+
+
+/*
+ * shiftOutLines:
+ * shiftInLines:
+ *	The work for all the shift functions: shift len bytes per data line,
+ *	line n uses buf [n*len] .. buf [n*len + len - 1], on a shared clock.
+ *	When the pins are in one bank, a bit out is one write setting the data
+ *	lines and clearing the clock, one setting the clock. A bit in is the
+ *	clock going high, one read of the bank and the clock going low.
+ *********************************************************************************
+ */
+
+static void shiftOutLines (const int *dPins, int lines, int cPin, int order, const uint8_t *buf, int len)
+{
+  unsigned int dMasks [32], cMask, allData = 0, set ;
+  unsigned long long edge = 0, half = shiftHalfPeriod () ;
+  int bank, line, byte, bit, i ;
+
+  if (lines <= 0 || len <= 0)
+    return ;
+
+  if ((bank = shiftResolve (dPins, lines, cPin, dMasks, &cMask)) < 0)
+  {
+    for (byte = 0 ; byte < len ; ++byte)
+      for (i = 0 ; i < 8 ; ++i)
+      {
+        bit = (order == MSBFIRST) ? 7 - i : i ;
+        for (line = 0 ; line < lines ; ++line)
+          digitalWrite (dPins [line], (buf [line*len + byte] >> bit) & 1) ;
+        shiftWait (&edge, half) ;
+        digitalWrite (cPin, HIGH) ;
+        shiftWait (&edge, half) ;
+        digitalWrite (cPin, LOW) ;
+      }
+    return ;
+  }
+
+  for (line = 0 ; line < lines ; ++line)
+    allData |= dMasks [line] ;
+
+  for (byte = 0 ; byte < len ; ++byte)
+    for (i = 0 ; i < 8 ; ++i)
     {
-      digitalWrite (cPin, HIGH) ;
-      value |= digitalRead (dPin) << i ;
-      digitalWrite (cPin, LOW) ;
+      bit = (order == MSBFIRST) ? 7 - i : i ;
+      set = 0 ;
+      for (line = 0 ; line < lines ; ++line)
+        if ((buf [line*len + byte] >> bit) & 1)
+          set |= dMasks [line] ;
+      shiftWait (&edge, half) ;
+      digitalWriteMask (bank, set, (allData & ~set) | cMask) ;
+      shiftWait (&edge, half) ;
+      digitalWriteMask (bank, cMask, 0) ;
     }
-  else
+  shiftWait (&edge, half) ;
+  digitalWriteMask (bank, 0, cMask) ;
+}
+
+static void shiftInLines (const int *dPins, int lines, int cPin, int order, uint8_t *buf, int len)
+{
+  unsigned int dMasks [32], cMask, level ;
+  unsigned long long edge = 0, half = shiftHalfPeriod () ;
+  int bank, line, byte, bit, i ;
+
+  if (lines <= 0 || len <= 0)
+    return ;
+
+  for (line = 0 ; line < lines ; ++line)
+    for (byte = 0 ; byte < len ; ++byte)
+      buf [line*len + byte] = 0 ;
+
+  bank = shiftResolve (dPins, lines, cPin, dMasks, &cMask) ;
+
+  // the bank read only returns lines that are set up, so do what the first
+  //	digitalRead of a pin does (with the gpiochip device: request it as input)
+  if (bank >= 0)
+    for (line = 0 ; line < lines ; ++line)
+      (void)digitalRead (dPins [line]) ;
+
+  for (byte = 0 ; byte < len ; ++byte)
     for (i = 0 ; i < 8 ; ++i)
     {
-      digitalWrite (cPin, HIGH) ;
-      value |= digitalRead (dPin) << i ;
-      digitalWrite (cPin, LOW) ;
+      bit = (order == MSBFIRST) ? 7 - i : i ;
+      shiftWait (&edge, half) ;
+      if (bank < 0)
+      {
+        digitalWrite (cPin, HIGH) ;
+        for (line = 0 ; line < lines ; ++line)
+          buf [line*len + byte] |= (digitalRead (dPins [line]) ? 1 : 0) << bit ;
+        shiftWait (&edge, half) ;
+        digitalWrite (cPin, LOW) ;
+      }
+      else
+      {
+        digitalWriteMask (bank, cMask, 0) ;
+        level = digitalReadBank (bank) ;
+        for (line = 0 ; line < lines ; ++line)
+          buf [line*len + byte] |= ((level & dMasks [line]) ? 1 : 0) << bit ;
+        shiftWait (&edge, half) ;
+        digitalWriteMask (bank, 0, cMask) ;
+      }
     }
+}
+
+
+/*
+ * shiftOutBuffer:
+ * shiftInBuffer:
+ *	Shift a buffer out/in, buf [0] first. For a chain of 74HC595s buf [0]
+ *	ends up in the last register of the chain.
+ *********************************************************************************
+ */
+
+void shiftOutBuffer (int dPin, int cPin, int order, const uint8_t *buf, int len)
+{
+  shiftOutLines (&dPin, 1, cPin, order, buf, len) ;
+}
+
+void shiftInBuffer (int dPin, int cPin, int order, uint8_t *buf, int len)
+{
+  shiftInLines (&dPin, 1, cPin, order, buf, len) ;
+}
+
+
+/*
+ * shiftOutParallel:
+ * shiftInParallel:
+ *	Shift len bytes on each of lines data pins at once, on a shared clock.
+ *	The data of line n is buf [n*len] .. buf [n*len + len - 1].
+ *********************************************************************************
+ */
+
+void shiftOutParallel (const int *dPins, int lines, int cPin, int order, const uint8_t *buf, int len)
+{
+  shiftOutLines (dPins, lines, cPin, order, buf, len) ;
+}
 
-  return value;
+void shiftInParallel (const int *dPins, int lines, int cPin, int order, uint8_t *buf, int len)
+{
+  shiftInLines (dPins, lines, cPin, order, buf, len) ;
+}
+
+
+/*
+ * shiftIn:
+ *	Shift data in from a clocked source
+ *********************************************************************************
+ */
+
+uint8_t shiftIn (uint8_t dPin, uint8_t cPin, uint8_t order)
+{
+  int     pin = dPin ;
+  uint8_t value ;
+
+  shiftInLines (&pin, 1, cPin, order, &value, 1) ;
+  return value ;
 }
 
 /*
@@ -64,20 +270,7 @@ uint8_t shiftIn (uint8_t dPin, uint8_t cPin, uint8_t order)
 
 void shiftOut (uint8_t dPin, uint8_t cPin, uint8_t order, uint8_t val)
 {
-  int8_t i;
+  int pin = dPin ;
 
-  if (order == MSBFIRST)
-    for (i = 7 ; i >= 0 ; --i)
-    {
-      digitalWrite (dPin, val & (1 << i)) ;
-      digitalWrite (cPin, HIGH) ;
-      digitalWrite (cPin, LOW) ;
-    }
-  else
-    for (i = 0 ; i < 8 ; ++i)
-    {
-      digitalWrite (dPin, val & (1 << i)) ;
-      digitalWrite (cPin, HIGH) ;
-      digitalWrite (cPin, LOW) ;
-    }
+  shiftOutLines (&pin, 1, cPin, order, &val, 1) ;
 }
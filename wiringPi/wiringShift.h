@@ -36,6 +36,12 @@ extern "C" {
 extern uint8_t shiftIn      (uint8_t dPin, uint8_t cPin, uint8_t order) ;
 extern void    shiftOut     (uint8_t dPin, uint8_t cPin, uint8_t order, uint8_t val) ;
 
+extern void    shiftSetClockPeriod (unsigned int ns) ;                                                  // Interface V3.15
+extern void    shiftOutBuffer   (int dPin, int cPin, int order, const uint8_t *buf, int len) ;          // Interface V3.15
+extern void    shiftInBuffer    (int dPin, int cPin, int order, uint8_t *buf, int len) ;                // Interface V3.15
+extern void    shiftOutParallel (const int *dPins, int lines, int cPin, int order, const uint8_t *buf, int len) ; // Interface V3.15
+extern void    shiftInParallel  (const int *dPins, int lines, int cPin, int order, uint8_t *buf, int len) ;       // Interface V3.15
+
 #ifdef __cplusplus
 }
 #endif
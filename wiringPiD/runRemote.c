@@ -91,8 +91,8 @@ void runRemoteCommands (int fd)
 	  return ;
 	break ;
 
-      case DRCN_DIGITAL_WRITE8:
-	//digitalWrite8 (pin, cmd.data) ;
+      case DRCN_DIGITAL_WRITE8:		// Mask in bits 8-15, 0 is all 8 pins
+	digitalWritePort (pin, 8, cmd.data & 0xFF, ((cmd.data >> 8) & 0xFF) ? (cmd.data >> 8) & 0xFF : 0xFF) ;
 	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
 	  return ;
 	break ;
@@ -103,8 +103,8 @@ void runRemoteCommands (int fd)
 	  return ;
 	break ;
 
-      case DRCN_DIGITAL_READ8:
-	//cmd.data = digitalRead8 (pin) ;
+      case DRCN_DIGITAL_READ8:		// Number of pins in the data, 0 is 8
+	cmd.data = digitalReadPort (pin, ((cmd.data > 0) && (cmd.data < 8)) ? (int)cmd.data : 8) ;
 	if (send (fd, &cmd, sizeof (cmd), 0) != sizeof (cmd))
 	  return ;
 	break ;